@@ -4,7 +4,7 @@
 
 passthru_opts+=\
 	NONET NO_IPV6 NOHW NOMD5 NOPOSTPROCESSING\
-	MOBJCONSISTANCY PACKETDROP ZDEBUG\
+	PACKETDROP ZDEBUG\
 	NOUPNP NOEXECINFO\
 
 # build with debugging information
@@ -233,6 +233,19 @@ INT32 I_mkdir(const char *dirname, INT32 unixright)
   return -1;
 }
 
+void *I_MapFile(FILE *file, size_t size)
+{
+  (void)file;
+  (void)size;
+  return NULL;
+}
+
+void I_UnmapFile(void *data, size_t size)
+{
+  (void)data;
+  (void)size;
+}
+
 const CPUInfoFlags *I_CPUInfo(void)
 {
   return NULL;
@@ -63,6 +63,24 @@ static boolean CV_Immutable(const consvar_t *var);
 static consvar_t *consvar_vars; // list of registered console variables
 static UINT16     consvar_number_of_netids = 0;
 
+// Commands and variables by name, case insensitive, so running a config
+// file or receiving netvars doesn't walk the whole lists for every line.
+// Open addressing, at most half full; names are never removed.
+typedef struct
+{
+	const char *name;
+	void *item;
+} namedirslot_t;
+
+typedef struct
+{
+	namedirslot_t *slots;
+	size_t size, count;
+} namedir_t;
+
+static namedir_t com_commanddir = {NULL, 0, 0};
+static namedir_t consvar_dir = {NULL, 0, 0};
+
 #ifdef OLD22DEMOCOMPAT
 static old_demo_var_t *consvar_old_demo_vars;
 #endif
@@ -70,6 +88,48 @@ static old_demo_var_t *consvar_old_demo_vars;
 static char com_token[1024];
 static char *COM_Parse(char *data);
 
+static void *COM_FindInDirectory(const namedir_t *dir, const char *name)
+{
+	size_t slot;
+
+	if (!dir->size)
+		return NULL;
+
+	for (slot = quickncasehash(name, strlen(name)) & (dir->size - 1); dir->slots[slot].name; slot = (slot + 1) & (dir->size - 1))
+		if (!stricmp(name, dir->slots[slot].name))
+			return dir->slots[slot].item;
+
+	return NULL;
+}
+
+static void COM_AddToDirectory(namedir_t *dir, const char *name, void *item)
+{
+	size_t slot;
+
+	if ((dir->count + 1) * 2 > dir->size)
+	{
+		namedirslot_t *old = dir->slots;
+		size_t oldsize = dir->size, i;
+
+		dir->size = dir->size ? dir->size * 2 : 512;
+		dir->slots = Z_Calloc(dir->size * sizeof (*dir->slots), PU_STATIC, NULL);
+		dir->count = 0;
+
+		for (i = 0; i < oldsize; i++)
+			if (old[i].name)
+				COM_AddToDirectory(dir, old[i].name, old[i].item);
+		if (old)
+			Z_Free(old);
+	}
+
+	for (slot = quickncasehash(name, strlen(name)) & (dir->size - 1); dir->slots[slot].name; slot = (slot + 1) & (dir->size - 1))
+		;
+
+	dir->slots[slot].name = name;
+	dir->slots[slot].item = item;
+	dir->count++;
+}
+
 static char * COM_Purge (char *text, int *lenp);
 
 CV_PossibleValue_t CV_OnOff[] = {{0, "Off"}, {1, "On"}, {0, NULL}};
@@ -495,19 +555,17 @@ void COM_AddCommand(const char *name, com_func_t func, com_flags_t flags)
 	}
 
 	// fail if the command already exists
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	cmd = COM_FindInDirectory(&com_commanddir, name);
+	if (cmd)
 	{
-		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
-			// don't I_Error for Lua commands
-			// Lua commands can replace game commands, and they have priority.
-			// BUT, if for some reason we screwed up and made two console commands with the same name,
-			// it's good to have this here so we find out.
-			if (cmd->function != COM_Lua_f)
-				I_Error("Command %s already exists\n", name);
+		// don't I_Error for Lua commands
+		// Lua commands can replace game commands, and they have priority.
+		// BUT, if for some reason we screwed up and made two console commands with the same name,
+		// it's good to have this here so we find out.
+		if (cmd->function != COM_Lua_f)
+			I_Error("Command %s already exists\n", name);
 
-			return;
-		}
+		return;
 	}
 
 	cmd = ZZ_Alloc(sizeof *cmd);
@@ -516,6 +574,7 @@ void COM_AddCommand(const char *name, com_func_t func, com_flags_t flags)
 	cmd->flags = flags;
 	cmd->next = com_commands;
 	com_commands = cmd;
+	COM_AddToDirectory(&com_commanddir, cmd->name, cmd);
 }
 
 /** Adds a console command for Lua.
@@ -532,14 +591,12 @@ int COM_AddLuaCommand(const char *name)
 		return -1;
 
 	// command already exists
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	cmd = COM_FindInDirectory(&com_commanddir, name);
+	if (cmd)
 	{
-		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
-			// replace the built in command.
-			cmd->function = COM_Lua_f;
-			return 1;
-		}
+		// replace the built in command.
+		cmd->function = COM_Lua_f;
+		return 1;
 	}
 
 	// Add a new command.
@@ -549,6 +606,7 @@ int COM_AddLuaCommand(const char *name)
 	cmd->flags = COM_LUA;
 	cmd->next = com_commands;
 	com_commands = cmd;
+	COM_AddToDirectory(&com_commanddir, cmd->name, cmd);
 	return 0;
 }
 
@@ -559,13 +617,7 @@ int COM_AddLuaCommand(const char *name)
   */
 static boolean COM_Exists(const char *com_name)
 {
-	xcommand_t *cmd;
-
-	for (cmd = com_commands; cmd; cmd = cmd->next)
-		if (!stricmp(com_name, cmd->name))
-			return true;
-
-	return false;
+	return COM_FindInDirectory(&com_commanddir, com_name) != NULL;
 }
 
 /** Does command completion for the console.
@@ -638,19 +690,17 @@ static void COM_ExecuteString(char *ptext)
 		return; // no tokens
 
 	// check functions
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	cmd = COM_FindInDirectory(&com_commanddir, com_argv[0]);
+	if (cmd)
 	{
-		if (!stricmp(com_argv[0], cmd->name)) //case insensitive now that we have lower and uppercase!
+		if ((com_flags & COM_LUA) && !(cmd->flags & COM_LUA))
 		{
-			if ((com_flags & COM_LUA) && !(cmd->flags & COM_LUA))
-			{
-				CONS_Alert(CONS_WARNING, "Command '%s' cannot be run from Lua.\n", cmd->name);
-				return;
-			}
-
-			cmd->function();
+			CONS_Alert(CONS_WARNING, "Command '%s' cannot be run from Lua.\n", cmd->name);
 			return;
 		}
+
+		cmd->function();
+		return;
 	}
 
 	// check aliases
@@ -1223,13 +1273,7 @@ static const char *cv_null_string = "";
   */
 consvar_t *CV_FindVar(const char *name)
 {
-	consvar_t *cvar;
-
-	for (cvar = consvar_vars; cvar; cvar = cvar->next)
-		if (!stricmp(name,cvar->name))
-			return cvar;
-
-	return NULL;
+	return COM_FindInDirectory(&consvar_dir, name);
 }
 
 #ifdef OLD22DEMOCOMPAT
@@ -1370,6 +1414,7 @@ void CV_RegisterVar(consvar_t *variable)
 	{
 		variable->next = consvar_vars;
 		consvar_vars = variable;
+		COM_AddToDirectory(&consvar_dir, variable->name, variable);
 	}
 	variable->string = variable->zstring = NULL;
 	memset(&variable->revert, 0, sizeof variable->revert);
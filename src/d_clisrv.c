@@ -42,11 +42,16 @@
 #include "m_argv.h"
 #include "p_setup.h"
 #include "lzf.h"
+#include "m_delta.h"
+#ifdef HAVE_ZLIB
+#include "zlib.h"
+#endif
 #include "lua_script.h"
 #include "lua_hook.h"
 #include "lua_libs.h"
 #include "md5.h"
 #include "m_perfstats.h"
+#include "d_netsoak.h"
 
 #include "speedrun.h"
 
@@ -94,6 +99,19 @@ static boolean sendingsavegame[MAXNETNODES]; // Are we sending the savegame?
 static boolean resendingsavegame[MAXNETNODES]; // Are we resending the savegame?
 static tic_t savegameresendcooldown[MAXNETNODES]; // How long before we can resend again?
 static tic_t freezetimeout[MAXNETNODES]; // Until when can this node freeze the server before getting a timeout?
+static UINT8 gamestatecodecs[MAXNETNODES]; // Which codecs can this node decode gamestates with?
+
+typedef struct
+{
+	UINT8 *data;
+	size_t length;
+	UINT8 md5sum[16];
+} gamestatecopy_t;
+
+// Gamestates kept so a resend only has to send what changed
+static gamestatecopy_t sentgamestate[MAXNETNODES]; // Last gamestate sent to this node
+static gamestatecopy_t ackedgamestate[MAXNETNODES]; // Last gamestate this node confirmed loading
+static gamestatecopy_t cl_gamestatebase; // Last gamestate we loaded, as a client
 
 // Incremented by cv_joindelay when a client joins, decremented each tic.
 // If higher than cv_joindelay * 2 (3 joins in a short timespan), joins are temporarily disabled.
@@ -112,9 +130,21 @@ static tic_t supposedtics[MAXNETNODES]; // nettics prevision for smaller packet
 static UINT8 nodewaiting[MAXNETNODES];
 static tic_t firstticstosend; // min of the nettics
 static tic_t tictoclear = 0; // optimize d_clearticcmd
+static tic_t deltafirsttic[MAXNETNODES]; // first tic the node only ever got with deltaslots slots
+static INT16 deltaslots[MAXNETNODES]; // numslots of the last PT_SERVERTICS sent to the node
+static tic_t cl_deltatic; // first tic the client has ticcmds for
 static tic_t maketic;
 
-static INT16 consistancy[BACKUPTICS];
+static UINT16 consistancy[BACKUPTICS][NUMCONSISTANCY];
+
+const char *const consistancynames[NUMCONSISTANCY] =
+{
+	"players",
+	"mobjs",
+	"sectors",
+	"polyobjects",
+	"RNG"
+};
 
 static UINT8 player_joining = false;
 UINT8 hu_redownloadinggamestate = 0;
@@ -175,30 +205,143 @@ consvar_t cv_showjoinaddress = CVAR_INIT ("showjoinaddress", "Off", CV_SAVE|CV_N
 static CV_PossibleValue_t playbackspeed_cons_t[] = {{1, "MIN"}, {10, "MAX"}, {0, NULL}};
 consvar_t cv_playbackspeed = CVAR_INIT ("playbackspeed", "1", 0, playbackspeed_cons_t, NULL);
 
-static inline void *G_DcpyTiccmd(void* dest, const ticcmd_t* src, const size_t n)
+// Fields of a ticcmd in a PT_SERVERTICS packet, see SV_WriteTiccmds
+#define TD_FWD     0x01
+#define TD_SIDE    0x02
+#define TD_ANGLE   0x04
+#define TD_AIMING  0x08
+#define TD_BUTTONS 0x10
+#define TD_LATENCY 0x20
+
+// Largest possible size of the ticcmds of one tic in a PT_SERVERTICS packet
+#define MAXTICCMDSSIZE(slots) (((slots) + 7) / 8 + (slots) * (1 + sizeof (ticcmd_t)))
+
+// What the first tic of a packet is encoded against when there is no delta base
+static const ticcmd_t nullcmds[MAXPLAYERS];
+
+/** Writes the ticcmds of one tic, delta-encoded against another tic.
+  * A bitmask tells which players' ticcmds changed, and each of those
+  * gets a byte of TD_ flags followed by the fields that changed, like
+  * the ziptics in demos. Players holding still cost nothing but their
+  * bit in the mask.
+  *
+  * \param p        Where to write.
+  * \param cmds     The ticcmds of the tic.
+  * \param base     The ticcmds of the tic they are encoded against.
+  * \param numslots Number of players to write.
+  * \return Where the written data ends.
+  * \sa CL_ReadTiccmds
+  */
+static UINT8 *SV_WriteTiccmds(UINT8 *p, const ticcmd_t *cmds, const ticcmd_t *base, INT32 numslots)
 {
-	const size_t d = n / sizeof(ticcmd_t);
-	const size_t r = n % sizeof(ticcmd_t);
-	UINT8 *ret = dest;
-
-	if (r)
-		M_Memcpy(dest, src, n);
-	else if (d)
-		G_MoveTiccmd(dest, src, d);
-	return ret+n;
+	UINT8 *mask = p;
+	INT32 i;
+
+	memset(mask, 0, (numslots + 7) / 8);
+	p += (numslots + 7) / 8;
+
+	for (i = 0; i < numslots; i++)
+	{
+		const ticcmd_t *cmd = &cmds[i];
+		const ticcmd_t *old = &base[i];
+		UINT8 *flags = p++;
+
+		*flags = 0;
+
+		if (cmd->forwardmove != old->forwardmove)
+		{
+			WRITESINT8(p, cmd->forwardmove);
+			*flags |= TD_FWD;
+		}
+		if (cmd->sidemove != old->sidemove)
+		{
+			WRITESINT8(p, cmd->sidemove);
+			*flags |= TD_SIDE;
+		}
+		if (cmd->angleturn != old->angleturn)
+		{
+			WRITEINT16(p, cmd->angleturn);
+			*flags |= TD_ANGLE;
+		}
+		if (cmd->aiming != old->aiming)
+		{
+			WRITEINT16(p, cmd->aiming);
+			*flags |= TD_AIMING;
+		}
+		if (cmd->buttons != old->buttons)
+		{
+			WRITEUINT16(p, cmd->buttons);
+			*flags |= TD_BUTTONS;
+		}
+		if (cmd->latency != old->latency)
+		{
+			WRITEUINT8(p, cmd->latency);
+			*flags |= TD_LATENCY;
+		}
+
+		if (*flags)
+			mask[i / 8] |= 1 << (i % 8);
+		else
+			p--; // Nothing changed, drop the flags too
+	}
+
+	return p;
 }
 
-static inline void *G_ScpyTiccmd(ticcmd_t* dest, void* src, const size_t n)
+/** Reads the ticcmds of one tic written by SV_WriteTiccmds.
+  *
+  * \param p        Where to read from.
+  * \param end      End of the packet.
+  * \param cmds     Where to store the ticcmds.
+  * \param base     The ticcmds of the tic they were encoded against.
+  * \param numslots Number of players to read.
+  * \return Where the read data ends, or NULL if the packet is too short.
+  * \sa SV_WriteTiccmds
+  */
+static UINT8 *CL_ReadTiccmds(UINT8 *p, const UINT8 *end, ticcmd_t *cmds, const ticcmd_t *base, INT32 numslots)
 {
-	const size_t d = n / sizeof(ticcmd_t);
-	const size_t r = n % sizeof(ticcmd_t);
-	UINT8 *ret = src;
-
-	if (r)
-		M_Memcpy(dest, src, n);
-	else if (d)
-		G_MoveTiccmd(dest, src, d);
-	return ret+n;
+	const UINT8 *mask = p;
+	INT32 i;
+
+	if (end - p < (numslots + 7) / 8)
+		return NULL;
+	p += (numslots + 7) / 8;
+
+	for (i = 0; i < numslots; i++)
+	{
+		ticcmd_t *cmd = &cmds[i];
+		UINT8 flags;
+		ptrdiff_t size;
+
+		*cmd = base[i];
+
+		if (!(mask[i / 8] & (1 << (i % 8))))
+			continue;
+
+		if (p >= end)
+			return NULL;
+		flags = READUINT8(p);
+
+		size = !!(flags & TD_FWD) + !!(flags & TD_SIDE) + !!(flags & TD_LATENCY)
+			+ 2 * (!!(flags & TD_ANGLE) + !!(flags & TD_AIMING) + !!(flags & TD_BUTTONS));
+		if (end - p < size)
+			return NULL;
+
+		if (flags & TD_FWD)
+			cmd->forwardmove = READSINT8(p);
+		if (flags & TD_SIDE)
+			cmd->sidemove = READSINT8(p);
+		if (flags & TD_ANGLE)
+			cmd->angleturn = READINT16(p);
+		if (flags & TD_AIMING)
+			cmd->aiming = READINT16(p);
+		if (flags & TD_BUTTONS)
+			cmd->buttons = READUINT16(p);
+		if (flags & TD_LATENCY)
+			cmd->latency = READUINT8(p);
+	}
+
+	return p;
 }
 
 
@@ -521,7 +664,7 @@ void ReadLmpExtraData(UINT8 **demo_pointer, INT32 playernum)
 // end extra data function for lmps
 // -----------------------------------------------------------------
 
-static INT16 Consistancy(void);
+static void Consistancy(UINT16 *cons);
 
 typedef enum
 {
@@ -1323,6 +1466,11 @@ static boolean CL_SendJoin(void)
 	strncpy(netbuffer->u.clientcfg.names[0], cv_playername.zstring, MAXPLAYERNAME);
 	strncpy(netbuffer->u.clientcfg.names[1], player2name, MAXPLAYERNAME);
 
+	netbuffer->u.clientcfg.gamestatecodecs = 1 << GAMESTATECODEC_LZF;
+#ifdef HAVE_ZLIB
+	netbuffer->u.clientcfg.gamestatecodecs |= 1 << GAMESTATECODEC_DEFLATE;
+#endif
+
 	return HSendPacket(servernode, true, 0, sizeof (clientconfig_pak));
 }
 
@@ -1510,6 +1658,8 @@ static boolean SV_SendServerConfig(INT32 node)
 	netbuffer->u.servercfg.serverplayer = (UINT8)serverplayer;
 	netbuffer->u.servercfg.totalslotnum = (UINT8)(doomcom->numslots);
 	netbuffer->u.servercfg.gametic = (tic_t)LONG(gametic);
+	deltafirsttic[node] = gametic;
+	deltaslots[node] = 0;
 	netbuffer->u.servercfg.clientnode = (UINT8)node;
 	netbuffer->u.servercfg.gamestate = (UINT8)gamestate;
 	netbuffer->u.servercfg.gametype = (UINT8)gametype;
@@ -1549,8 +1699,37 @@ static boolean SV_SendServerConfig(INT32 node)
 	return waspacketsent;
 }
 
+static void FreeGamestateCopy(gamestatecopy_t *copy)
+{
+	if (copy->data)
+		Z_Free(copy->data);
+	copy->data = NULL;
+	copy->length = 0;
+}
+
 #ifndef NONET
-#define SAVEGAMESIZE (768*1024)
+static void StoreGamestateCopy(gamestatecopy_t *copy, const UINT8 *data, size_t length)
+{
+#ifdef NOMD5
+	// Without MD5 there is no way to agree on a base, so never keep one.
+	(void)data;
+	(void)length;
+	FreeGamestateCopy(copy);
+#else
+	copy->data = Z_Realloc(copy->data, length, PU_STATIC, NULL);
+	memcpy(copy->data, data, length);
+	copy->length = length;
+	md5_buffer((const char *)data, length, copy->md5sum);
+#endif
+}
+
+// A sent gamestate starts with its codec and uncompressed length
+#define GAMESTATEHEADER (1 + sizeof(UINT32))
+
+// What follows the header in a sent gamestate
+#define GAMESTATE_FULL 0 // The gamestate itself
+#define GAMESTATE_DELTA 1 // Base MD5, target MD5, target length, then a delta against the base
+#define GAMESTATEDELTAHEADER (1 + 16 + 16 + sizeof(UINT32))
 
 static boolean SV_ResendingSavegameToAnyone(void)
 {
@@ -1562,33 +1741,135 @@ static boolean SV_ResendingSavegameToAnyone(void)
 	return false;
 }
 
+/** Replaces a full gamestate with a delta against the last one the node
+  * confirmed loading, if that is smaller.
+  *
+  * \param node       The node the gamestate is for.
+  * \param savebuffer The full gamestate, freed and replaced on success.
+  * \param length     Size of the buffer, updated on success.
+  * \return True if the buffer now holds a delta.
+  */
+static boolean SV_MakeGamestateDelta(INT32 node, UINT8 **savebuffer, size_t *length)
+{
+	const gamestatecopy_t *base = &ackedgamestate[node];
+	const gamestatecopy_t *target = &sentgamestate[node];
+	size_t maxdelta, deltalength;
+	UINT8 *deltabuffer, *p;
+
+	if (!base->data || !target->data)
+		return false;
+
+	// The delta has to beat the full gamestate to be worth it.
+	if (*length <= GAMESTATEHEADER + GAMESTATEDELTAHEADER + 1)
+		return false;
+	maxdelta = *length - GAMESTATEHEADER - GAMESTATEDELTAHEADER - 1;
+
+	deltabuffer = malloc(*length);
+	if (!deltabuffer)
+		return false;
+
+	deltalength = M_DeltaEncode(base->data, base->length, target->data, target->length,
+		deltabuffer + GAMESTATEHEADER + GAMESTATEDELTAHEADER, maxdelta);
+	if (!deltalength)
+	{
+		free(deltabuffer);
+		return false;
+	}
+
+	p = deltabuffer + GAMESTATEHEADER;
+	WRITEUINT8(p, GAMESTATE_DELTA);
+	WRITEMEM(p, base->md5sum, 16);
+	WRITEMEM(p, target->md5sum, 16);
+	WRITEUINT32(p, target->length);
+
+	CONS_Debug(DBG_NETPLAY, "Sending gamestate delta to node %d: %s bytes instead of %s\n",
+		node, sizeu1(deltalength + GAMESTATEDELTAHEADER), sizeu2(target->length + 1));
+
+	free(*savebuffer);
+	*savebuffer = deltabuffer;
+	*length = GAMESTATEHEADER + GAMESTATEDELTAHEADER + deltalength;
+	return true;
+}
+
+/** Compresses a gamestate with deflate at the level set by
+  * gamestatecompression, if the node can decode it, or with lzf otherwise.
+  *
+  * \param node      The node the gamestate is for.
+  * \param in        The gamestate.
+  * \param inlength  Size of the gamestate.
+  * \param out       Where to write the compressed data.
+  * \param maxlength Size of the output buffer.
+  * \param codec     Set to the codec used.
+  * \return Size of the compressed data, or 0 if it did not fit in maxlength.
+  */
+static size_t SV_CompressGamestate(INT32 node, UINT8 *in, size_t inlength, UINT8 *out, size_t maxlength, UINT8 *codec)
+{
+#ifdef HAVE_ZLIB
+	if (cv_gamestatecompression.value && (gamestatecodecs[node] & (1 << GAMESTATECODEC_DEFLATE)))
+	{
+		z_stream strm;
+		int zErr;
+
+		memset(&strm, 0, sizeof(strm));
+		strm.zalloc = Z_NULL;
+		strm.zfree = Z_NULL;
+		strm.opaque = Z_NULL;
+
+		if (deflateInit(&strm, cv_gamestatecompression.value) == Z_OK)
+		{
+			strm.next_in = in;
+			strm.avail_in = (uInt)inlength;
+			strm.next_out = out;
+			strm.avail_out = (uInt)maxlength;
+
+			zErr = deflate(&strm, Z_FINISH);
+			(void)deflateEnd(&strm);
+
+			if (zErr == Z_STREAM_END)
+			{
+				*codec = GAMESTATECODEC_DEFLATE;
+				return strm.total_out;
+			}
+		}
+	}
+#else
+	(void)node;
+#endif
+
+	*codec = GAMESTATECODEC_LZF;
+	return lzf_compress(in, inlength, out, maxlength);
+}
+
 static void SV_SendSaveGame(INT32 node, boolean resending)
 {
 	size_t length, compressedlen;
+	UINT8 codec;
 	UINT8 *savebuffer;
 	UINT8 *compressedsave;
 	UINT8 *buffertosend;
+	UINT8 *state;
 
-	// first save it in a malloced buffer
-	savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
+	// The client only has ticcmds from the savegame's tic on
+	deltafirsttic[node] = gametic;
+	deltaslots[node] = 0;
+
+	// first save it in a malloced buffer, leaving room for the header and the gamestate kind
+	savebuffer = P_SaveNetGame(resending, GAMESTATEHEADER + 1, &length);
 	if (!savebuffer)
 	{
 		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
 		return;
 	}
 
-	// Leave room for the uncompressed length.
-	save_p = savebuffer + sizeof(UINT32);
+	savebuffer[GAMESTATEHEADER] = GAMESTATE_FULL;
+	state = savebuffer + GAMESTATEHEADER + 1;
 
-	P_SaveNetGame(resending);
+	// Keep what we sent, so that once the node has loaded it,
+	// the next resend only needs the difference.
+	StoreGamestateCopy(&sentgamestate[node], state, savebuffer + length - state);
 
-	length = save_p - savebuffer;
-	if (length > SAVEGAMESIZE)
-	{
-		free(savebuffer);
-		save_p = NULL;
-		I_Error("Savegame buffer overrun");
-	}
+	if (resending)
+		SV_MakeGamestateDelta(node, &savebuffer, &length);
 
 	// Allocate space for compressed save: one byte fewer than for the
 	// uncompressed data to ensure that the compression is worthwhile.
@@ -1600,7 +1881,7 @@ static void SV_SendSaveGame(INT32 node, boolean resending)
 	}
 
 	// Attempt to compress it.
-	if((compressedlen = lzf_compress(savebuffer + sizeof(UINT32), length - sizeof(UINT32), compressedsave + sizeof(UINT32), length - sizeof(UINT32) - 1)))
+	if((compressedlen = SV_CompressGamestate(node, savebuffer + GAMESTATEHEADER, length - GAMESTATEHEADER, compressedsave + GAMESTATEHEADER, length - GAMESTATEHEADER - 1, &codec)))
 	{
 		// Compressing succeeded; send compressed data
 
@@ -1608,8 +1889,9 @@ static void SV_SendSaveGame(INT32 node, boolean resending)
 
 		// State that we're compressed.
 		buffertosend = compressedsave;
-		WRITEUINT32(compressedsave, length - sizeof(UINT32));
-		length = compressedlen + sizeof(UINT32);
+		WRITEUINT8(compressedsave, codec);
+		WRITEUINT32(compressedsave, length - GAMESTATEHEADER);
+		length = compressedlen + GAMESTATEHEADER;
 	}
 	else
 	{
@@ -1619,7 +1901,8 @@ static void SV_SendSaveGame(INT32 node, boolean resending)
 
 		// State that we're not compressed
 		buffertosend = savebuffer;
-		WRITEUINT32(savebuffer, 0);
+		WRITEUINT8(savebuffer, GAMESTATECODEC_NONE);
+		WRITEUINT32(savebuffer, length - GAMESTATEHEADER);
 	}
 
 	AddRamToSendQueue(node, buffertosend, length, SF_RAM, 0);
@@ -1646,23 +1929,13 @@ static void SV_SavedGame(void)
 	sprintf(tmpsave, "%s" PATHSEP TMPSAVENAME, srb2home);
 
 	// first save it in a malloced buffer
-	save_p = savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
-	if (!save_p)
+	savebuffer = P_SaveNetGame(false, 0, &length);
+	if (!savebuffer)
 	{
 		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
 		return;
 	}
 
-	P_SaveNetGame(false);
-
-	length = save_p - savebuffer;
-	if (length > SAVEGAMESIZE)
-	{
-		free(savebuffer);
-		save_p = NULL;
-		I_Error("Savegame buffer overrun");
-	}
-
 	// then save it!
 	if (!FIL_WriteFile(tmpsave, savebuffer, length))
 		CONS_Printf(M_GetText("Didn't save %s for netgame"), tmpsave);
@@ -1676,10 +1949,128 @@ static void SV_SavedGame(void)
 #define TMPSAVENAME "$$$.sav"
 
 
-static void CL_LoadReceivedSavegame(boolean reloading)
+/** Rebuilds a gamestate from a delta against the last one we loaded.
+  * save_p must point just past the gamestate kind. If it can't be
+  * rebuilt, the base is dropped, so asking again gets a full gamestate.
+  *
+  * \param savebuffer The received data, freed and replaced by the gamestate.
+  * \param length     Size of the delta, header included.
+  * \return Size of the rebuilt gamestate, or 0 if it couldn't be rebuilt.
+  */
+static size_t CL_ApplyGamestateDelta(UINT8 **savebuffer, size_t length)
+{
+	UINT8 basemd5[16], targetmd5[16];
+	size_t targetlength;
+	UINT8 *target;
+
+	if (length < GAMESTATEDELTAHEADER - 1)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Received a corrupt gamestate delta\n"));
+		FreeGamestateCopy(&cl_gamestatebase);
+		return 0;
+	}
+
+	READMEM(save_p, basemd5, 16);
+	READMEM(save_p, targetmd5, 16);
+	targetlength = READUINT32(save_p);
+	length -= GAMESTATEDELTAHEADER - 1;
+
+	if (!cl_gamestatebase.data || memcmp(basemd5, cl_gamestatebase.md5sum, 16))
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Received a gamestate delta against a gamestate we do not have\n"));
+		FreeGamestateCopy(&cl_gamestatebase);
+		return 0;
+	}
+
+	target = Z_Malloc(targetlength, PU_STATIC, NULL);
+	if (!M_DeltaDecode(cl_gamestatebase.data, cl_gamestatebase.length, save_p, length, target, targetlength))
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Received a corrupt gamestate delta\n"));
+		Z_Free(target);
+		FreeGamestateCopy(&cl_gamestatebase);
+		return 0;
+	}
+
+#ifndef NOMD5
+	{
+		UINT8 md5sum[16];
+		md5_buffer((const char *)target, targetlength, md5sum);
+		if (memcmp(md5sum, targetmd5, 16))
+		{
+			CONS_Alert(CONS_WARNING, M_GetText("Gamestate rebuilt from delta does not match the server's\n"));
+			Z_Free(target);
+			FreeGamestateCopy(&cl_gamestatebase);
+			return 0;
+		}
+	}
+#endif
+
+	CONS_Debug(DBG_NETPLAY, "Rebuilt gamestate of %s bytes from a %s byte delta\n", sizeu1(targetlength), sizeu2(length));
+
+	Z_Free(*savebuffer);
+	save_p = *savebuffer = target;
+	return targetlength;
+}
+
+/** Decompresses a received gamestate.
+  *
+  * \param codec     The codec it was compressed with.
+  * \param in        The compressed data.
+  * \param inlength  Size of the compressed data.
+  * \param out       Where to write the gamestate.
+  * \param outlength Size of the gamestate.
+  * \return True if exactly outlength bytes were decompressed.
+  */
+static boolean CL_DecompressGamestate(UINT8 codec, UINT8 *in, size_t inlength, UINT8 *out, size_t outlength)
+{
+	switch (codec)
+	{
+		case GAMESTATECODEC_LZF:
+			return lzf_decompress(in, inlength, out, outlength) == outlength;
+#ifdef HAVE_ZLIB
+		case GAMESTATECODEC_DEFLATE:
+		{
+			z_stream strm;
+			int zErr;
+
+			memset(&strm, 0, sizeof(strm));
+			strm.zalloc = Z_NULL;
+			strm.zfree = Z_NULL;
+			strm.opaque = Z_NULL;
+
+			strm.next_in = in;
+			strm.avail_in = (uInt)inlength;
+			strm.next_out = out;
+			strm.avail_out = (uInt)outlength;
+
+			if (inflateInit(&strm) != Z_OK)
+				return false;
+
+			zErr = inflate(&strm, Z_FINISH);
+			(void)inflateEnd(&strm);
+
+			return zErr == Z_STREAM_END && strm.total_out == outlength;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+static boolean CL_AskForGamestate(void);
+
+/** Loads the gamestate the server sent.
+  *
+  * \param reloading True if it was resent during the game.
+  * \return False if a resent delta couldn't be used, in which case
+  *         a full gamestate has been asked for instead.
+  */
+static boolean CL_LoadReceivedSavegame(boolean reloading)
 {
 	UINT8 *savebuffer = NULL;
+	UINT8 *state;
 	size_t length, decompressedlen;
+	UINT8 codec;
 	char tmpsave[256];
 
 	FreeFileNeeded();
@@ -1689,24 +2080,51 @@ static void CL_LoadReceivedSavegame(boolean reloading)
 	length = FIL_ReadFile(tmpsave, &savebuffer);
 
 	CONS_Printf(M_GetText("Loading savegame length %s\n"), sizeu1(length));
-	if (!length)
+	if (length <= GAMESTATEHEADER)
 	{
 		I_Error("Can't read savegame sent");
-		return;
+		return false;
 	}
 
 	save_p = savebuffer;
 
 	// Decompress saved game if necessary.
+	codec = READUINT8(save_p);
 	decompressedlen = READUINT32(save_p);
-	if(decompressedlen > 0)
+	length -= GAMESTATEHEADER;
+	if (codec != GAMESTATECODEC_NONE)
 	{
 		UINT8 *decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
-		lzf_decompress(save_p, length - sizeof(UINT32), decompressedbuffer, decompressedlen);
+		if (!CL_DecompressGamestate(codec, save_p, length, decompressedbuffer, decompressedlen))
+			I_Error("Can't decompress savegame sent");
 		Z_Free(savebuffer);
 		save_p = savebuffer = decompressedbuffer;
+		length = decompressedlen;
 	}
 
+	if (!length)
+		I_Error("Can't read savegame sent");
+
+	length--;
+	if (READUINT8(save_p) == GAMESTATE_DELTA)
+	{
+		length = CL_ApplyGamestateDelta(&savebuffer, length);
+		if (!length)
+		{
+			if (!reloading)
+				I_Error("Can't read savegame sent");
+
+			// The server can always send the whole thing instead.
+			Z_Free(savebuffer);
+			save_p = NULL;
+			if (unlink(tmpsave) == -1)
+				CONS_Alert(CONS_ERROR, M_GetText("Can't delete %s\n"), tmpsave);
+			CL_AskForGamestate();
+			return false;
+		}
+	}
+	state = save_p;
+
 	paused = false;
 	demoplayback = false;
 	titlemapinaction = TITLEMAP_OFF;
@@ -1727,6 +2145,9 @@ static void CL_LoadReceivedSavegame(boolean reloading)
 				CONS_Printf(" %2d", actnum);
 		}
 		CONS_Printf("\"\n");
+
+		// Keep it, so the next resend can be a delta against it.
+		StoreGamestateCopy(&cl_gamestatebase, state, length);
 	}
 
 	// done
@@ -1734,13 +2155,15 @@ static void CL_LoadReceivedSavegame(boolean reloading)
 	save_p = NULL;
 	if (unlink(tmpsave) == -1)
 		CONS_Alert(CONS_ERROR, M_GetText("Can't delete %s\n"), tmpsave);
-	consistancy[gametic%BACKUPTICS] = Consistancy();
+	Consistancy(consistancy[gametic%BACKUPTICS]);
+	cl_deltatic = gametic;
 	CON_ToggleOff();
 
 	// Tell the server we have received and reloaded the gamestate
 	// so they know they can resume the game
 	netbuffer->packettype = PT_RECEIVEDGAMESTATE;
 	HSendPacket(servernode, true, 0, 0);
+	return true;
 }
 
 static void CL_ReloadReceivedSavegame(void)
@@ -1753,7 +2176,8 @@ static void CL_ReloadReceivedSavegame(void)
 		sprintf(player_names[i], "Player %d", i + 1);
 	}
 
-	CL_LoadReceivedSavegame(true);
+	if (!CL_LoadReceivedSavegame(true))
+		return; // Still waiting for a full gamestate
 
 	if (neededtic < gametic)
 		neededtic = gametic;
@@ -3018,6 +3442,8 @@ void CL_Reset(void)
 	FreeFileNeeded();
 	fileneedednum = 0;
 
+	FreeGamestateCopy(&cl_gamestatebase);
+
 #ifndef NONET
 	totalfilesrequestednum = 0;
 	totalfilesrequestedsize = 0;
@@ -3535,9 +3961,18 @@ static CV_PossibleValue_t maxsend_cons_t[] = {{0, "MIN"}, {204800, "MAX"}, {0, N
 consvar_t cv_maxsend = CVAR_INIT ("maxsend", "4096", CV_SAVE|CV_NETVAR, maxsend_cons_t, NULL);
 consvar_t cv_noticedownload = CVAR_INIT ("noticedownload", "Off", CV_SAVE|CV_NETVAR, CV_OnOff, NULL);
 
-// Speed of file downloading (in packets per tic)
-static CV_PossibleValue_t downloadspeed_cons_t[] = {{1, "MIN"}, {300, "MAX"}, {0, NULL}};
-consvar_t cv_downloadspeed = CVAR_INIT ("downloadspeed", "16", CV_SAVE|CV_NETVAR, downloadspeed_cons_t, NULL);
+// Most file fragments sent per tic, to all nodes together
+// Each node gets what its connection can take below that, see FileSendTicker
+static CV_PossibleValue_t downloadspeed_cons_t[] = {{1, "MIN"}, {1024, "MAX"}, {0, NULL}};
+consvar_t cv_downloadspeed = CVAR_INIT ("downloadspeed", "128", CV_SAVE|CV_NETVAR, downloadspeed_cons_t, NULL);
+
+// Disk space for downloaded addons (in megabytes), see d_dlcache.c
+static CV_PossibleValue_t downloadcache_cons_t[] = {{1, "MIN"}, {1048576, "MAX"}, {0, "Off"}, {0, NULL}};
+consvar_t cv_downloadcache = CVAR_INIT ("downloadcache", "2048", CV_SAVE, downloadcache_cons_t, NULL);
+
+// How hard to compress gamestates sent to joining players (deflate level, 0 for lzf)
+static CV_PossibleValue_t gamestatecompression_cons_t[] = {{0, "LZF"}, {1, "Fast"}, {6, "Normal"}, {9, "Best"}, {0, NULL}};
+consvar_t cv_gamestatecompression = CVAR_INIT ("gamestatecompression", "Normal", CV_SAVE, gamestatecompression_cons_t, NULL);
 
 static void Got_AddPlayer(UINT8 **p, INT32 playernum);
 
@@ -3561,6 +3996,7 @@ void D_ClientServerInit(void)
 #ifdef PACKETDROP
 	COM_AddCommand("drop", Command_Drop, COM_LUA);
 	COM_AddCommand("droprate", Command_Droprate, COM_LUA);
+	COM_AddCommand("delaypacket", Command_Delaypacket, COM_LUA);
 #endif
 #ifdef _DEBUG
 	COM_AddCommand("numnodes", Command_Numnodes, COM_LUA);
@@ -3569,6 +4005,8 @@ void D_ClientServerInit(void)
 
 	RegisterNetXCmd(XD_KICK, Got_KickCmd);
 	RegisterNetXCmd(XD_ADDPLAYER, Got_AddPlayer);
+
+	D_SoakInit();
 #ifndef NONET
 #ifdef DUMPCONSISTENCY
 	CV_RegisterVar(&cv_dumpconsistency);
@@ -3593,6 +4031,8 @@ static void ResetNode(INT32 node)
 
 	nettics[node] = gametic;
 	supposedtics[node] = gametic;
+	deltafirsttic[node] = gametic;
+	deltaslots[node] = 0;
 
 	nodetoplayer[node] = -1;
 	nodetoplayer2[node] = -1;
@@ -3601,6 +4041,9 @@ static void ResetNode(INT32 node)
 	sendingsavegame[node] = false;
 	resendingsavegame[node] = false;
 	savegameresendcooldown[node] = 0;
+	gamestatecodecs[node] = 1 << GAMESTATECODEC_LZF;
+	FreeGamestateCopy(&sentgamestate[node]);
+	FreeGamestateCopy(&ackedgamestate[node]);
 }
 
 void SV_ResetServer(void)
@@ -3737,6 +4180,8 @@ static inline void SV_AddNode(INT32 node)
 {
 	nettics[node] = gametic;
 	supposedtics[node] = gametic;
+	deltafirsttic[node] = gametic;
+	deltaslots[node] = 0;
 	// little hack because the server connects to itself and puts
 	// nodeingame when connected not here
 	if (node)
@@ -4157,6 +4602,7 @@ static void HandleConnect(SINT8 node)
 
 		// client authorised to join
 		nodewaiting[node] = (UINT8)(netbuffer->u.clientcfg.localplayers - playerpernode[node]);
+		gamestatecodecs[node] = netbuffer->u.clientcfg.gamestatecodecs;
 		if (!nodeingame[node])
 		{
 			gamestate_t backupstate = gamestate;
@@ -4251,19 +4697,24 @@ static void HandleServerInfo(SINT8 node)
 }
 #endif
 
-static void PT_WillResendGamestate(void)
+/** Asks the server to send the gamestate, as a delta against the one we
+  * have if we have one, and gets ready to receive it.
+  *
+  * \return True if the request went out.
+  */
+static boolean CL_AskForGamestate(void)
 {
 #ifndef NONET
 	char tmpsave[256];
 
-	if (server || cl_redownloadinggamestate)
-		return;
-
 	// Send back a PT_CANRECEIVEGAMESTATE packet to the server
-	// so they know they can start sending the game state
+	// so they know they can start sending the game state,
+	// along with the gamestate we have for them to diff against
 	netbuffer->packettype = PT_CANRECEIVEGAMESTATE;
-	if (!HSendPacket(servernode, true, 0, 0))
-		return;
+	netbuffer->u.gamestatebase.length = LONG((UINT32)cl_gamestatebase.length);
+	memcpy(netbuffer->u.gamestatebase.md5sum, cl_gamestatebase.md5sum, 16);
+	if (!HSendPacket(servernode, true, 0, sizeof(gamestatebase_pak)))
+		return false;
 
 	CONS_Printf(M_GetText("Reloading game state...\n"));
 
@@ -4276,18 +4727,35 @@ static void PT_WillResendGamestate(void)
 	CL_PrepareDownloadSaveGame(tmpsave);
 
 	cl_redownloadinggamestate = true;
+	return true;
+#else
+	return false;
 #endif
 }
 
+static void PT_WillResendGamestate(void)
+{
+	if (server || cl_redownloadinggamestate)
+		return;
+
+	CL_AskForGamestate();
+}
+
 static void PT_CanReceiveGamestate(SINT8 node)
 {
 #ifndef NONET
-	if (client || sendingsavegame[node])
+	// A node we're resending to asks again when it couldn't use the delta.
+	if (client || (sendingsavegame[node] && !resendingsavegame[node]))
 		return;
 
 	CONS_Printf(M_GetText("Resending game state to %s...\n"), player_names[nodetoplayer[node]]);
 
-	SV_SendSaveGame(node, true); // Resend a complete game state
+	// Only diff against a gamestate the client still has
+	if ((UINT32)LONG(netbuffer->u.gamestatebase.length) != ackedgamestate[node].length
+		|| memcmp(netbuffer->u.gamestatebase.md5sum, ackedgamestate[node].md5sum, 16))
+		FreeGamestateCopy(&ackedgamestate[node]);
+
+	SV_SendSaveGame(node, true); // Resend the game state
 	resendingsavegame[node] = true;
 #else
 	(void)node;
@@ -4416,7 +4884,7 @@ static void HandlePacketFromAwayNode(SINT8 node)
 
 			if (client)
 			{
-				maketic = gametic = neededtic = (tic_t)LONG(netbuffer->u.servercfg.gametic);
+				maketic = gametic = neededtic = cl_deltatic = (tic_t)LONG(netbuffer->u.servercfg.gametic);
 				G_SetGametype(netbuffer->u.servercfg.gametype);
 				modifiedgame = netbuffer->u.servercfg.modifiedgame;
 				if (netbuffer->u.servercfg.usedCheats)
@@ -4507,6 +4975,23 @@ static void HandlePacketFromAwayNode(SINT8 node)
 #undef SERVERONLY
 }
 
+/** Compares our state hashes for a tic with the ones in the received ticcmd
+  *
+  * \param tic The tic the client's hashes are for
+  * \return The first part that differs, or NUMCONSISTANCY if they all match
+  *
+  */
+static consistancy_t CheckConsistancy(tic_t tic)
+{
+	consistancy_t i;
+
+	for (i = 0; i < NUMCONSISTANCY; i++)
+		if (consistancy[tic%BACKUPTICS][i] != SHORT(netbuffer->u.clientpak.consistancy[i]))
+			break;
+
+	return i;
+}
+
 /** Handles a packet received from a node that is in game
   *
   * \param node The packet sender
@@ -4519,13 +5004,12 @@ static void HandlePacketFromPlayer(SINT8 node)
 {
 	INT32 netconsole;
 	tic_t realend, realstart;
-	UINT8 *pak, *txtpak, numtxtpak;
+	UINT8 *pak, numtxtpak;
+	consistancy_t desync;
 #ifndef NOMD5
 	UINT8 finalmd5[16];/* Well, it's the cool thing to do? */
 #endif
 
-	txtpak = NULL;
-
 	if (dedicated && node == 0)
 		netconsole = 0;
 	else
@@ -4612,12 +5096,19 @@ static void HandlePacketFromPlayer(SINT8 node)
 
 			// Check player consistancy during the level
 			if (realstart <= gametic && realstart + BACKUPTICS - 1 > gametic && gamestate == GS_LEVEL
-				&& consistancy[realstart%BACKUPTICS] != SHORT(netbuffer->u.clientpak.consistancy)
+				&& (desync = CheckConsistancy(realstart)) != NUMCONSISTANCY)
+			{
+				// A gamestate is already on its way, this is the same desync
 #ifndef NONET
-				&& !SV_ResendingSavegameToAnyone()
+				if (SV_ResendingSavegameToAnyone())
+					break;
 #endif
-				&& !resendingsavegame[node] && savegameresendcooldown[node] <= I_GetTime())
-			{
+				if (resendingsavegame[node] || savegameresendcooldown[node] > I_GetTime())
+					break;
+
+				// Once per desync, as it ends in a resend or a kick
+				D_SoakDesync(desync);
+
 				if (cv_resynchattempts.value)
 				{
 					// Tell the client we are about to resend them the gamestate
@@ -4627,21 +5118,21 @@ static void HandlePacketFromPlayer(SINT8 node)
 					resendingsavegame[node] = true;
 
 					if (cv_blamecfail.value)
-						CONS_Printf(M_GetText("Synch failure for player %d (%s); expected %hd, got %hd\n"),
-							netconsole+1, player_names[netconsole],
-							consistancy[realstart%BACKUPTICS],
-							SHORT(netbuffer->u.clientpak.consistancy));
-					DEBFILE(va("Restoring player %d (synch failure) [%update] %d!=%d\n",
-						netconsole, realstart, consistancy[realstart%BACKUPTICS],
-						SHORT(netbuffer->u.clientpak.consistancy)));
+						CONS_Printf(M_GetText("Synch failure for player %d (%s) in %s; expected %hu, got %hu\n"),
+							netconsole+1, player_names[netconsole], consistancynames[desync],
+							consistancy[realstart%BACKUPTICS][desync],
+							SHORT(netbuffer->u.clientpak.consistancy[desync]));
+					DEBFILE(va("Restoring player %d (synch failure in %s) [%update] %d!=%d\n",
+						netconsole, consistancynames[desync], realstart, consistancy[realstart%BACKUPTICS][desync],
+						SHORT(netbuffer->u.clientpak.consistancy[desync])));
 					break;
 				}
 				else
 				{
 					SendKick(netconsole, KICK_MSG_CON_FAIL | KICK_MSG_KEEP_BODY);
-					DEBFILE(va("player %d kicked (synch failure) [%u] %d!=%d\n",
-						netconsole, realstart, consistancy[realstart%BACKUPTICS],
-						SHORT(netbuffer->u.clientpak.consistancy)));
+					DEBFILE(va("player %d kicked (synch failure in %s) [%u] %d!=%d\n",
+						netconsole, consistancynames[desync], realstart, consistancy[realstart%BACKUPTICS][desync],
+						SHORT(netbuffer->u.clientpak.consistancy[desync])));
 					break;
 				}
 			}
@@ -4701,7 +5192,7 @@ static void HandlePacketFromPlayer(SINT8 node)
 				// doomcom->numslots+1 "+1" since doomcom->numslots can change within this time and sent time
 				j = software_MAXPACKETLENGTH
 					- (netbuffer->u.textcmd[0]+2+BASESERVERTICSSIZE
-					+ (doomcom->numslots+1)*sizeof(ticcmd_t));
+					+ MAXTICCMDSSIZE(doomcom->numslots+1));
 
 				// search a tic that have enougth space in the ticcmd
 				while ((textcmd = D_GetExistingTextcmd(tic, netconsole)),
@@ -4797,6 +5288,14 @@ static void HandlePacketFromPlayer(SINT8 node)
 				SV_HandleLuaFileSent(node);
 			break;
 		case PT_RECEIVEDGAMESTATE:
+			if (sendingsavegame[node])
+			{
+				// The node now has what we sent, so use it as the next base
+				FreeGamestateCopy(&ackedgamestate[node]);
+				ackedgamestate[node] = sentgamestate[node];
+				sentgamestate[node].data = NULL;
+				sentgamestate[node].length = 0;
+			}
 			sendingsavegame[node] = false;
 			resendingsavegame[node] = false;
 			savegameresendcooldown[node] = I_GetTime() + 5 * TICRATE;
@@ -4815,42 +5314,75 @@ static void HandlePacketFromPlayer(SINT8 node)
 			realstart = netbuffer->u.serverpak.starttic;
 			realend = realstart + netbuffer->u.serverpak.numtics;
 
-			if (!txtpak)
-				txtpak = (UINT8 *)&netbuffer->u.serverpak.cmds[netbuffer->u.serverpak.numslots
-					* netbuffer->u.serverpak.numtics];
-
 			if (realend > gametic + CLIENTBACKUPTICS)
 				realend = gametic + CLIENTBACKUPTICS;
 			cl_packetmissed = realstart > neededtic;
 
-			if (realstart <= neededtic && realend > neededtic)
+			// A packet sent before we (re)loaded the game state
+			// may be encoded against a tic we never got
+			if (netbuffer->u.serverpak.deltabase && realstart <= cl_deltatic)
+			{
+				DEBFILE(va("no delta base for tic %u\n", realstart));
+				break;
+			}
+
+			if (realstart <= neededtic && realend > neededtic
+				&& netbuffer->u.serverpak.numslots <= MAXPLAYERS)
 			{
 				tic_t i, j;
-				pak = (UINT8 *)&netbuffer->u.serverpak.cmds;
+				const UINT8 *end = (UINT8 *)netbuffer + doomcom->datalength;
+				const ticcmd_t *base = netbuffer->u.serverpak.deltabase ?
+					netcmds[(realstart - 1)%BACKUPTICS] : nullcmds;
+				ticcmd_t cmds[MAXPLAYERS];
+				UINT8 *txtpak;
+
+				pak = netbuffer->u.serverpak.cmds;
 
+				// A tic is only stored once all of it was read, so a truncated
+				// packet can't leave a tic we already had half overwritten.
 				for (i = realstart; i < realend; i++)
 				{
+					pak = CL_ReadTiccmds(pak, end, cmds, base, netbuffer->u.serverpak.numslots);
+					if (!pak || pak >= end)
+						break;
+
+					// check the textcmds fit
+					txtpak = pak;
+					numtxtpak = *pak++;
+					for (j = 0; j < numtxtpak; j++)
+					{
+						if (end - pak < 2 || *pak >= MAXPLAYERS || end - pak - 1 < pak[1] + 1)
+							break;
+						pak += 2 + pak[1];
+					}
+					if (j < numtxtpak)
+						break;
+
 					// clear first
 					D_Clearticcmd(i);
 
 					// copy the tics
-					pak = G_ScpyTiccmd(netcmds[i%BACKUPTICS], pak,
-						netbuffer->u.serverpak.numslots*sizeof (ticcmd_t));
+					M_Memcpy(netcmds[i%BACKUPTICS], cmds, netbuffer->u.serverpak.numslots * sizeof (ticcmd_t));
+					base = netcmds[i%BACKUPTICS];
 
 					// copy the textcmds
-					numtxtpak = *txtpak++;
+					pak = txtpak + 1;
 					for (j = 0; j < numtxtpak; j++)
 					{
-						INT32 k = *txtpak++; // playernum
-						const size_t txtsize = txtpak[0]+1;
+						INT32 k = *pak++; // playernum
+						const size_t txtsize = pak[0]+1;
 
 						if (i >= gametic) // Don't copy old net commands
-							M_Memcpy(D_GetTextcmd(i, k), txtpak, txtsize);
-						txtpak += txtsize;
+							M_Memcpy(D_GetTextcmd(i, k), pak, txtsize);
+						pak += txtsize;
 					}
 				}
 
-				neededtic = realend;
+				if (i < realend)
+					DEBFILE(va("truncated PT_SERVERTICS at tic %u\n", i));
+
+				if (i > neededtic)
+					neededtic = i;
 			}
 			else
 			{
@@ -4978,113 +5510,24 @@ static void GetPackets(void)
 // Builds ticcmds for console player,
 // sends out a packet
 //
-// no more use random generator, because at very first tic isn't yet synchronized
 // Note: It is called consistAncy on purpose.
 //
-static INT16 Consistancy(void)
+// The hashes themselves are kept up to date by the game code as the tic
+// runs (see P_UpdateConsistancy), so this only has to fold them down.
+//
+static void Consistancy(UINT16 *cons)
 {
 	INT32 i;
-	UINT32 ret = 0;
-#ifdef MOBJCONSISTANCY
-	thinker_t *th;
-	mobj_t *mo;
-#endif
 
 	DEBFILE(va("TIC %u ", gametic));
 
-	for (i = 0; i < MAXPLAYERS; i++)
-	{
-		if (!playeringame[i])
-			ret ^= 0xCCCC;
-		else if (!players[i].mo);
-		else
-		{
-			ret += players[i].mo->x;
-			ret -= players[i].mo->y;
-			ret += players[i].powers[pw_shield];
-			ret *= i+1;
-		}
-	}
-	// I give up
-	// Coop desynching enemies is painful
-	if (!G_PlatformGametype())
-		ret += P_GetRandSeed();
-
-#ifdef MOBJCONSISTANCY
-	if (gamestate == GS_LEVEL)
+	for (i = 0; i < NUMCONSISTANCY; i++)
 	{
-		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
-		{
-			if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
-				continue;
-
-			mo = (mobj_t *)th;
-
-			if (mo->flags & (MF_SPECIAL | MF_SOLID | MF_PUSHABLE | MF_BOSS | MF_MISSILE | MF_SPRING | MF_MONITOR | MF_FIRE | MF_ENEMY | MF_PAIN | MF_STICKY))
-			{
-				ret -= mo->type;
-				ret += mo->x;
-				ret -= mo->y;
-				ret += mo->z;
-				ret -= mo->momx;
-				ret += mo->momy;
-				ret -= mo->momz;
-				ret += mo->angle;
-				ret -= mo->flags;
-				ret += mo->flags2;
-				ret -= mo->eflags;
-				if (mo->target)
-				{
-					ret += mo->target->type;
-					ret -= mo->target->x;
-					ret += mo->target->y;
-					ret -= mo->target->z;
-					ret += mo->target->momx;
-					ret -= mo->target->momy;
-					ret += mo->target->momz;
-					ret -= mo->target->angle;
-					ret += mo->target->flags;
-					ret -= mo->target->flags2;
-					ret += mo->target->eflags;
-					ret -= mo->target->state - states;
-					ret += mo->target->tics;
-					ret -= mo->target->sprite;
-					ret += mo->target->frame;
-				}
-				else
-					ret ^= 0x3333;
-				if (mo->tracer && mo->tracer->type != MT_OVERLAY)
-				{
-					ret += mo->tracer->type;
-					ret -= mo->tracer->x;
-					ret += mo->tracer->y;
-					ret -= mo->tracer->z;
-					ret += mo->tracer->momx;
-					ret -= mo->tracer->momy;
-					ret += mo->tracer->momz;
-					ret -= mo->tracer->angle;
-					ret += mo->tracer->flags;
-					ret -= mo->tracer->flags2;
-					ret += mo->tracer->eflags;
-					ret -= mo->tracer->state - states;
-					ret += mo->tracer->tics;
-					ret -= mo->tracer->sprite;
-					ret += mo->tracer->frame;
-				}
-				else
-					ret ^= 0xAAAA;
-				ret -= mo->state - states;
-				ret += mo->tics;
-				ret -= mo->sprite;
-				ret += mo->frame;
-			}
-		}
+		cons[i] = (UINT16)((consistancyhash[i] ^ (consistancyhash[i] >> 16)) & 0xFFFF);
+		DEBFILE(va("%s = %u ", consistancynames[i], cons[i]));
 	}
-#endif
-
-	DEBFILE(va("Consistancy = %u\n", (ret & 0xFFFF)));
 
-	return (INT16)(ret & 0xFFFF);
+	DEBFILE("\n");
 }
 
 // confusing, but this DOESN'T send PT_NODEKEEPALIVE, it sends PT_BASICKEEPALIVE
@@ -5114,6 +5557,7 @@ static void SV_SendServerKeepAlive(void)
 static void CL_SendClientCmd(void)
 {
 	size_t packetsize = 0;
+	INT32 i;
 	boolean mis = false;
 
 	netbuffer->packettype = PT_CLIENTCMD;
@@ -5131,14 +5575,15 @@ static void CL_SendClientCmd(void)
 	{
 		// Send PT_NODEKEEPALIVE packet
 		netbuffer->packettype = (mis ? PT_NODEKEEPALIVEMIS : PT_NODEKEEPALIVE);
-		packetsize = sizeof (clientcmd_pak) - sizeof (ticcmd_t) - sizeof (INT16);
+		packetsize = sizeof (clientcmd_pak) - sizeof (ticcmd_t) - sizeof (netbuffer->u.clientpak.consistancy);
 		HSendPacket(servernode, false, 0, packetsize);
 	}
 	else if (gamestate != GS_NULL && (addedtogame || dedicated))
 	{
 		packetsize = sizeof (clientcmd_pak);
 		G_MoveTiccmd(&netbuffer->u.clientpak.cmd, &localcmds, 1);
-		netbuffer->u.clientpak.consistancy = SHORT(consistancy[gametic%BACKUPTICS]);
+		for (i = 0; i < NUMCONSISTANCY; i++)
+			netbuffer->u.clientpak.consistancy[i] = SHORT(consistancy[gametic%BACKUPTICS][i]);
 
 		// Send a special packet with 2 cmd for splitscreen
 		if (splitscreen || botingame)
@@ -5182,9 +5627,11 @@ static void SV_SendTics(void)
 	tic_t realfirsttic, lasttictosend, i;
 	UINT32 n;
 	INT32 j;
-	size_t packsize;
+	size_t packsize, cmdsize, ticsize;
 	UINT8 *bufpos;
 	UINT8 *ntextcmd;
+	const ticcmd_t *base;
+	static UINT8 ticbuf[MAXTICCMDSSIZE(MAXPLAYERS)];
 
 	// send to all client but not to me
 	// for each node create a packet with x tics and send it
@@ -5213,54 +5660,60 @@ static void SV_SendTics(void)
 			if (realfirsttic < firstticstosend)
 				realfirsttic = firstticstosend;
 
-			// compute the length of the packet and cut it if too large
+			// Tics the node may have gotten with another number of slots
+			// can't be used as a delta base. No tic that was ever sent to
+			// it is past lasttictosend yet, so start from there.
+			if (doomcom->numslots != deltaslots[n])
+			{
+				deltaslots[n] = doomcom->numslots;
+				if (deltafirsttic[n] < lasttictosend)
+					deltafirsttic[n] = lasttictosend;
+			}
+
+			// Encode the first tic against the one before it if the node
+			// has it for sure: it won't accept the packet otherwise.
+			// Tics before firstticstosend may already be cleared.
+			netbuffer->packettype = PT_SERVERTICS;
+			netbuffer->u.serverpak.starttic = realfirsttic;
+			netbuffer->u.serverpak.numslots = (UINT8)SHORT(doomcom->numslots);
+			netbuffer->u.serverpak.deltabase = (realfirsttic > deltafirsttic[n] && realfirsttic > firstticstosend);
+			base = netbuffer->u.serverpak.deltabase ? netcmds[(realfirsttic - 1)%BACKUPTICS] : nullcmds;
+			bufpos = netbuffer->u.serverpak.cmds;
 			packsize = BASESERVERTICSSIZE;
+
 			for (i = realfirsttic; i < lasttictosend; i++)
 			{
-				packsize += sizeof (ticcmd_t) * doomcom->numslots;
-				packsize += TotalTextCmdPerTic(i);
+				// Encode the tic and cut the packet if it gets too large
+				cmdsize = SV_WriteTiccmds(ticbuf, netcmds[i%BACKUPTICS], base, doomcom->numslots) - ticbuf;
+				ticsize = cmdsize + TotalTextCmdPerTic(i);
 
-				if (packsize > software_MAXPACKETLENGTH)
+				if (packsize + ticsize > software_MAXPACKETLENGTH)
 				{
 					DEBFILE(va("packet too large (%s) at tic %d (should be from %d to %d)\n",
-						sizeu1(packsize), i, realfirsttic, lasttictosend));
-					lasttictosend = i;
+						sizeu1(packsize + ticsize), i, realfirsttic, lasttictosend));
 
 					// too bad: too much player have send extradata and there is too
 					//          much data in one tic.
 					// To avoid it put the data on the next tic. (see getpacket
 					// textcmd case) but when numplayer changes the computation can be different
-					if (lasttictosend == realfirsttic)
+					if (i > realfirsttic)
 					{
-						if (packsize > MAXPACKETLENGTH)
-							I_Error("Too many players: can't send %s data for %d players to node %d\n"
-							        "Well sorry nobody is perfect....\n",
-							        sizeu1(packsize), doomcom->numslots, n);
-						else
-						{
-							lasttictosend++; // send it anyway!
-							DEBFILE("sending it anyway\n");
-						}
+						lasttictosend = i;
+						break;
 					}
-					break;
+					else if (packsize + ticsize > MAXPACKETLENGTH)
+						I_Error("Too many players: can't send %s data for %d players to node %d\n"
+						        "Well sorry nobody is perfect....\n",
+						        sizeu1(packsize + ticsize), doomcom->numslots, n);
+					else
+						DEBFILE("sending it anyway\n");
 				}
-			}
 
-			// Send the tics
-			netbuffer->packettype = PT_SERVERTICS;
-			netbuffer->u.serverpak.starttic = realfirsttic;
-			netbuffer->u.serverpak.numtics = (UINT8)(lasttictosend - realfirsttic);
-			netbuffer->u.serverpak.numslots = (UINT8)SHORT(doomcom->numslots);
-			bufpos = (UINT8 *)&netbuffer->u.serverpak.cmds;
+				M_Memcpy(bufpos, ticbuf, cmdsize);
+				bufpos += cmdsize;
+				base = netcmds[i%BACKUPTICS];
 
-			for (i = realfirsttic; i < lasttictosend; i++)
-			{
-				bufpos = G_DcpyTiccmd(bufpos, netcmds[i%BACKUPTICS], doomcom->numslots * sizeof (ticcmd_t));
-			}
-
-			// add textcmds
-			for (i = realfirsttic; i < lasttictosend; i++)
-			{
+				// add textcmds
 				ntextcmd = bufpos++;
 				*ntextcmd = 0;
 				for (j = 0; j < MAXPLAYERS; j++)
@@ -5276,8 +5729,10 @@ static void SV_SendTics(void)
 						bufpos += size + 1;
 					}
 				}
+
+				packsize = bufpos - (UINT8 *)&(netbuffer->u);
 			}
-			packsize = bufpos - (UINT8 *)&(netbuffer->u);
+			netbuffer->u.serverpak.numtics = (UINT8)(lasttictosend - realfirsttic);
 
 			HSendPacket(n, false, 0, packsize);
 			// when tic are too large, only one tic is sent so don't go backward!
@@ -5433,12 +5888,13 @@ boolean TryRunTics(tic_t realtics)
 				G_Ticker((gametic % NEWTICRATERATIO) == 0);
 				ExtraDataTicker();
 				gametic++;
-				consistancy[gametic%BACKUPTICS] = Consistancy();
+				Consistancy(consistancy[gametic%BACKUPTICS]);
 
 				if (update_stats)
 				{
 					PS_STOP_TIMING(ps_tictime);
 					PS_UpdateTickStats();
+					D_SoakTic(ps_tictime.value.p);
 				}
 
 				// Leave a certain amount of tics present in the net buffer as long as we've ran at least one tic this frame.
@@ -5609,6 +6065,7 @@ void NetKeepAlive(void)
 	Net_AckTicker();
 	HandleNodeTimeouts();
 	FileSendTicker();
+	Net_FlushFrames();
 }
 
 void NetUpdate(void)
@@ -5782,6 +6239,7 @@ void NetUpdate(void)
 	}
 
 	FileSendTicker();
+	Net_FlushFrames();
 }
 
 /** Returns the number of players playing.
@@ -17,8 +17,10 @@
 #include "d_net.h"
 #include "d_netcmd.h"
 #include "d_net.h"
+#include "i_net.h"
 #include "tables.h"
 #include "d_player.h"
+#include "p_tick.h"
 #include "mserv.h"
 
 /*
@@ -30,7 +32,7 @@ packet versions.
 If you change the struct or the meaning of a field
 therein, increment this number.
 */
-#define PACKETVERSION 4
+#define PACKETVERSION 9
 
 // Network play related stuff.
 // There is a data struct that stores network
@@ -79,6 +81,8 @@ typedef enum
 
 	PT_BASICKEEPALIVE,// Keep the network alive during wipes, as tics aren't advanced and NetUpdate isn't called
 
+	PT_BUNDLE,        // Several packets sent to the same node in one datagram
+
 	// Add non-PT_CANFAIL packet types here to avoid breaking MS compatibility.
 
 	PT_CANFAIL,       // This is kind of a priority. Anything bigger than CANFAIL
@@ -106,6 +110,7 @@ typedef enum
 #ifdef PACKETDROP
 void Command_Drop(void);
 void Command_Droprate(void);
+void Command_Delaypacket(void);
 #endif
 #ifdef _DEBUG
 void Command_Numnodes(void);
@@ -120,7 +125,7 @@ typedef struct
 {
 	UINT8 client_tic;
 	UINT8 resendfrom;
-	INT16 consistancy;
+	UINT16 consistancy[NUMCONSISTANCY];
 	ticcmd_t cmd;
 } ATTRPACK clientcmd_pak;
 
@@ -130,7 +135,7 @@ typedef struct
 {
 	UINT8 client_tic;
 	UINT8 resendfrom;
-	INT16 consistancy;
+	UINT16 consistancy[NUMCONSISTANCY];
 	ticcmd_t cmd, cmd2;
 } ATTRPACK client2cmd_pak;
 
@@ -145,7 +150,8 @@ typedef struct
 	tic_t starttic;
 	UINT8 numtics;
 	UINT8 numslots; // "Slots filled": Highest player number in use plus one.
-	ticcmd_t cmds[45]; // Normally [BACKUPTIC][MAXPLAYERS] but too large
+	UINT8 deltabase; // If set, the first tic is delta-encoded against starttic - 1
+	UINT8 cmds[45 * sizeof (ticcmd_t)]; // Delta-encoded ticcmds and textcmds for each tic, see SV_WriteTiccmds
 } ATTRPACK servertics_pak;
 
 typedef struct
@@ -202,8 +208,14 @@ typedef struct
 	UINT8 localplayers;
 	UINT8 mode;
 	char names[MAXSPLITSCREENPLAYERS][MAXPLAYERNAME];
+	UINT8 gamestatecodecs; // 1 << GAMESTATECODEC_* for each codec the client can decode
 } ATTRPACK clientconfig_pak;
 
+// How a sent gamestate is compressed, stored in its first byte
+#define GAMESTATECODEC_NONE 0
+#define GAMESTATECODEC_LZF 1
+#define GAMESTATECODEC_DEFLATE 2
+
 #define SV_DEDICATED    0x40 // server is dedicated
 #define SV_LOTSOFADDONS 0x20 // flag used to ask for full file list in d_netfil
 
@@ -296,6 +308,13 @@ typedef struct
 	UINT8 files[MAXFILENEEDED]; // is filled with writexxx (byteptr.h)
 } ATTRPACK filesneededconfig_pak;
 
+// The gamestate a client already has, so a resend can be a delta against it
+typedef struct
+{
+	UINT32 length; // 0 if the client has no gamestate to offer
+	UINT8 md5sum[16];
+} ATTRPACK gamestatebase_pak;
+
 //
 // Network packet data
 //
@@ -328,6 +347,8 @@ typedef struct
 		INT32 filesneedednum;               //           4 bytes
 		filesneededconfig_pak filesneededcfg; //       ??? bytes
 		UINT32 pingtable[MAXPLAYERS+1];     //          68 bytes
+		gamestatebase_pak gamestatebase;    //          20 bytes
+		UINT8 bundle[MAXPACKETLENGTH];      // Up to hardware_MAXPACKETLENGTH
 	} u; // This is needed to pack diff packet types data together
 } ATTRPACK doomdata_t;
 
@@ -397,9 +418,12 @@ extern UINT32 realpingtable[MAXPLAYERS];
 extern UINT32 playerpingtable[MAXPLAYERS];
 extern tic_t servermaxping;
 
+// Names of the parts of the game state checked for desyncs
+extern const char *const consistancynames[NUMCONSISTANCY];
+
 extern consvar_t cv_netticbuffer, cv_allownewplayer, cv_joinnextround, cv_maxplayers, cv_joindelay, cv_rejointimeout;
 extern consvar_t cv_resynchattempts, cv_blamecfail;
-extern consvar_t cv_maxsend, cv_noticedownload, cv_downloadspeed;
+extern consvar_t cv_maxsend, cv_noticedownload, cv_downloadspeed, cv_downloadcache, cv_gamestatecompression;
 extern consvar_t cv_dedicatedidletime;
 
 // Used in d_net, the only dependence
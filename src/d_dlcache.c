@@ -0,0 +1,411 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_dlcache.c
+/// \brief Content-addressed cache of downloaded addons
+///
+///        Downloaded files are kept in DOWNLOAD/cache/<md5>/<name>, so a
+///        server asking for a file we already downloaded elsewhere finds
+///        it by its MD5 sum at once, instead of searching every directory
+///        for it or downloading it again. The index in DOWNLOAD/cache
+///        remembers when each file was last used, and the least recently
+///        used files are deleted once the cache grows past
+///        cv_downloadcache megabytes.
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "doomdef.h"
+#include "d_netfil.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "m_md5cache.h"
+#include "w_wad.h"
+#include "z_zone.h"
+#include "d_dlcache.h"
+
+#define DLCACHEDIR "cache"
+#define DLCACHEINDEX "index.txt"
+#define DLCACHEMAGIC "SRB2DLC"
+
+#define DLCACHEBUCKETS 64
+
+typedef struct
+{
+	UINT8 md5sum[16];
+	char name[MAX_WADPATH];
+	UINT64 size;
+	UINT64 lastused;
+	INT32 next; // Next entry in the same bucket, or -1
+} dlcacheentry_t;
+
+static dlcacheentry_t *dlentries = NULL;
+static INT32 numdlentries = 0;
+static INT32 maxdlentries = 0;
+static INT32 dlbuckets[DLCACHEBUCKETS];
+
+static boolean dlcacheloaded = false;
+static boolean dlcachedirty = false;
+
+boolean D_DownloadCacheEnabled(void)
+{
+	return cv_downloadcache.value != 0;
+}
+
+static const char *D_DownloadCacheDir(void)
+{
+	return va("%s"PATHSEP DLCACHEDIR, downloaddir);
+}
+
+static void D_MD5Hex(const UINT8 *md5sum, char *hex)
+{
+	INT32 i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&hex[i*2], "%02x", md5sum[i]);
+}
+
+// Path of a cached file, or false if it doesn't fit in MAX_WADPATH
+static boolean D_CacheEntryPath(const UINT8 *md5sum, const char *name, char *path)
+{
+	char md5hex[33];
+
+	D_MD5Hex(md5sum, md5hex);
+	return (size_t)snprintf(path, MAX_WADPATH, "%s"PATHSEP"%s"PATHSEP"%s",
+		D_DownloadCacheDir(), md5hex, name) < MAX_WADPATH;
+}
+
+static INT32 D_DownloadCacheBucket(const UINT8 *md5sum)
+{
+	return (md5sum[0] | (md5sum[1] << 8)) % DLCACHEBUCKETS;
+}
+
+static void D_RehashDownloadCache(void)
+{
+	INT32 i;
+
+	for (i = 0; i < DLCACHEBUCKETS; i++)
+		dlbuckets[i] = -1;
+
+	for (i = 0; i < numdlentries; i++)
+	{
+		INT32 bucket = D_DownloadCacheBucket(dlentries[i].md5sum);
+		dlentries[i].next = dlbuckets[bucket];
+		dlbuckets[bucket] = i;
+	}
+}
+
+static dlcacheentry_t *D_FindDownloadCacheEntry(const UINT8 *md5sum, const char *name)
+{
+	INT32 i;
+
+	for (i = dlbuckets[D_DownloadCacheBucket(md5sum)]; i != -1; i = dlentries[i].next)
+		if (!memcmp(dlentries[i].md5sum, md5sum, 16) && !stricmp(dlentries[i].name, name))
+			return &dlentries[i];
+
+	return NULL;
+}
+
+static dlcacheentry_t *D_AddDownloadCacheEntry(const UINT8 *md5sum, const char *name)
+{
+	dlcacheentry_t *entry = D_FindDownloadCacheEntry(md5sum, name);
+	INT32 bucket;
+
+	if (entry)
+		return entry;
+
+	if (numdlentries == maxdlentries)
+	{
+		maxdlentries = maxdlentries ? maxdlentries * 2 : 32;
+		dlentries = Z_Realloc(dlentries, maxdlentries * sizeof (*dlentries), PU_STATIC, NULL);
+	}
+
+	bucket = D_DownloadCacheBucket(md5sum);
+	entry = &dlentries[numdlentries];
+	memset(entry, 0, sizeof (*entry));
+	memcpy(entry->md5sum, md5sum, 16);
+	strlcpy(entry->name, name, sizeof (entry->name));
+	entry->next = dlbuckets[bucket];
+	dlbuckets[bucket] = numdlentries++;
+	return entry;
+}
+
+static void D_RemoveDownloadCacheEntry(dlcacheentry_t *entry, boolean deletefile)
+{
+	char path[MAX_WADPATH];
+
+	if (deletefile && D_CacheEntryPath(entry->md5sum, entry->name, path))
+	{
+		remove(path);
+		// Remove the then empty <md5> directory too, where remove() can.
+		*strrchr(path, PATHSEP[0]) = '\0';
+		remove(path);
+	}
+
+	*entry = dlentries[--numdlentries];
+	D_RehashDownloadCache();
+}
+
+static void D_LoadDownloadCache(void)
+{
+	UINT8 *buffer;
+	char *line, *next;
+	INT32 version;
+	INT32 i;
+
+	if (dlcacheloaded)
+		return;
+
+	dlcacheloaded = true;
+	D_RehashDownloadCache();
+
+	if (!FIL_ReadFile(va("%s"PATHSEP DLCACHEINDEX, D_DownloadCacheDir()), &buffer))
+		return;
+
+	line = (char *)buffer;
+	next = strchr(line, '\n');
+
+	if (next && sscanf(line, DLCACHEMAGIC" %d", &version) == 1 && version == DLCACHEVERSION)
+	{
+		// Each line is "md5 size lastused name".
+		for (line = next + 1; (next = strchr(line, '\n')) != NULL; line = next + 1)
+		{
+			char md5hex[33];
+			unsigned long long size, lastused;
+			UINT8 md5sum[16];
+			dlcacheentry_t *entry;
+			int namestart;
+			unsigned int byte;
+
+			*next = '\0';
+
+			if (sscanf(line, "%32s %llu %llu %n", md5hex, &size, &lastused, &namestart) != 3
+				|| strlen(md5hex) != 32 || !line[namestart])
+				continue;
+
+			for (i = 0; i < 16; i++)
+			{
+				if (sscanf(&md5hex[i*2], "%2x", &byte) != 1)
+					break;
+				md5sum[i] = (UINT8)byte;
+			}
+
+			if (i < 16)
+				continue;
+
+			entry = D_AddDownloadCacheEntry(md5sum, &line[namestart]);
+			entry->size = size;
+			entry->lastused = lastused;
+		}
+	}
+
+	Z_Free(buffer);
+	CONS_Debug(DBG_NETPLAY, "D_LoadDownloadCache: %d files cached\n", numdlentries);
+}
+
+/** Writes the index out if anything changed since it was last saved.
+  * Lookups only mark it changed, so this is called once they're done:
+  * after checking a server's files, and on shutdown.
+  */
+void D_SaveDownloadCache(void)
+{
+	char path[MAX_WADPATH];
+	char temppath[MAX_WADPATH + 4];
+	char md5hex[33];
+	FILE *f;
+	INT32 i;
+
+	if (!dlcachedirty)
+		return;
+
+	dlcachedirty = false;
+
+	I_mkdir(D_DownloadCacheDir(), 0755);
+
+	snprintf(path, sizeof(path), "%s"PATHSEP DLCACHEINDEX, D_DownloadCacheDir());
+	snprintf(temppath, sizeof(temppath), "%s.tmp", path);
+
+	f = fopen(temppath, "wb");
+	if (!f)
+		return;
+
+	fprintf(f, DLCACHEMAGIC" %d\n", DLCACHEVERSION);
+
+	for (i = 0; i < numdlentries; i++)
+	{
+		D_MD5Hex(dlentries[i].md5sum, md5hex);
+		fprintf(f, "%s %llu %llu %s\n", md5hex,
+			(unsigned long long)dlentries[i].size,
+			(unsigned long long)dlentries[i].lastused,
+			dlentries[i].name);
+	}
+
+	// Write to a temporary file first, so an interrupted write
+	// can never leave a truncated index behind.
+	if (fclose(f) == 0)
+	{
+		remove(path);
+		if (rename(temppath, path) != 0)
+			remove(temppath);
+	}
+	else
+		remove(temppath);
+}
+
+static boolean D_CachedFileInUse(const dlcacheentry_t *entry)
+{
+	INT32 i;
+
+	for (i = 0; i < numwadfiles; i++)
+		if (wadfiles[i]->type != RET_FOLDER && !memcmp(wadfiles[i]->md5sum, entry->md5sum, 16))
+			return true;
+
+	return false;
+}
+
+// Deletes the least recently used files until the cache fits in its
+// budget again. Files that are loaded, and the one just added, stay.
+static void D_TrimDownloadCache(const dlcacheentry_t *keep)
+{
+	UINT64 budget = (UINT64)cv_downloadcache.value << 20;
+	UINT64 total = 0;
+	UINT8 keepmd5[16];
+	char keepname[MAX_WADPATH];
+	INT32 i;
+
+	memcpy(keepmd5, keep->md5sum, 16);
+	strlcpy(keepname, keep->name, sizeof keepname);
+
+	for (i = 0; i < numdlentries; i++)
+		total += dlentries[i].size;
+
+	while (total > budget)
+	{
+		dlcacheentry_t *oldest = NULL;
+
+		for (i = 0; i < numdlentries; i++)
+		{
+			dlcacheentry_t *entry = &dlentries[i];
+
+			if ((!memcmp(entry->md5sum, keepmd5, 16) && !stricmp(entry->name, keepname))
+				|| D_CachedFileInUse(entry))
+				continue;
+
+			if (!oldest || entry->lastused < oldest->lastused)
+				oldest = entry;
+		}
+
+		if (!oldest)
+			break;
+
+		CONS_Debug(DBG_NETPLAY, "D_TrimDownloadCache: deleting %s\n", oldest->name);
+		total -= oldest->size;
+		D_RemoveDownloadCacheEntry(oldest, true);
+	}
+}
+
+/** Looks for a file in the download cache.
+  *
+  * \param md5sum   MD5 sum of the file.
+  * \param filename Name of the file, the path is ignored.
+  * \param path     Set to the path of the cached file, MAX_WADPATH long.
+  * \return true if the cache holds the file, with the right MD5 sum.
+  */
+boolean D_FindCachedDownload(const UINT8 *md5sum, const char *filename, char *path)
+{
+	char name[MAX_WADPATH];
+	dlcacheentry_t *entry;
+	UINT8 realmd5sum[16];
+
+	if (!D_DownloadCacheEnabled())
+		return false;
+
+	D_LoadDownloadCache();
+
+	strlcpy(name, filename, sizeof name);
+	nameonly(name);
+
+	entry = D_FindDownloadCacheEntry(md5sum, name);
+	if (!entry || !D_CacheEntryPath(md5sum, entry->name, path))
+		return false;
+
+	// The MD5 index makes this check cheap for files that didn't change.
+	if (!M_FileMD5(path, realmd5sum) || memcmp(realmd5sum, md5sum, 16))
+	{
+		CONS_Debug(DBG_NETPLAY, "D_FindCachedDownload: %s is gone or damaged\n", path);
+		D_RemoveDownloadCacheEntry(entry, true);
+		dlcachedirty = true;
+		return false;
+	}
+
+	entry->lastused = (UINT64)time(NULL);
+	dlcachedirty = true;
+	return true;
+}
+
+/** Gets the path a file about to be downloaded should be written to,
+  * creating its directory.
+  *
+  * \param md5sum   MD5 sum of the file.
+  * \param filename Name of the file, the path is ignored.
+  * \param path     Set to the path, MAX_WADPATH long. Left alone if the
+  *                 path doesn't fit, so the caller's default stays.
+  */
+void D_CachedDownloadPath(const UINT8 *md5sum, const char *filename, char *path)
+{
+	char name[MAX_WADPATH];
+	char cachepath[MAX_WADPATH];
+
+	strlcpy(name, filename, sizeof name);
+	nameonly(name);
+
+	if (!D_CacheEntryPath(md5sum, name, cachepath))
+		return;
+
+	I_mkdir(downloaddir, 0755);
+	I_mkdir(D_DownloadCacheDir(), 0755);
+	*strrchr(cachepath, PATHSEP[0]) = '\0';
+	I_mkdir(cachepath, 0755);
+	cachepath[strlen(cachepath)] = PATHSEP[0];
+
+	strlcpy(path, cachepath, MAX_WADPATH);
+}
+
+/** Adds a finished download to the cache, deleting old files if the cache
+  * is now over its budget.
+  *
+  * \param md5sum MD5 sum of the file.
+  * \param path   Where the file was downloaded to. Files that weren't
+  *               downloaded into the cache are ignored.
+  */
+void D_AddCachedDownload(const UINT8 *md5sum, const char *path)
+{
+	char name[MAX_WADPATH];
+	char cachepath[MAX_WADPATH];
+	dlcacheentry_t *entry;
+	struct stat fsstat;
+
+	strlcpy(name, path, sizeof name);
+	nameonly(name);
+
+	if (!D_CacheEntryPath(md5sum, name, cachepath) || strcmp(cachepath, path)
+		|| stat(path, &fsstat) < 0)
+		return;
+
+	D_LoadDownloadCache();
+
+	entry = D_AddDownloadCacheEntry(md5sum, name);
+	entry->size = (UINT64)fsstat.st_size;
+	entry->lastused = (UINT64)time(NULL);
+
+	if (D_DownloadCacheEnabled())
+		D_TrimDownloadCache(entry);
+
+	dlcachedirty = true;
+	D_SaveDownloadCache();
+}
@@ -0,0 +1,26 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_dlcache.h
+/// \brief Content-addressed cache of downloaded addons
+
+#ifndef __D_DLCACHE__
+#define __D_DLCACHE__
+
+#include "doomtype.h"
+
+// Bump this whenever the layout of the index file changes.
+#define DLCACHEVERSION 1
+
+boolean D_DownloadCacheEnabled(void);
+boolean D_FindCachedDownload(const UINT8 *md5sum, const char *filename, char *path);
+void D_CachedDownloadPath(const UINT8 *md5sum, const char *filename, char *path);
+void D_AddCachedDownload(const UINT8 *md5sum, const char *path);
+void D_SaveDownloadCache(void);
+
+#endif
@@ -29,6 +29,7 @@
 #include "z_zone.h"
 #include "i_tcp.h"
 #include "d_main.h" // srb2home
+#include "byteptr.h"
 
 //
 // NETWORKING
@@ -65,10 +66,12 @@ INT32 net_bandwidth;
 
 /// \brief max length per packet
 INT16 hardware_MAXPACKETLENGTH;
+precise_t net_arrivaltime;
 
 boolean (*I_NetGet)(void) = NULL;
 void (*I_NetSend)(void) = NULL;
 boolean (*I_NetCanSend)(void) = NULL;
+void (*I_NetFlush)(void) = NULL;
 boolean (*I_NetCanGet)(void) = NULL;
 void (*I_NetCloseSocket)(void) = NULL;
 void (*I_NetFreeNodenum)(INT32 nodenum) = NULL;
@@ -145,6 +148,7 @@ typedef struct
 	UINT8 nextacknum;
 	UINT8 destinationnode; // The node to send the ack to
 	tic_t senttime; // The time when the ack was sent
+	precise_t sentprecise; // Same, precisely, to measure the round trip
 	UINT16 length; // The packet size
 	UINT16 resentnum; // The number of times the ack has been resent
 	union {
@@ -163,6 +167,27 @@ typedef enum
 #ifndef NONET
 // Table of packets that were not acknowleged can be resent (the sender window)
 static ackpak_t ackpak[MAXACKPACKETS];
+
+// Packets sent to a node in game are queued in its frame, and sent together
+// as a single PT_BUNDLE datagram once per tic or when the frame is full.
+// Each packet keeps its own header, so acks work as if they were sent apart.
+#define BUNDLEENTRYHEADER 2 // Length of the packet that follows
+
+typedef struct
+{
+	UINT16 length; // Bytes used in data
+	UINT16 count; // Number of packets queued
+	UINT8 data[MAXPACKETLENGTH];
+} netframe_t;
+
+static netframe_t netframes[MAXNETNODES];
+
+// Bundle being split back into packets by HGetPacket
+static UINT8 bundlebuffer[MAXPACKETLENGTH];
+static size_t bundlepos, bundlelength;
+static INT16 bundlenode;
+
+static void FlushFrame(INT32 node);
 #endif
 
 typedef struct
@@ -185,12 +210,17 @@ typedef struct
 	UINT8 remotefirstack;
 	UINT8 nextacknum;
 
+	// Smoothed round trip time of acked packets, in microseconds, 0 if unknown
+	UINT32 roundtrip;
+
 	UINT8 flags;
 } node_t;
 
 static node_t nodes[MAXNETNODES];
 #define NODETIMEOUT 14
 
+netnodestats_t netnodestats[MAXNETNODES];
+
 #ifndef NONET
 // return <0 if a < b (mod 256)
 //         0 if a = n (mod 256)
@@ -251,6 +281,7 @@ static boolean GetFreeAcknum(UINT8 *freeack, boolean lowtimer)
 				ackpak[i].senttime = I_GetTime();
 				ackpak[i].resentnum = 0;
 			}
+			ackpak[i].sentprecise = I_GetPreciseTime();
 			M_Memcpy(ackpak[i].pak.raw, netbuffer, ackpak[i].length);
 
 			*freeack = ackpak[i].acknum;
@@ -315,6 +346,24 @@ static void RemoveAck(INT32 i)
 		Net_CloseConnection(node);
 }
 
+// The packet in ackpak[i] made it, time it then forget it
+static void AckReceived(INT32 i)
+{
+	// Can't tell which copy a resent packet's ack is for
+	if (!ackpak[i].resentnum)
+	{
+		node_t *node = &nodes[ackpak[i].destinationnode];
+		UINT32 sample = (UINT32)((net_arrivaltime - ackpak[i].sentprecise) * 1000000 / I_GetPrecisePrecision());
+
+		if (node->roundtrip)
+			node->roundtrip = node->roundtrip - node->roundtrip/8 + sample/8;
+		else
+			node->roundtrip = sample;
+	}
+
+	RemoveAck(i);
+}
+
 // We have got a packet, proceed the ack request and ack return
 static boolean Processackpak(void)
 {
@@ -331,7 +380,7 @@ static boolean Processackpak(void)
 			if (ackpak[i].acknum && ackpak[i].destinationnode == node - nodes
 				&& cmpack(ackpak[i].acknum, netbuffer->ackreturn) <= 0)
 			{
-				RemoveAck(i);
+				AckReceived(i);
 			}
 	}
 
@@ -428,6 +477,24 @@ static boolean Processackpak(void)
 }
 #endif
 
+/** Gets the measured network round trip time to a node
+  *
+  * \param node The node
+  * \return Round trip in milliseconds, 0 if nothing was measured yet
+  *
+  */
+UINT32 Net_GetRoundTripTime(INT32 node)
+{
+#ifdef NONET
+	(void)node;
+	return 0;
+#else
+	if (node <= 0 || node >= MAXNETNODES)
+		return 0;
+	return (nodes[node].roundtrip + 500) / 1000;
+#endif
+}
+
 // send special packet with only ack on it
 void Net_SendAcks(INT32 node)
 {
@@ -451,7 +518,7 @@ static void GotAcks(void)
 				if (ackpak[i].acknum && ackpak[i].destinationnode == doomcom->remotenode)
 				{
 					if (ackpak[i].acknum == netbuffer->u.textcmd[j])
-						RemoveAck(i);
+						AckReceived(i);
 					// nextacknum is first equal to acknum, then when receiving bigger ack
 					// there is big chance the packet is lost
 					// When resent, nextacknum = nodes[node].nextacknum
@@ -514,6 +581,7 @@ void Net_AckTicker(void)
 			ackpak[i].resentnum++;
 			ackpak[i].nextacknum = node->nextacknum;
 			retransmit++; // For stat
+			netnodestats[nodei].resent++;
 			HSendPacket((INT32)(node - nodes), false, ackpak[i].acknum,
 				(size_t)(ackpak[i].length - BASEPACKETSIZE));
 		}
@@ -536,6 +604,8 @@ void Net_AckTicker(void)
 			}
 		}
 	}
+
+	Net_FlushFrames();
 #endif
 }
 
@@ -632,6 +702,7 @@ static void InitNode(node_t *node)
 	node->firstacktosend = 0;
 	node->nextacknum = 1;
 	node->remotefirstack = 0;
+	node->roundtrip = 0;
 	node->flags = 0;
 }
 
@@ -642,6 +713,9 @@ static void InitAck(void)
 #ifndef NONET
 	for (i = 0; i < MAXACKPACKETS; i++)
 		ackpak[i].acknum = 0;
+
+	memset(netframes, 0, sizeof (netframes));
+	bundlepos = bundlelength = 0;
 #endif
 
 	for (i = 0; i < MAXNETNODES; i++)
@@ -717,7 +791,9 @@ void Net_CloseConnection(INT32 node)
 				ackpak[i].acknum = 0;
 		}
 
+	FlushFrame(node);
 	InitNode(&nodes[node]);
+	memset(&netnodestats[node], 0, sizeof (netnodestats[node]));
 	SV_AbortSendFiles(node);
 	if (server)
 		SV_AbortLuaFileTransfer(node);
@@ -810,6 +886,10 @@ static const char *packettypename[NUMPACKETTYPE] =
 	"ASKLUAFILE",
 	"HASLUAFILE",
 
+	"BASICKEEPALIVE",
+
+	"BUNDLE",
+
 	"FILEFRAGMENT",
 	"FILEACK",
 	"FILERECEIVED",
@@ -843,20 +923,13 @@ static void DebugPrintpacket(const char *header)
 		case PT_SERVERTICS:
 		{
 			servertics_pak *serverpak = &netbuffer->u.serverpak;
-			UINT8 *cmd = (UINT8 *)(&serverpak->cmds[serverpak->numslots * serverpak->numtics]);
-			size_t ntxtcmd = &((UINT8 *)netbuffer)[doomcom->datalength] - cmd;
-
-			fprintf(debugfile, "    firsttic %u ply %d tics %d ntxtcmd %s\n    ",
-				(UINT32)serverpak->starttic, serverpak->numslots, serverpak->numtics, sizeu1(ntxtcmd));
-			/// \todo Display more readable information about net commands
-			fprintfstringnewline((char *)cmd, ntxtcmd);
-			/*fprintfstring((char *)cmd, 3);
-			if (ntxtcmd > 4)
-			{
-				fprintf(debugfile, "[%s]", netxcmdnames[*((cmd) + 3) - 1]);
-				fprintfstring(((char *)cmd) + 4, ntxtcmd - 4);
-			}
-			fprintf(debugfile, "\n");*/
+			size_t ncmd = &((UINT8 *)netbuffer)[doomcom->datalength] - serverpak->cmds;
+
+			fprintf(debugfile, "    firsttic %u ply %d tics %d delta %d cmds %s\n    ",
+				(UINT32)serverpak->starttic, serverpak->numslots, serverpak->numtics,
+				serverpak->deltabase, sizeu1(ncmd));
+			/// \todo Display more readable information about ticcmds and net commands
+			fprintfstringnewline((char *)serverpak->cmds, ncmd);
 			break;
 		}
 		case PT_CLIENTCMD:
@@ -986,15 +1059,258 @@ void Command_Droprate(void)
 	packetdroprate = droprate;
 }
 
+static INT32 packetdelay = 0, packetjitter = 0; // In milliseconds
+
+#ifndef NONET
+// Outgoing datagrams held back by delaypacket
+#define MAXDELAYEDPACKETS 512
+
+typedef struct
+{
+	precise_t due;
+	INT16 node;
+	INT16 length;
+	UINT8 data[MAXPACKETLENGTH];
+} delayedpacket_t;
+
+static delayedpacket_t *delayedpackets = NULL;
+static INT32 numdelayedpackets = 0;
+#endif
+
+void Command_Delaypacket(void)
+{
+	INT32 delay, jitter = 0;
+
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf("delaypacket <milliseconds> [jitter]: hold back every packet sent\n"
+					"Current delay: %d ms, jitter %d ms\n", packetdelay, packetjitter);
+		return;
+	}
+
+	delay = atoi(COM_Argv(1));
+	if (COM_Argc() >= 3)
+		jitter = atoi(COM_Argv(2));
+
+	if (delay < 0 || jitter < 0 || delay + jitter > 5000)
+	{
+		CONS_Printf("Packet delay must be between 0 and 5000 ms!\n");
+		return;
+	}
+
+#ifndef NONET
+	if ((delay || jitter) && !delayedpackets)
+		delayedpackets = Z_Malloc(MAXDELAYEDPACKETS * sizeof (*delayedpackets), PU_STATIC, NULL);
+#endif
+
+	packetdelay = delay;
+	packetjitter = jitter;
+}
+
 #ifndef NONET
 static boolean ShouldDropPacket(void)
 {
 	return (packetdropquantity[netbuffer->packettype])
 		|| (packetdroprate != 0 && rand() < (RAND_MAX * (packetdroprate / 100.f))) || packetdroprate == 100;
 }
+
+// Holds the datagram in doomcom until its delay is over
+static void DelayDatagram(void)
+{
+	delayedpacket_t *pak;
+	INT32 delay = packetdelay;
+
+	if (numdelayedpackets == MAXDELAYEDPACKETS)
+	{
+		DEBFILE("DelayDatagram: queue full, dropping\n");
+		return;
+	}
+
+	if (packetjitter)
+		delay += rand() % (packetjitter + 1);
+
+	pak = &delayedpackets[numdelayedpackets++];
+	pak->due = I_GetPreciseTime() + (precise_t)delay * I_GetPrecisePrecision() / 1000;
+	pak->node = doomcom->remotenode;
+	pak->length = doomcom->datalength;
+	M_Memcpy(pak->data, netbuffer, pak->length);
+}
+
+// Sends the delayed datagrams that are due, in the order they were sent
+static void SendDelayedDatagrams(void)
+{
+	const precise_t now = I_GetPreciseTime();
+	INT32 i, kept = 0;
+
+	for (i = 0; i < numdelayedpackets; i++)
+	{
+		delayedpacket_t *pak = &delayedpackets[i];
+
+		if ((INT64)(now - pak->due) >= 0)
+		{
+			doomcom->remotenode = pak->node;
+			doomcom->datalength = pak->length;
+			M_Memcpy(netbuffer, pak->data, pak->length);
+			I_NetSend();
+		}
+		else
+		{
+			if (kept != i)
+				delayedpackets[kept] = *pak;
+			kept++;
+		}
+	}
+
+	numdelayedpackets = kept;
+}
+#endif
 #endif
+
+#ifndef NONET
+static void SendDatagram(void)
+{
+	sendbytes += packetheaderlength + doomcom->datalength; // For stat
+	if (doomcom->remotenode < MAXNETNODES)
+		netnodestats[doomcom->remotenode].sentbytes += packetheaderlength + doomcom->datalength;
+
+#ifdef PACKETDROP
+	if (packetdelay || packetjitter)
+	{
+		DelayDatagram();
+		return;
+	}
 #endif
 
+	I_NetSend();
+}
+
+// Sends everything queued for a node
+static void FlushFrame(INT32 node)
+{
+	netframe_t *frame = &netframes[node];
+
+	if (!frame->count)
+		return;
+
+	if (frame->count == 1)
+	{
+		// Nothing to gain from wrapping a lone packet
+		doomcom->datalength = (INT16)(frame->length - BUNDLEENTRYHEADER);
+		M_Memcpy(netbuffer, frame->data + BUNDLEENTRYHEADER, doomcom->datalength);
+	}
+	else
+	{
+		netbuffer->ack = netbuffer->ackreturn = 0; // The packets inside carry their own
+		netbuffer->packettype = PT_BUNDLE;
+		netbuffer->reserved = 0;
+		M_Memcpy(netbuffer->u.bundle, frame->data, frame->length);
+		doomcom->datalength = (INT16)(BASEPACKETSIZE + frame->length);
+		netbuffer->checksum = NetbufferChecksum();
+	}
+
+	doomcom->remotenode = (INT16)node;
+	SendDatagram();
+
+	frame->length = frame->count = 0;
+}
+
+// Adds the packet in netbuffer to the frame of its node,
+// or sends it right away if it can't be bundled
+static void QueuePacket(void)
+{
+	const INT32 node = doomcom->remotenode;
+	const size_t length = doomcom->datalength;
+	const size_t maxlength = hardware_MAXPACKETLENGTH - BASEPACKETSIZE;
+	netframe_t *frame;
+	UINT8 *p;
+
+	if (node <= 0 || node >= MAXNETNODES) // Broadcast
+	{
+		SendDatagram();
+		return;
+	}
+
+	frame = &netframes[node];
+
+	// Send what is queued first if this packet can't join it,
+	// so the node still gets everything in order.
+	if (frame->count && (!nodeingame[node] || frame->length + BUNDLEENTRYHEADER + length > maxlength))
+	{
+		static UINT8 pending[MAXPACKETLENGTH];
+
+		M_Memcpy(pending, netbuffer, length);
+		FlushFrame(node);
+		M_Memcpy(netbuffer, pending, length);
+		doomcom->datalength = (INT16)length;
+		doomcom->remotenode = (INT16)node;
+	}
+
+	// Only nodes in game are known to understand bundles
+	if (!nodeingame[node] || BUNDLEENTRYHEADER + length > maxlength)
+	{
+		SendDatagram();
+		return;
+	}
+
+	p = frame->data + frame->length;
+	WRITEUINT16(p, (UINT16)length);
+	WRITEMEM(p, netbuffer, length);
+	frame->length = (UINT16)(p - frame->data);
+	frame->count++;
+}
+
+// Extracts the next packet of the bundle being read into netbuffer
+static boolean GetBundledPacket(void)
+{
+	UINT8 *p = bundlebuffer + bundlepos;
+	size_t length;
+
+	if (bundlelength - bundlepos < BUNDLEENTRYHEADER)
+	{
+		bundlepos = bundlelength;
+		return false;
+	}
+
+	length = READUINT16(p);
+	if (length < BASEPACKETSIZE || length > bundlelength - bundlepos - BUNDLEENTRYHEADER)
+	{
+		DEBFILE(va("Bad bundle from node %d\n", bundlenode));
+		bundlepos = bundlelength;
+		return false;
+	}
+
+	M_Memcpy(netbuffer, p, length);
+	doomcom->datalength = (INT16)length;
+	doomcom->remotenode = bundlenode;
+	bundlepos += BUNDLEENTRYHEADER + length;
+	return true;
+}
+#endif
+
+/** Sends every packet that is still queued
+  * Called once per tic, after everything for the tic has been sent
+  */
+void Net_FlushFrames(void)
+{
+#ifndef NONET
+	INT32 i;
+
+	if (!netgame)
+		return;
+
+	for (i = 1; i < MAXNETNODES; i++)
+		FlushFrame(i);
+
+#ifdef PACKETDROP
+	if (numdelayedpackets)
+		SendDelayedDatagrams();
+#endif
+
+	if (I_NetFlush)
+		I_NetFlush();
+#endif
+}
+
 //
 // HSendPacket
 //
@@ -1067,7 +1383,6 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 		netbuffer->ack = acknum;
 
 	netbuffer->checksum = NetbufferChecksum();
-	sendbytes += packetheaderlength + doomcom->datalength; // For stat
 
 #ifdef PACKETDROP
 	// Simulate internet :)
@@ -1079,7 +1394,7 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 		if (debugfile)
 			DebugPrintpacket("SENT");
 #endif
-		I_NetSend();
+		QueuePacket();
 #ifdef PACKETDROP
 	}
 	else
@@ -1132,21 +1447,38 @@ boolean HGetPacket(void)
 
 	while(true)
 	{
-		//nodejustjoined = I_NetGet();
-		I_NetGet();
+		boolean bundled = (bundlepos < bundlelength);
 
-		if (doomcom->remotenode == -1) // No packet received
-			return false;
-
-		getbytes += packetheaderlength + doomcom->datalength; // For stat
-
-		if (doomcom->remotenode >= MAXNETNODES)
+		if (bundled)
 		{
-			DEBFILE(va("Received packet from node %d!\n", doomcom->remotenode));
-			continue;
+			// Finish the bundle we got before reading more
+			if (!GetBundledPacket())
+				continue;
 		}
+		else
+		{
+			//nodejustjoined = I_NetGet();
+			net_arrivaltime = 0;
+			I_NetGet();
+
+			if (doomcom->remotenode == -1) // No packet received
+				return false;
 
-		nodes[doomcom->remotenode].lasttimepacketreceived = I_GetTime();
+			if (!net_arrivaltime)
+				net_arrivaltime = I_GetPreciseTime();
+
+			getbytes += packetheaderlength + doomcom->datalength; // For stat
+
+			if (doomcom->remotenode >= MAXNETNODES)
+			{
+				DEBFILE(va("Received packet from node %d!\n", doomcom->remotenode));
+				continue;
+			}
+
+			netnodestats[doomcom->remotenode].gotbytes += packetheaderlength + doomcom->datalength;
+
+			nodes[doomcom->remotenode].lasttimepacketreceived = I_GetTime();
+		}
 
 		if (netbuffer->checksum != NetbufferChecksum())
 		{
@@ -1187,6 +1519,22 @@ boolean HGetPacket(void)
 			GotAcks();
 			continue;
 		}
+
+		// Several packets in one, handle them one at a time
+		if (netbuffer->packettype == PT_BUNDLE)
+		{
+			if (bundled || (size_t)doomcom->datalength < BASEPACKETSIZE)
+			{
+				DEBFILE(va("Bad bundle from node %d\n", doomcom->remotenode));
+				continue;
+			}
+
+			bundlelength = doomcom->datalength - BASEPACKETSIZE;
+			M_Memcpy(bundlebuffer, netbuffer->u.bundle, bundlelength);
+			bundlepos = 0;
+			bundlenode = doomcom->remotenode;
+			continue;
+		}
 		break;
 	}
 #endif // ndef NONET
@@ -1268,6 +1616,7 @@ boolean D_CheckNetGame(void)
 	I_NetGet = Internal_Get;
 	I_NetSend = Internal_Send;
 	I_NetCanSend = NULL;
+	I_NetFlush = NULL;
 	I_NetCloseSocket = NULL;
 	I_NetFreeNodenum = Internal_FreeNodenum;
 	I_NetMakeNodewPort = NULL;
@@ -1427,10 +1776,22 @@ void Command_Ping_f(void)
 
 	for (i = 0; i < pingc; ++i)
 	{
-		CONS_Printf("%02d : %-*s %*d ms\n",
-				pingv[i].num,
-				name_width, player_names[pingv[i].num],
-				ms_width,   pingv[i].ms);
+		UINT32 roundtrip = 0;
+
+		if (server && playernode[pingv[i].num] != UINT8_MAX)
+			roundtrip = Net_GetRoundTripTime(playernode[pingv[i].num]);
+
+		if (roundtrip)
+			CONS_Printf("%02d : %-*s %*d ms (network %u ms)\n",
+					pingv[i].num,
+					name_width, player_names[pingv[i].num],
+					ms_width,   pingv[i].ms,
+					roundtrip);
+		else
+			CONS_Printf("%02d : %-*s %*d ms\n",
+					pingv[i].num,
+					name_width, player_names[pingv[i].num],
+					ms_width,   pingv[i].ms);
 	}
 
 	if (!server && playeringame[consoleplayer])
@@ -1460,6 +1821,7 @@ void D_CloseConnection(void)
 		I_NetGet = Internal_Get;
 		I_NetSend = Internal_Send;
 		I_NetCanSend = NULL;
+		I_NetFlush = NULL;
 		I_NetCloseSocket = NULL;
 		I_NetFreeNodenum = Internal_FreeNodenum;
 		I_NetMakeNodewPort = NULL;
@@ -37,6 +37,16 @@ boolean Net_GetNetStat(void);
 extern INT32 getbytes;
 extern INT64 sendbytes; // Realtime updated
 
+// Traffic per node, for soak tests
+typedef struct
+{
+	UINT64 sentbytes; // Including the IP and UDP headers
+	UINT64 gotbytes;
+	UINT32 resent; // Packets sent again for lack of an ack
+} netnodestats_t;
+
+extern netnodestats_t netnodestats[MAXNETNODES];
+
 extern SINT8 nodetoplayer[MAXNETNODES];
 extern SINT8 nodetoplayer2[MAXNETNODES]; // Say the numplayer for this node if any (splitscreen)
 extern UINT8 playerpernode[MAXNETNODES]; // Used specially for splitscreen
@@ -45,6 +55,7 @@ extern boolean nodeingame[MAXNETNODES]; // Set false as nodes leave game
 extern boolean serverrunning;
 
 INT32 Net_GetFreeAcks(boolean urgent);
+UINT32 Net_GetRoundTripTime(INT32 node);
 void Net_AckTicker(void);
 
 // If reliable return true if packet sent, 0 else
@@ -62,6 +73,7 @@ void Net_CloseConnection(INT32 node);
 void Net_ConnectionTimeout(INT32 node);
 void Net_AbortPacketType(UINT8 packettype);
 void Net_SendAcks(INT32 node);
+void Net_FlushFrames(void);
 void Net_WaitAllAckReceived(UINT32 timeout);
 
 #endif
@@ -26,6 +26,7 @@
 #include "r_skins.h"
 #include "p_local.h"
 #include "p_setup.h"
+#include "p_saveg.h" // save_p
 #include "s_sound.h"
 #include "i_sound.h"
 #include "m_misc.h"
@@ -48,6 +49,7 @@
 #include "m_cond.h"
 #include "m_anigif.h"
 #include "md5.h"
+#include "m_md5cache.h"
 #include "m_perfstats.h"
 #include "u_list.h"
 
@@ -594,6 +596,8 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_maxsend);
 	CV_RegisterVar(&cv_noticedownload);
 	CV_RegisterVar(&cv_downloadspeed);
+	CV_RegisterVar(&cv_downloadcache);
+	CV_RegisterVar(&cv_gamestatecompression);
 #ifndef NONET
 	CV_RegisterVar(&cv_allownewplayer);
 	CV_RegisterVar(&cv_joinnextround);
@@ -3479,16 +3483,13 @@ static void Command_Addfile(void)
 			FILE *fhandle;
 
 			if ((fhandle = W_OpenWadFile(&fn, true)) != NULL)
-			{
-				tic_t t = I_GetTime();
-				CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",fn);
-				md5_stream(fhandle, md5sum);
-				CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f second\n", fn, (float)(I_GetTime() - t)/TICRATE);
 				fclose(fhandle);
-			}
 			else // file not found
 				continue;
 
+			if (!M_FileMD5(fn, md5sum))
+				continue;
+
 			for (i = 0; i < numwadfiles; i++)
 			{
 				if (wadfiles[i]->type == RET_FOLDER)
@@ -4747,7 +4748,6 @@ static void Command_Togglemodified_f(void)
 	modifiedgame = !modifiedgame;
 }
 
-extern UINT8 *save_p;
 static void Command_Archivetest_f(void)
 {
 	UINT8 *buf;
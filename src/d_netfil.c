@@ -48,6 +48,8 @@
 #include "m_misc.h"
 #include "m_menu.h"
 #include "md5.h"
+#include "m_md5cache.h"
+#include "d_dlcache.h"
 #include "filesrch.h"
 
 #include <errno.h>
@@ -67,19 +69,50 @@ typedef struct filetx_s
 	UINT8 fileid;
 	INT32 node; // Destination
 	struct filetx_s *next; // Next file in the list
+
+	// Set up once the file starts being sent, see SV_StartFileSend
+	FILE *currentfile; // The file, if it couldn't be mapped in memory
+	UINT8 *data; // The contents, mapped in memory or in RAM
+	boolean mapped;
+	UINT32 *fragments; // FRAGMENT_UNSENT, FRAGMENT_ACKED, or the sequence number it's in flight with
+	UINT32 numfragments;
+	UINT32 ackedfragments; // Number of fragments acknowledged
+	UINT32 position; // First fragment that may still need sending
+	UINT16 fragmentsize;
 } filetx_t;
 
+#define FRAGMENT_UNSENT 0 // Never sent, or lost
+#define FRAGMENT_ACKED UINT32_MAX
+
+// A fragment waiting for its acknowledgement
+typedef struct
+{
+	filetx_t *file; // NULL if the file is gone
+	UINT32 fragment;
+	precise_t senttime;
+} sentfragment_t;
+
+#define FILEWINDOWMAX 2048 // Most fragments unacknowledged at once, must be a power of two
+#define FILEWINDOWMIN 4
+#define FILEWINDOWSTART 16
+#define FILEREORDER 3 // A fragment is lost once this many fragments sent after it are acknowledged
+#define FILEPIPELINE 4 // Files sent to a node at the same time
+
 // Current transfers (one for each node)
 typedef struct filetran_s
 {
 	filetx_t *txlist; // Linked list of all files for the node
-	UINT8 iteration;
-	UINT8 ackediteration;
-	UINT32 position; // The current position in the file
-	boolean *ackedfragments;
-	UINT32 ackedsize;
-	FILE *currentfile; // The file currently being sent/received
-	tic_t dontsenduntil;
+
+	// Congestion control, shared by all the files sent to the node
+	fixed_t window; // Number of fragments that can be unacknowledged at once
+	fixed_t slowstart; // Past this window size, it grows by one fragment per round trip
+	UINT32 inflight; // Fragments sent that are neither acknowledged nor lost yet
+	UINT32 roundtrip; // Smoothed round trip time in microseconds, 0 until measured
+	UINT32 sendseq; // Sequence number of the next fragment sent
+	UINT32 firstseq; // Sequence number of the oldest fragment in sent
+	UINT32 ackedseq; // Highest sequence number acknowledged
+	UINT32 recoveryseq; // Losses of fragments sent before this don't shrink the window again
+	sentfragment_t *sent; // Fragments from firstseq to sendseq, FILEWINDOWMAX long
 } filetran_t;
 static filetran_t transfer[MAXNETNODES];
 
@@ -90,6 +123,9 @@ static filetran_t transfer[MAXNETNODES];
 INT32 fileneedednum; // Number of files needed to join the server
 fileneeded_t *fileneeded; // List of needed files
 static tic_t lasttimeackpacketsent = 0;
+
+// Whether the candidates for the fileneeded list have been hashed yet
+static boolean fileneededprecached = false;
 char downloaddir[512] = "DOWNLOAD";
 
 // For resuming failed downloads
@@ -230,6 +266,7 @@ void D_ParseFileneeded(INT32 fileneedednum_parm, UINT8 *fileneededstr, UINT16 fi
 
 	fileneedednum = firstfile + fileneedednum_parm;
 	p = (UINT8 *)fileneededstr;
+	fileneededprecached = false;
 
 	AllocFileNeeded(fileneedednum);
 
@@ -267,6 +304,53 @@ void CL_PrepareDownloadSaveGame(const char *tmpsave)
 	strcpy(fileneeded[0].filename, tmpsave);
 }
 
+/** Finds the files on disk that are likely to be the needed files, and
+  * hashes all of them at once, in parallel, so the checks that
+  * CL_CheckFiles spreads over several tics find their MD5 sums ready.
+  */
+static void CL_PrecacheFileneededMD5s(void)
+{
+#ifndef NOMD5
+	char (*paths)[MAX_WADPATH];
+	const char **list;
+	size_t numpaths = 0;
+	INT32 i;
+
+	fileneededprecached = true;
+
+	if (!fileneedednum)
+		return;
+
+	paths = Z_Malloc(fileneedednum * sizeof (*paths), PU_STATIC, NULL);
+	list = Z_Malloc(fileneedednum * sizeof (*list), PU_STATIC, NULL);
+
+	for (i = 0; i < fileneedednum; i++)
+	{
+		if (fileneeded[i].status != FS_NOTCHECKED || fileneeded[i].folder)
+			continue;
+
+		// Files in the download cache are looked up by their MD5 sum
+		if (D_FindCachedDownload(fileneeded[i].md5sum, fileneeded[i].filename, paths[numpaths]))
+			continue;
+
+		strlcpy(paths[numpaths], fileneeded[i].filename, MAX_WADPATH);
+		if (findfile(paths[numpaths], NULL, true) == FS_FOUND)
+		{
+			list[numpaths] = paths[numpaths];
+			numpaths++;
+		}
+	}
+
+	M_PrecacheFileMD5s(list, numpaths);
+	D_SaveDownloadCache();
+
+	Z_Free(list);
+	Z_Free(paths);
+#else
+	fileneededprecached = true;
+#endif
+}
+
 /** Checks the server to see if we CAN download all the files,
   * before starting to create them and requesting.
   *
@@ -396,6 +480,10 @@ boolean CL_SendFileRequest(void)
 			nameonly(fileneeded[i].filename);
 			strcatbf(fileneeded[i].filename, downloaddir, "/");
 
+			// or in its own place in the download cache
+			if (D_DownloadCacheEnabled() && !fileneeded[i].folder)
+				D_CachedDownloadPath(fileneeded[i].md5sum, fileneeded[i].filename, fileneeded[i].filename);
+
 			fileneeded[i].status = FS_REQUESTED;
 		}
 
@@ -484,6 +572,9 @@ INT32 CL_CheckFiles(void)
 		return 1;
 	}
 
+	if (!fileneededprecached)
+		CL_PrecacheFileneededMD5s();
+
 	for (i = 0; i < fileneedednum; i++)
 	{
 		if (fileneeded[i].status == FS_NOTFOUND || fileneeded[i].status == FS_MD5SUMBAD)
@@ -512,6 +603,11 @@ INT32 CL_CheckFiles(void)
 
 		if (fileneeded[i].folder)
 			fileneeded[i].status = findfolder(fileneeded[i].filename);
+		else if (D_FindCachedDownload(fileneeded[i].md5sum, fileneeded[i].filename, wadfilename))
+		{
+			strcpy(fileneeded[i].filename, wadfilename);
+			fileneeded[i].status = FS_FOUND;
+		}
 		else
 			fileneeded[i].status = findfile(fileneeded[i].filename, fileneeded[i].md5sum, true);
 
@@ -520,6 +616,8 @@ INT32 CL_CheckFiles(void)
 	}
 
 	//now making it here means we've checked the entire list and no FS_NOTCHECKED files remain
+	D_SaveDownloadCache();
+
 	if (numwadfiles+filestoload > MAX_WADFILES)
 		return 3;
 	else if (downloadrequired)
@@ -942,11 +1040,14 @@ boolean AddLuaFileToSendQueue(INT32 node, const char *filename)
   * either because the file has been fully sent or because the node was disconnected
   *
   * \param node The destination
+  * \param p The file request
   *
   */
-static void SV_EndFileSend(INT32 node)
+static void SV_EndFileSend(INT32 node, filetx_t *p)
 {
-	filetx_t *p = transfer[node].txlist;
+	filetran_t *trans = &transfer[node];
+	filetx_t **q;
+	UINT32 seq;
 
 	// Free the file request according to the freemethod
 	// parameter used with AddFileToSendQueue/AddRamToSendQueue
@@ -955,8 +1056,10 @@ static void SV_EndFileSend(INT32 node)
 		case SF_FILE: // It's a file, close it and free its filename
 			if (cv_noticedownload.value)
 				CONS_Printf("Ending file transfer for node %d\n", node);
-			if (transfer[node].currentfile)
-				fclose(transfer[node].currentfile);
+			if (p->mapped)
+				I_UnmapFile(p->data, p->size);
+			if (p->currentfile)
+				fclose(p->currentfile);
 			free(p->id.filename);
 			break;
 		case SF_Z_RAM: // It's a memory block allocated with Z_Alloc or the likes, use Z_Free
@@ -968,21 +1071,218 @@ static void SV_EndFileSend(INT32 node)
 			break;
 	}
 
+	// Forget its fragments that are still waiting for an acknowledgement
+	if (p->fragments)
+	{
+		for (seq = trans->firstseq; seq != trans->sendseq; seq++)
+		{
+			sentfragment_t *s = &trans->sent[seq % FILEWINDOWMAX];
+
+			if (s->file != p)
+				continue;
+
+			if (p->fragments[s->fragment] == seq)
+				trans->inflight--;
+			s->file = NULL;
+		}
+
+		free(p->fragments);
+	}
+
 	// Remove the file request from the list
-	transfer[node].txlist = p->next;
+	for (q = &trans->txlist; *q != p; q = &(*q)->next)
+		;
+	*q = p->next;
 	free(p);
 
-	// Indicate that the transmission is over
-	transfer[node].currentfile = NULL;
-	if (transfer[node].ackedfragments)
-		free(transfer[node].ackedfragments);
-	transfer[node].ackedfragments = NULL;
+	// Nothing left to send, start from scratch next time
+	if (!trans->txlist)
+	{
+		free(trans->sent);
+		memset(trans, 0, sizeof (*trans));
+	}
 
 	filestosend--;
 }
 
 #define FILEFRAGMENTSIZE (software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE))
 
+/** Opens a file to send and splits it into fragments.
+  * Files are read through a memory mapping when the system allows it.
+  *
+  * \param f The file request
+  *
+  */
+static void SV_StartFileSend(filetx_t *f)
+{
+	if (f->ram == SF_FILE) // Sending a file
+	{
+		long filesize;
+
+		f->currentfile = fopen(f->id.filename, "rb");
+
+		if (!f->currentfile)
+			I_Error("File %s does not exist",
+				f->id.filename);
+
+		fseek(f->currentfile, 0, SEEK_END);
+		filesize = ftell(f->currentfile);
+
+		// Nobody wants to transfer a file bigger
+		// than 4GB!
+		if (filesize >= LONG_MAX)
+			I_Error("filesize of %s is too large", f->id.filename);
+		if (filesize == -1)
+			I_Error("Error getting filesize of %s", f->id.filename);
+
+		f->size = (UINT32)filesize;
+		fseek(f->currentfile, 0, SEEK_SET);
+
+		// The mapping stays valid after the file is closed
+		f->data = I_MapFile(f->currentfile, f->size);
+		if (f->data)
+		{
+			f->mapped = true;
+			fclose(f->currentfile);
+			f->currentfile = NULL;
+		}
+	}
+	else // Sending RAM
+		f->data = (UINT8 *)f->id.ram;
+
+	f->fragmentsize = (UINT16)FILEFRAGMENTSIZE;
+	f->numfragments = (f->size + f->fragmentsize - 1) / f->fragmentsize;
+	if (!f->numfragments)
+		f->numfragments = 1;
+	f->ackedfragments = 0;
+	f->position = 0;
+
+	f->fragments = calloc(f->numfragments, sizeof(*f->fragments));
+	if (!f->fragments)
+		I_Error("FileSendTicker: No more memory\n");
+}
+
+/** Finds the next fragment to send to a node. The first few files in the
+  * list are sent at the same time, so the end of one file, where fragments
+  * are mostly waiting to be acknowledged or resent, doesn't leave the
+  * connection idle.
+  *
+  * \param trans The node's transfers
+  * \param file Set to the file the fragment belongs to
+  * \param fragment Set to the fragment number
+  * \return True if there is something to send
+  *
+  */
+static boolean SV_NextFragment(filetran_t *trans, filetx_t **file, UINT32 *fragment)
+{
+	filetx_t *f, *g;
+	INT32 n;
+
+	for (f = trans->txlist, n = 0; f && n < FILEPIPELINE; f = f->next, n++)
+	{
+		// Acknowledgements only carry the file id,
+		// so two files with the same one can't be sent at once
+		for (g = trans->txlist; g != f; g = g->next)
+			if (g->fileid == f->fileid)
+				break;
+		if (g != f)
+			continue;
+
+		if (!f->fragments)
+			SV_StartFileSend(f);
+
+		while (f->position < f->numfragments && f->fragments[f->position] != FRAGMENT_UNSENT)
+			f->position++;
+
+		if (f->position < f->numfragments)
+		{
+			*file = f;
+			*fragment = f->position;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/** Gives up on fragments that are most likely lost, so they get sent again.
+  * A fragment is lost once FILEREORDER fragments sent after it made it, or
+  * if it has gone unacknowledged for much longer than a round trip.
+  * A loss halves the window, once per round trip.
+  *
+  * \param trans The node's transfers
+  *
+  */
+static void SV_DetectLostFragments(filetran_t *trans)
+{
+	precise_t now = I_GetPreciseTime();
+	precise_t timeout = (trans->roundtrip ? 2 * trans->roundtrip : 500000) + 3 * 1000000 / TICRATE;
+
+	timeout = timeout * I_GetPrecisePrecision() / 1000000;
+
+	for (; trans->firstseq != trans->sendseq; trans->firstseq++)
+	{
+		sentfragment_t *s = &trans->sent[trans->firstseq % FILEWINDOWMAX];
+		filetx_t *f = s->file;
+
+		// Acknowledged, or the file is gone
+		if (!f || f->fragments[s->fragment] != trans->firstseq)
+			continue;
+
+		if ((INT32)(trans->ackedseq - trans->firstseq) < FILEREORDER && now - s->senttime < timeout)
+			break;
+
+		f->fragments[s->fragment] = FRAGMENT_UNSENT;
+		if (s->fragment < f->position)
+			f->position = s->fragment;
+		trans->inflight--;
+
+		if ((INT32)(trans->firstseq - trans->recoveryseq) >= 0)
+		{
+			trans->slowstart = max(trans->window / 2, FILEWINDOWMIN * FRACUNIT);
+			trans->window = trans->slowstart;
+			trans->recoveryseq = trans->sendseq;
+		}
+	}
+}
+
+/** Works out how many fragments a node can get this tic: what fits in its
+  * window, spread over a round trip so it doesn't all go out at once.
+  *
+  * \param node The destination
+  * \return The number of fragments
+  *
+  */
+static INT32 SV_FragmentBudget(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+	INT32 window, budget;
+	UINT32 roundtriptics;
+
+	if (!trans->sent)
+	{
+		trans->sent = calloc(FILEWINDOWMAX, sizeof(*trans->sent));
+		if (!trans->sent)
+			I_Error("FileSendTicker: No more memory\n");
+
+		trans->window = FILEWINDOWSTART * FRACUNIT;
+		trans->slowstart = FILEWINDOWMAX * FRACUNIT;
+		trans->sendseq = trans->firstseq = trans->recoveryseq = 1;
+	}
+
+	SV_DetectLostFragments(trans);
+
+	window = trans->window >> FRACBITS;
+	budget = min(window - (INT32)trans->inflight,
+		FILEWINDOWMAX - (INT32)(trans->sendseq - trans->firstseq));
+
+	roundtriptics = (trans->roundtrip * TICRATE + 999999) / 1000000;
+	if (roundtriptics > 1)
+		budget = min(budget, window / (INT32)roundtriptics + 1);
+
+	return budget;
+}
+
 /** Handles file transmission
   *
   */
@@ -992,7 +1292,9 @@ void FileSendTicker(void)
 	filetx_pak *p;
 	size_t fragmentsize;
 	filetx_t *f;
-	INT32 packetsent, ram, i, j;
+	UINT32 fragment;
+	INT32 budget[MAXNETNODES];
+	INT32 packetsent, i, j;
 
 	// If someone is taking too long to download, kick them with a timeout
 	// to prevent blocking the rest of the server...
@@ -1013,121 +1315,67 @@ void FileSendTicker(void)
 	if (!filestosend) // No file to send
 		return;
 
-	packetsent = cv_downloadspeed.value;
+	for (i = 0; i < MAXNETNODES; i++)
+		budget[i] = transfer[i].txlist ? SV_FragmentBudget(i) : 0;
 
-	netbuffer->packettype = PT_FILEFRAGMENT;
+	packetsent = cv_downloadspeed.value;
 
-	// (((sendbytes-nowsentbyte)*TICRATE)/(I_GetTime()-starttime)<(UINT32)net_bandwidth)
-	while (packetsent-- && filestosend != 0)
+	while (packetsent > 0)
 	{
 		for (i = currentnode, j = 0; j < MAXNETNODES;
 			i = (i+1) % MAXNETNODES, j++)
 		{
-			if (transfer[i].txlist)
+			if (budget[i] > 0)
 				break;
 		}
-		// no transfer to do
+		// Every node is waiting for acknowledgements
 		if (j >= MAXNETNODES)
-			I_Error("filestosend=%d but no file to send found\n", filestosend);
+			break;
 
 		currentnode = (i+1) % MAXNETNODES;
-		f = transfer[i].txlist;
-		ram = f->ram;
 
-		// Open the file if it isn't open yet, or
-		if (!transfer[i].currentfile)
+		if (!SV_NextFragment(&transfer[i], &f, &fragment))
 		{
-			if (!ram) // Sending a file
-			{
-				long filesize;
-
-				transfer[i].currentfile =
-					fopen(f->id.filename, "rb");
-
-				if (!transfer[i].currentfile)
-					I_Error("File %s does not exist",
-						f->id.filename);
-
-				fseek(transfer[i].currentfile, 0, SEEK_END);
-				filesize = ftell(transfer[i].currentfile);
-
-				// Nobody wants to transfer a file bigger
-				// than 4GB!
-				if (filesize >= LONG_MAX)
-					I_Error("filesize of %s is too large", f->id.filename);
-				if (filesize == -1)
-					I_Error("Error getting filesize of %s", f->id.filename);
-
-				f->size = (UINT32)filesize;
-				fseek(transfer[i].currentfile, 0, SEEK_SET);
-			}
-			else // Sending RAM
-				transfer[i].currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
-
-			transfer[i].iteration = 1;
-			transfer[i].ackediteration = 0;
-			transfer[i].position = 0;
-			transfer[i].ackedsize = 0;
-
-			transfer[i].ackedfragments = calloc(f->size / FILEFRAGMENTSIZE + 1, sizeof(*transfer[i].ackedfragments));
-			if (!transfer[i].ackedfragments)
-				I_Error("FileSendTicker: No more memory\n");
-
-			transfer[i].dontsenduntil = 0;
-		}
-
-		// If the client hasn't acknowledged any fragment from the previous iteration,
-		// it is most likely because their acks haven't had enough time to reach the server
-		// yet, due to latency. In that case, we wait a little to avoid useless resend.
-		if (I_GetTime() < transfer[i].dontsenduntil)
+			budget[i] = 0;
 			continue;
-
-		// Find the first non-acknowledged fragment
-		while (transfer[i].ackedfragments[transfer[i].position / FILEFRAGMENTSIZE])
-		{
-			transfer[i].position += FILEFRAGMENTSIZE;
-			if (transfer[i].position >= f->size)
-			{
-				if (transfer[i].ackediteration < transfer[i].iteration)
-					transfer[i].dontsenduntil = I_GetTime() + TICRATE / 2;
-
-				transfer[i].position = 0;
-				transfer[i].iteration++;
-			}
 		}
 
 		// Build a packet containing a file fragment
+		netbuffer->packettype = PT_FILEFRAGMENT;
 		p = &netbuffer->u.filetxpak;
-		fragmentsize = FILEFRAGMENTSIZE;
-		if (f->size-transfer[i].position < fragmentsize)
-			fragmentsize = f->size-transfer[i].position;
-		if (ram)
-			M_Memcpy(p->data, &f->id.ram[transfer[i].position], fragmentsize);
+		fragmentsize = f->fragmentsize;
+		if (f->size - fragment * f->fragmentsize < fragmentsize)
+			fragmentsize = f->size - fragment * f->fragmentsize;
+		if (f->data)
+			M_Memcpy(p->data, &f->data[fragment * f->fragmentsize], fragmentsize);
 		else
 		{
-			fseek(transfer[i].currentfile, transfer[i].position, SEEK_SET);
+			fseek(f->currentfile, fragment * f->fragmentsize, SEEK_SET);
 
-			if (fread(p->data, 1, fragmentsize, transfer[i].currentfile) != fragmentsize)
-				I_Error("FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(fragmentsize), f->id.filename, transfer[i].position, M_FileError(transfer[i].currentfile));
+			if (fread(p->data, 1, fragmentsize, f->currentfile) != fragmentsize)
+				I_Error("FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(fragmentsize), f->id.filename, fragment * f->fragmentsize, M_FileError(f->currentfile));
 		}
-		p->iteration = transfer[i].iteration;
-		p->position = LONG(transfer[i].position);
+		p->iteration = 1; // Unused, fragments are tracked one by one
+		p->position = LONG(fragment * f->fragmentsize);
 		p->fileid = f->fileid;
 		p->filesize = LONG(f->size);
-		p->size = SHORT((UINT16)FILEFRAGMENTSIZE);
+		p->size = SHORT(f->fragmentsize);
 
 		// Send the packet
 		if (HSendPacket(i, false, 0, FILETXHEADER + fragmentsize)) // Don't use the default acknowledgement system
 		{ // Success
-			transfer[i].position = (UINT32)(transfer[i].position + fragmentsize);
-			if (transfer[i].position >= f->size)
-			{
-				if (transfer[i].ackediteration < transfer[i].iteration)
-					transfer[i].dontsenduntil = I_GetTime() + TICRATE / 2;
-
-				transfer[i].position = 0;
-				transfer[i].iteration++;
-			}
+			filetran_t *trans = &transfer[i];
+			sentfragment_t *s = &trans->sent[trans->sendseq % FILEWINDOWMAX];
+
+			s->file = f;
+			s->fragment = fragment;
+			s->senttime = I_GetPreciseTime();
+			f->fragments[fragment] = trans->sendseq++;
+			f->position = fragment + 1;
+			trans->inflight++;
+
+			budget[i]--;
+			packetsent--;
 		}
 		else
 		{ // Not sent for some odd reason, retry at next call
@@ -1137,15 +1385,63 @@ void FileSendTicker(void)
 	}
 }
 
+/** Marks a fragment as acknowledged, and grows the window if it was in
+  * flight: by one fragment per acknowledgement during slow start, which
+  * doubles it every round trip, and by one fragment per round trip after.
+  *
+  * \param trans The node's transfers
+  * \param f The file the fragment belongs to
+  * \param fragment The fragment number
+  *
+  */
+static void SV_FragmentAcked(filetran_t *trans, filetx_t *f, UINT32 fragment)
+{
+	UINT32 seq = f->fragments[fragment];
+
+	if (seq == FRAGMENT_ACKED)
+		return;
+
+	if (seq != FRAGMENT_UNSENT)
+	{
+		sentfragment_t *s = &trans->sent[seq % FILEWINDOWMAX];
+		UINT32 sample = (UINT32)((net_arrivaltime - s->senttime) * 1000000 / I_GetPrecisePrecision());
+
+		if (trans->roundtrip)
+			trans->roundtrip = trans->roundtrip - trans->roundtrip/8 + sample/8;
+		else
+			trans->roundtrip = sample;
+
+		if ((INT32)(seq - trans->ackedseq) > 0)
+			trans->ackedseq = seq;
+		trans->inflight--;
+
+		if (trans->window < trans->slowstart)
+			trans->window += FRACUNIT;
+		else
+			trans->window += FixedDiv(FRACUNIT, trans->window);
+		if (trans->window > FILEWINDOWMAX * FRACUNIT)
+			trans->window = FILEWINDOWMAX * FRACUNIT;
+	}
+
+	f->fragments[fragment] = FRAGMENT_ACKED;
+	f->ackedfragments++;
+}
+
 void PT_FileAck(void)
 {
 	fileack_pak *packet = &netbuffer->u.fileack;
 	INT32 node = doomcom->remotenode;
 	filetran_t *trans = &transfer[node];
+	filetx_t *f;
 	INT32 i, j;
 
+	// Find the file, it can be any of the ones being sent
+	for (f = trans->txlist; f; f = f->next)
+		if (f->fileid == packet->fileid && f->fragments)
+			break;
+
 	// Wrong file id? Ignore it, it's probably a late packet
-	if (!(trans->txlist && packet->fileid == trans->txlist->fileid))
+	if (!f)
 		return;
 
 	if (packet->numsegments * sizeof(*packet->segments) != doomcom->datalength - BASEPACKETSIZE - sizeof(*packet))
@@ -1154,37 +1450,28 @@ void PT_FileAck(void)
 		return;
 	}
 
-	if (packet->iteration > trans->ackediteration)
-	{
-		trans->ackediteration = packet->iteration;
-		if (trans->ackediteration >= trans->iteration - 1)
-			trans->dontsenduntil = 0;
-	}
-
 	for (i = 0; i < packet->numsegments; i++)
 	{
 		fileacksegment_t *segment = &packet->segments[i];
 
 		for (j = 0; j < 32; j++)
-			if (LONG(segment->acks) & (1 << j))
+			if (LONG(segment->acks) & (1U << j))
 			{
-				if (LONG(segment->start) * FILEFRAGMENTSIZE >= trans->txlist->size)
+				UINT32 fragment = LONG(segment->start) + j;
+
+				if (fragment >= f->numfragments)
 				{
 					Net_CloseConnection(node);
 					return;
 				}
 
-				if (!trans->ackedfragments[LONG(segment->start) + j])
-				{
-					trans->ackedfragments[LONG(segment->start) + j] = true;
-					trans->ackedsize += FILEFRAGMENTSIZE;
+				SV_FragmentAcked(trans, f, fragment);
 
-					// If the last missing fragment was acked, finish!
-					if (trans->ackedsize == trans->txlist->size)
-					{
-						SV_EndFileSend(node);
-						return;
-					}
+				// If the last missing fragment was acked, finish!
+				if (f->ackedfragments == f->numfragments)
+				{
+					SV_EndFileSend(node, f);
+					return;
 				}
 			}
 	}
@@ -1192,10 +1479,14 @@ void PT_FileAck(void)
 
 void PT_FileReceived(void)
 {
-	filetx_t *trans = transfer[doomcom->remotenode].txlist;
+	filetx_t *trans;
 
-	if (trans && netbuffer->u.filereceived == trans->fileid)
-		SV_EndFileSend(doomcom->remotenode);
+	for (trans = transfer[doomcom->remotenode].txlist; trans; trans = trans->next)
+		if (netbuffer->u.filereceived == trans->fileid && trans->fragments)
+		{
+			SV_EndFileSend(doomcom->remotenode, trans);
+			break;
+		}
 }
 
 static void SendAckPacket(fileack_pak *packet, UINT8 fileid)
@@ -1394,6 +1685,9 @@ void PT_FileFragment(void)
 				CONS_Printf(M_GetText("Downloading %s...(done)\n"),
 					filename);
 
+				if (file->type == FILENEEDED_WAD)
+					D_AddCachedDownload(file->md5sum, filename);
+
 				// Tell the server we have received the file
 				netbuffer->packettype = PT_FILERECEIVED;
 				netbuffer->u.filereceived = filenum;
@@ -1464,7 +1758,7 @@ boolean SendingFile(INT32 node)
 void SV_AbortSendFiles(INT32 node)
 {
 	while (transfer[node].txlist)
-		SV_EndFileSend(node);
+		SV_EndFileSend(node, transfer[node].txlist);
 }
 
 void CloseNetFile(void)
@@ -1511,16 +1805,20 @@ void CloseNetFile(void)
 void Command_Downloads_f(void)
 {
 	INT32 node;
+	filetx_t *f;
 
 	for (node = 0; node < MAXNETNODES; node++)
-		if (transfer[node].txlist
-		&& transfer[node].txlist->ram == SF_FILE) // Node is downloading a file?
+		for (f = transfer[node].txlist; f; f = f->next)
 		{
-			const char *name = transfer[node].txlist->id.filename;
-			UINT32 position = transfer[node].ackedsize;
-			UINT32 size = transfer[node].txlist->size;
+			const char *name = f->id.filename;
+			UINT32 position = min(f->ackedfragments * f->fragmentsize, f->size);
+			UINT32 size = f->size;
 			char ratecolor;
 
+			// Node is downloading a file?
+			if (f->ram != SF_FILE || !f->fragments)
+				continue;
+
 			// Avoid division by zero errors
 			if (!size)
 				size = 1;
@@ -1585,17 +1883,13 @@ filestatus_t checkfilemd5(char *filename, const UINT8 *wantedmd5sum)
 	(void)wantedmd5sum;
 	(void)filename;
 #else
-	FILE *fhandle;
 	UINT8 md5sum[16];
 
 	if (!wantedmd5sum)
 		return FS_FOUND;
 
-	fhandle = fopen(filename, "rb");
-	if (fhandle)
+	if (M_FileMD5(filename, md5sum))
 	{
-		md5_stream(fhandle,md5sum);
-		fclose(fhandle);
 		if (!memcmp(wantedmd5sum, md5sum, 16))
 			return FS_FOUND;
 		return FS_MD5SUMBAD;
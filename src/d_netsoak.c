@@ -0,0 +1,178 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_netsoak.c
+/// \brief Netcode soak testing: synthetic clients and server load reports
+///
+///        A client started with -soakclient skips rendering and plays
+///        with made up input, so many of them can be run against one
+///        server on the same machine (see tools/netsoak). A server
+///        started with -soakreport [seconds] prints its tic time and
+///        per client traffic, resends and desyncs at that interval.
+///        Latency, jitter and loss can be added on either side with the
+///        drop, droprate and delaypacket commands, in PACKETDROP builds.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_clisrv.h"
+#include "d_net.h"
+#include "g_game.h" // MAXPLMOVE
+#include "i_system.h"
+#include "m_argv.h"
+#include "d_netsoak.h"
+
+boolean soakclient = false;
+
+static tic_t soakreportinterval = 0; // In tics, 0 if not reporting
+static tic_t soaktics;
+
+static precise_t soaktictotal, soakticmax;
+static UINT32 soakdesyncs[NUMCONSISTANCY];
+
+// Counters as of the last report, to print the difference
+static UINT64 lastsentbytes[MAXNETNODES], lastgotbytes[MAXNETNODES];
+static UINT32 lastresent[MAXNETNODES];
+
+static UINT32 soakseed;
+
+void D_SoakInit(void)
+{
+	soakclient = M_CheckParm("-soakclient") != 0;
+	if (soakclient)
+	{
+		// Nobody is watching
+		nodrawers = noblit = true;
+		soakseed = (UINT32)I_GetPreciseTime() | 1;
+	}
+
+	if (M_CheckParm("-soakreport"))
+	{
+		INT32 seconds = 10;
+
+		if (M_IsNextParm())
+			seconds = max(atoi(M_GetNextParm()), 1);
+		soakreportinterval = (tic_t)seconds * TICRATE;
+	}
+}
+
+// Not the game's RNG, which has to stay in sync
+static UINT32 D_SoakRandom(void)
+{
+	soakseed ^= soakseed << 13;
+	soakseed ^= soakseed >> 17;
+	soakseed ^= soakseed << 5;
+	return soakseed;
+}
+
+/** Replaces the input of a soak client with something that looks like play:
+  * running in one direction for a while, turning, jumping and spinning.
+  *
+  * \param cmd     The ticcmd being built
+  * \param myangle The local view angle, kept in step with the turning
+  */
+void D_SoakBuildTiccmd(ticcmd_t *cmd, angle_t *myangle)
+{
+	static SINT8 forward, side;
+	static INT16 turn;
+	static tic_t changetic;
+	const UINT32 r = D_SoakRandom();
+
+	// Pick a new direction every half second or so
+	if (gametic >= changetic)
+	{
+		forward = (SINT8)((D_SoakRandom() % 3 == 0) ? 0 : MAXPLMOVE);
+		side = (SINT8)((INT32)(D_SoakRandom() % (2*MAXPLMOVE + 1)) - MAXPLMOVE);
+		turn = (INT16)((INT32)(D_SoakRandom() % 1025) - 512);
+		changetic = gametic + TICRATE/4 + D_SoakRandom() % TICRATE;
+	}
+
+	cmd->forwardmove = forward;
+	cmd->sidemove = side;
+	cmd->angleturn = (INT16)(cmd->angleturn + turn);
+	*myangle += (angle_t)turn << 16;
+
+	cmd->buttons = 0;
+	if (r % 8 == 0)
+		cmd->buttons |= BT_JUMP;
+	if (r % 29 == 0)
+		cmd->buttons |= BT_SPIN;
+}
+
+void D_SoakDesync(consistancy_t part)
+{
+	soakdesyncs[part]++;
+}
+
+static void D_SoakReport(void)
+{
+	const UINT64 precision = I_GetPrecisePrecision();
+	UINT64 sent = 0, got = 0;
+	UINT32 resent = 0, desyncs = 0;
+	INT32 clients = 0;
+	INT32 i;
+	char desyncparts[128] = "";
+
+	for (i = 1; i < MAXNETNODES; i++)
+	{
+		const netnodestats_t *stats = &netnodestats[i];
+
+		// Counters start over when a node is closed
+		if (stats->sentbytes < lastsentbytes[i] || stats->gotbytes < lastgotbytes[i])
+			lastsentbytes[i] = lastgotbytes[i] = lastresent[i] = 0;
+
+		if (nodeingame[i])
+		{
+			clients++;
+			sent += stats->sentbytes - lastsentbytes[i];
+			got += stats->gotbytes - lastgotbytes[i];
+			resent += stats->resent - lastresent[i];
+		}
+
+		lastsentbytes[i] = stats->sentbytes;
+		lastgotbytes[i] = stats->gotbytes;
+		lastresent[i] = stats->resent;
+	}
+
+	for (i = 0; i < NUMCONSISTANCY; i++)
+	{
+		if (!soakdesyncs[i])
+			continue;
+		desyncs += soakdesyncs[i];
+		strlcat(desyncparts, va(" %s %u", consistancynames[i], soakdesyncs[i]), sizeof desyncparts);
+		soakdesyncs[i] = 0;
+	}
+
+	CONS_Printf("soak: %d clients, tic %u us avg %u us max, per client %u B/s out %u B/s in, %u resends, %u desyncs%s\n",
+		clients,
+		(UINT32)(soaktictotal * 1000000 / precision / soaktics),
+		(UINT32)(soakticmax * 1000000 / precision),
+		clients ? (UINT32)(sent * TICRATE / soaktics / clients) : 0,
+		clients ? (UINT32)(got * TICRATE / soaktics / clients) : 0,
+		resent, desyncs, desyncparts);
+
+	soaktics = 0;
+	soaktictotal = soakticmax = 0;
+}
+
+/** Records how long a tic took, and prints a report every interval.
+  *
+  * \param tictime Time the tic took, in I_GetPreciseTime units
+  */
+void D_SoakTic(precise_t tictime)
+{
+	if (!soakreportinterval || !server)
+		return;
+
+	soaktics++;
+	soaktictotal += tictime;
+	if (tictime > soakticmax)
+		soakticmax = tictime;
+
+	if (soaktics >= soakreportinterval)
+		D_SoakReport();
+}
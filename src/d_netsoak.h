@@ -0,0 +1,25 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_netsoak.h
+/// \brief Netcode soak testing: synthetic clients and server load reports
+
+#ifndef __D_NETSOAK__
+#define __D_NETSOAK__
+
+#include "d_ticcmd.h"
+#include "p_tick.h" // consistancy_t
+
+extern boolean soakclient;
+
+void D_SoakInit(void);
+void D_SoakBuildTiccmd(ticcmd_t *cmd, angle_t *myangle);
+void D_SoakTic(precise_t tictime);
+void D_SoakDesync(consistancy_t part);
+
+#endif
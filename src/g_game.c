@@ -51,6 +51,7 @@
 
 #include "lua_hud.h"
 #include "speedrun.h"
+#include "d_netsoak.h"
 
 gameaction_t gameaction;
 gamestate_t gamestate = GS_NULL;
@@ -1692,6 +1693,9 @@ void G_BuildTiccmd(ticcmd_t *cmd, INT32 realtics, UINT8 ssplayer)
 		}
 	}
 
+	if (soakclient && ssplayer == 1)
+		D_SoakBuildTiccmd(cmd, myangle);
+
 	// At this point, cmd doesn't contain the final angle yet,
 	// So we need to temporarily transform it so Lua scripters
 	// don't need to handle it differently than in other hooks.
@@ -4174,6 +4178,8 @@ static void G_DoCompleted(void)
 		Y_StartIntermission();
 		Y_LoadIntermissionData();
 		G_HandleSaveLevel();
+		if (nextmap < NUMMAPS)
+			P_StartLevelPrefetch(nextmap+1);
 	}
 }
 
@@ -23,6 +23,9 @@
 #include "../i_video.h"
 #include "../w_wad.h"
 #include "../p_setup.h" // levelfadecol
+#include "../p_levelcache.h"
+#include "../byteptr.h"
+#include "../i_threads.h"
 
 // --------------------------------------------------------------------------
 // This is global data for planes rendering
@@ -45,129 +48,123 @@ typedef struct
 //                                    FLOOR & CEILING CONVEX POLYS GENERATION
 // ==========================================================================
 
-//debug counters
-static INT32 nobackpoly = 0;
-static INT32 skipcut = 0;
-static INT32 totalsubsecpolys = 0;
-
 // --------------------------------------------------------------------------
 // Polygon fast alloc / free
 // --------------------------------------------------------------------------
-//hurdler: quick fix for those who wants to play with larger wad
+// Polygons are carved out of large PU_HWRPLANE blocks, so they all go
+// away with the level. Every job building polygons has a pool of its own;
+// the zone is the only thing they share, and it is locked.
+
+#define POLYPOOLCHUNK (64*1024)
+#define POLYFREELISTS 32 // freed polys are kept for reuse up to this many points
+
+typedef struct polyfree_s
+{
+	struct polyfree_s *next;
+} polyfree_t;
+
+typedef struct
+{
+	UINT8 *current;
+	size_t free;
+	polyfree_t *freelist[POLYFREELISTS];
+
+	//debug counters
+	INT32 nobackpoly;
+	INT32 skipcut;
+	INT32 totalsubsecpolys;
+} polypool_t;
 
-#define ZPLANALLOC
-#ifndef ZPLANALLOC
-//#define POLYPOOLSIZE 1024000 // may be much over what is needed
-/// \todo check out how much is used
-static size_t POLYPOOLSIZE = 1024000;
+// used by everything that runs on the main thread
+static polypool_t mainpool;
 
-static UINT8 *gl_polypool = NULL;
-static UINT8 *gl_ppcurrent;
-static size_t gl_ppfree;
+#ifdef HAVE_THREADS
+static I_mutex polypool_mutex;
 #endif
 
 // only between levels, clear poly pool
-static void HWR_ClearPolys(void)
+static void HWR_ClearPolyPool(polypool_t *pool)
 {
-#ifndef ZPLANALLOC
-	gl_ppcurrent = gl_polypool;
-	gl_ppfree = POLYPOOLSIZE;
-#endif
+	memset(pool, 0, sizeof (*pool));
 }
 
-// allocate  pool for fast alloc of polys
 void HWR_InitPolyPool(void)
 {
-#ifndef ZPLANALLOC
-	INT32 pnum;
-
-	//hurdler: quick fix for those who wants to play with larger wad
-	if ((pnum = M_CheckParm("-polypoolsize")))
-		POLYPOOLSIZE = atoi(myargv[pnum+1])*1024; // (in kb)
-
-	CONS_Debug(DBG_RENDER, "HWR_InitPolyPool(): allocating %d bytes\n", POLYPOOLSIZE);
-	gl_polypool = malloc(POLYPOOLSIZE);
-	if (!gl_polypool)
-		I_Error("HWR_InitPolyPool(): couldn't malloc polypool\n");
-	HWR_ClearPolys();
-#endif
+	HWR_ClearPolyPool(&mainpool);
 }
 
 void HWR_FreePolyPool(void)
 {
-#ifndef ZPLANALLOC
-	if (gl_polypool)
-		free(gl_polypool);
-	gl_polypool = NULL;
-#endif
+	// the blocks themselves are freed with PU_HWRPLANE
+	HWR_ClearPolyPool(&mainpool);
 }
 
-static poly_t *HWR_AllocPoly(INT32 numpts)
+static void *HWR_PoolAlloc(polypool_t *pool, size_t size)
 {
-	poly_t *p;
-	size_t size = sizeof (poly_t) + sizeof (polyvertex_t) * numpts;
-#ifdef ZPLANALLOC
-	p = Z_Malloc(size, PU_HWRPLANE, NULL);
-#else
-#ifdef PARANOIA
-	if (!gl_polypool)
-		I_Error("Used gl_polypool without init!\n");
-	if (!gl_ppcurrent)
-		I_Error("gl_ppcurrent == NULL!\n");
-#endif
+	void *p;
 
-	if (gl_ppfree < size)
-		I_Error("HWR_AllocPoly(): no more memory %u bytes left, %u bytes needed\n\n%s\n",
-		        gl_ppfree, size, "You can try the param -polypoolsize 2048 (or higher if needed)");
+	size = (size + 7) & ~(size_t)7;
 
-	p = (poly_t *)gl_ppcurrent;
-	gl_ppcurrent += size;
-	gl_ppfree -= size;
+	if (pool->free < size)
+	{
+		size_t chunk = max(size, POLYPOOLCHUNK);
+#ifdef HAVE_THREADS
+		I_lock_mutex(&polypool_mutex);
 #endif
-	p->numpts = numpts;
+		pool->current = Z_Malloc(chunk, PU_HWRPLANE, NULL);
+#ifdef HAVE_THREADS
+		I_unlock_mutex(polypool_mutex);
+#endif
+		pool->free = chunk;
+	}
+
+	p = pool->current;
+	pool->current += size;
+	pool->free -= size;
 	return p;
 }
 
-static polyvertex_t *HWR_AllocVertex(void)
+static poly_t *HWR_AllocPoly(polypool_t *pool, INT32 numpts)
 {
-	polyvertex_t *p;
-	size_t size = sizeof (polyvertex_t);
-#ifdef ZPLANALLOC
-	p = Z_Malloc(size, PU_HWRPLANE, NULL);
-#else
-	if (gl_ppfree < size)
-		I_Error("HWR_AllocVertex(): no more memory %u bytes left, %u bytes needed\n\n%s\n",
-		        gl_ppfree, size, "You can try the param -polypoolsize 2048 (or higher if needed)");
+	poly_t *p;
 
-	p = (polyvertex_t *)gl_ppcurrent;
-	gl_ppcurrent += size;
-	gl_ppfree -= size;
-#endif
+	if (numpts < POLYFREELISTS && pool->freelist[numpts])
+	{
+		p = (poly_t *)pool->freelist[numpts];
+		pool->freelist[numpts] = pool->freelist[numpts]->next;
+	}
+	else
+		p = HWR_PoolAlloc(pool, sizeof (poly_t) + sizeof (polyvertex_t) * numpts);
+
+	p->numpts = numpts;
 	return p;
 }
 
-/// \todo polygons should be freed in reverse order for efficiency,
-/// for now don't free because it doesn't free in reverse order
-static void HWR_FreePoly(poly_t *poly)
+static polyvertex_t *HWR_AllocVertex(polypool_t *pool)
 {
-#ifdef ZPLANALLOC
-	Z_Free(poly);
-#else
-	const size_t size = sizeof (poly_t) + sizeof (polyvertex_t) * poly->numpts;
-	memset(poly, 0x00, size);
-	//mempoly -= polysize;
-#endif
+	return HWR_PoolAlloc(pool, sizeof (polyvertex_t));
 }
 
+static void HWR_FreePoly(polypool_t *pool, poly_t *poly)
+{
+	INT32 numpts = poly->numpts;
+	polyfree_t *f = (polyfree_t *)poly;
+
+	// bigger ones are rare enough to just stay where they are
+	if (numpts >= POLYFREELISTS)
+		return;
+
+	f->next = pool->freelist[numpts];
+	pool->freelist[numpts] = f;
+}
 
 // Return interception along bsp line,
-// with the polygon segment
+// with the polygon segment, in pt,
+// and the frac along the bsp line in bspfrac
 //
-static float bspfrac;
-static polyvertex_t *fracdivline(fdivline_t *bsp, polyvertex_t *v1,
-	polyvertex_t *v2)
+static boolean fracdivline(fdivline_t *bsp, polyvertex_t *v1,
+	polyvertex_t *v2, polyvertex_t *pt, float *bspfrac)
 {
-	static polyvertex_t pt;
 	double frac;
 	double num;
 	double den;
@@ -188,27 +185,27 @@ static polyvertex_t *fracdivline(fdivline_t *bsp, polyvertex_t *v1,
 
 	den = v2dy*v1dx - v2dx*v1dy;
 	if (fabsf((float)den) < 1.0E-36f) // avoid checking exactly for 0.0
-		return NULL;       // parallel
+		return false;      // parallel
 
 	// first check the frac along the polygon segment,
 	// (do not accept hit with the extensions)
 	num = (v2x - v1x)*v2dy + (v1y - v2y)*v2dx;
 	frac = num / den;
 	if (frac < 0.0l || frac > 1.0l)
-		return NULL;
+		return false;
 
 	// now get the frac along the BSP line
 	// which is useful to determine what is left, what is right
 	num = (v2x - v1x)*v1dy + (v1y - v2y)*v1dx;
 	frac = num / den;
-	bspfrac = (float)frac;
+	*bspfrac = (float)frac;
 
 
 	// find the interception point along the partition line
-	pt.x = (float)(v2x + v2dx*frac);
-	pt.y = (float)(v2y + v2dy*frac);
+	pt->x = (float)(v2x + v2dx*frac);
+	pt->y = (float)(v2y + v2dy*frac);
 
-	return &pt;
+	return true;
 }
 
 // if two vertice coords have a x and/or y difference
@@ -252,13 +249,16 @@ static boolean SameVertice (polyvertex_t *p1, polyvertex_t *p2)
 //   frontpoly : polygon on right side of bsp line
 //   backpoly  : polygon on left side
 //
-static void SplitPoly (fdivline_t *bsp,         //splitting parametric line
+static void SplitPoly (polypool_t *pool,       //where the new polys come from
+                       fdivline_t *bsp,         //splitting parametric line
                        poly_t *poly,            //the convex poly we split
                        poly_t **frontpoly,      //return one poly here
                        poly_t **backpoly)       //return the other here
 {
 	INT32      i,j;
 	polyvertex_t *pv;
+	polyvertex_t pt;
+	float        bspfrac;
 
 	INT32          ps = -1,pe = -1;
 	INT32          nptfront,nptback;
@@ -275,10 +275,9 @@ static void SplitPoly (fdivline_t *bsp,         //splitting parametric line
 		if (j == poly->numpts) j = 0;
 
 		// start & end points
-		pv = fracdivline(bsp, &poly->pts[i], &poly->pts[j]);
-
-		if (pv == NULL)
+		if (!fracdivline(bsp, &poly->pts[i], &poly->pts[j], &pt, &bspfrac))
 			continue;
+		pv = &pt;
 
 		if (ps < 0)
 		{
@@ -367,11 +366,11 @@ static void SplitPoly (fdivline_t *bsp,         //splitting parametric line
 	nptfront = poly->numpts - peonline - psonline - nptback;
 
 	if (nptback > 0)
-		*backpoly = HWR_AllocPoly(2 + nptback);
+		*backpoly = HWR_AllocPoly(pool, 2 + nptback);
 	else
 		*backpoly = NULL;
 	if (nptfront > 0)
-		*frontpoly = HWR_AllocPoly(2 + nptfront);
+		*frontpoly = HWR_AllocPoly(pool, 2 + nptfront);
 	else
 		*frontpoly = NULL;
 
@@ -415,7 +414,7 @@ static void SplitPoly (fdivline_t *bsp,         //splitting parametric line
 		*frontpoly = swappoly;
 	}
 
-	HWR_FreePoly (poly);
+	HWR_FreePoly (pool, poly);
 }
 
 
@@ -424,11 +423,13 @@ static void SplitPoly (fdivline_t *bsp,         //splitting parametric line
 // the part inside the sector), the part behind the seg, is
 // the void space and is cut out
 //
-static poly_t *CutOutSubsecPoly(seg_t *lseg, INT32 count, poly_t *poly)
+static poly_t *CutOutSubsecPoly(polypool_t *pool, seg_t *lseg, INT32 count, poly_t *poly)
 {
 	INT32 i, j;
 
 	polyvertex_t *pv;
+	polyvertex_t pt;
+	float bspfrac;
 
 	INT32 nump = 0, ps, pe;
 	polyvertex_t vs = {0, 0, 0}, ve = {0, 0, 0},
@@ -467,10 +468,9 @@ static poly_t *CutOutSubsecPoly(seg_t *lseg, INT32 count, poly_t *poly)
 			if (j == poly->numpts)
 				j = 0;
 
-			pv = fracdivline(&cutseg, &poly->pts[i], &poly->pts[j]);
-
-			if (pv == NULL)
+			if (!fracdivline(&cutseg, &poly->pts[i], &poly->pts[j], &pt, &bspfrac))
 				continue;
+			pv = &pt;
 
 			if (ps < 0)
 			{
@@ -515,7 +515,7 @@ static poly_t *CutOutSubsecPoly(seg_t *lseg, INT32 count, poly_t *poly)
 			if (pe >= 0)
 			{
 				// generate FRONT poly
-				temppoly = HWR_AllocPoly(nump);
+				temppoly = HWR_AllocPoly(pool, nump);
 				pv = temppoly->pts;
 				*pv++ = vs;
 				*pv++ = ve;
@@ -525,7 +525,7 @@ static poly_t *CutOutSubsecPoly(seg_t *lseg, INT32 count, poly_t *poly)
 						ps = 0;
 					*pv++ = poly->pts[ps];
 				} while (ps != pe);
-				HWR_FreePoly(poly);
+				HWR_FreePoly(pool, poly);
 				poly = temppoly;
 			}
 			//hmmm... maybe we should NOT accept this, but this happens
@@ -533,7 +533,7 @@ static poly_t *CutOutSubsecPoly(seg_t *lseg, INT32 count, poly_t *poly)
 			// line is aligned to one of the borders of the poly, and
 			// only some times..)
 			else
-				skipcut++;
+				pool->skipcut++;
 			//    I_Error("CutOutPoly: only one point for split line (%d %d) %d", ps, pe, debugpos);
 		}
 	}
@@ -545,7 +545,7 @@ static poly_t *CutOutSubsecPoly(seg_t *lseg, INT32 count, poly_t *poly)
 // so continue to cut off the poly into smaller parts with
 // each seg of the subsector.
 //
-static inline void HWR_SubsecPoly(INT32 num, poly_t *poly)
+static inline void HWR_SubsecPoly(polypool_t *pool, INT32 num, poly_t *poly)
 {
 	INT16 count;
 	subsector_t *sub;
@@ -557,8 +557,8 @@ static inline void HWR_SubsecPoly(INT32 num, poly_t *poly)
 
 	if (poly)
 	{
-		poly = CutOutSubsecPoly (lseg,count,poly);
-		totalsubsecpolys++;
+		poly = CutOutSubsecPoly (pool,lseg,count,poly);
+		pool->totalsubsecpolys++;
 		//extra data for this subsector
 		extrasubsectors[num].planepoly = poly;
 	}
@@ -605,7 +605,7 @@ static void loading_status(void)
 #endif
 
 // poly : the convex polygon that encloses all child subsectors
-static void WalkBSPNode(INT32 bspnum, poly_t *poly, UINT16 *leafnode, fixed_t *bbox)
+static void WalkBSPNode(polypool_t *pool, INT32 bspnum, poly_t *poly, UINT16 *leafnode, fixed_t *bbox)
 {
 	node_t *bsp;
 	poly_t *backpoly, *frontpoly;
@@ -641,7 +641,7 @@ static void WalkBSPNode(INT32 bspnum, poly_t *poly, UINT16 *leafnode, fixed_t *b
 		}
 		else
 		{
-			HWR_SubsecPoly(bspnum & ~NF_SUBSECTOR, poly);
+			HWR_SubsecPoly(pool, bspnum & ~NF_SUBSECTOR, poly);
 
 			//Hurdler: implement a loading status
 #ifdef HWR_LOADING_SCREEN
@@ -663,17 +663,17 @@ static void WalkBSPNode(INT32 bspnum, poly_t *poly, UINT16 *leafnode, fixed_t *b
 
 	bsp = &nodes[bspnum];
 	SearchDivline(bsp, &fdivline);
-	SplitPoly(&fdivline, poly, &frontpoly, &backpoly);
+	SplitPoly(pool, &fdivline, poly, &frontpoly, &backpoly);
 	poly = NULL;
 
 	//debug
 	if (!backpoly)
-		nobackpoly++;
+		pool->nobackpoly++;
 
 	// Recursively divide front space.
 	if (frontpoly)
 	{
-		WalkBSPNode(bsp->children[0], frontpoly, &bsp->children[0],bsp->bbox[0]);
+		WalkBSPNode(pool, bsp->children[0], frontpoly, &bsp->children[0],bsp->bbox[0]);
 
 		// copy child bbox
 		M_Memcpy(bbox, bsp->bbox[0], 4*sizeof (fixed_t));
@@ -685,7 +685,7 @@ static void WalkBSPNode(INT32 bspnum, poly_t *poly, UINT16 *leafnode, fixed_t *b
 	if (backpoly)
 	{
 		// Correct back bbox to include floor/ceiling convex polygon
-		WalkBSPNode(bsp->children[1], backpoly, &bsp->children[1], bsp->bbox[1]);
+		WalkBSPNode(pool, bsp->children[1], backpoly, &bsp->children[1], bsp->bbox[1]);
 
 		// enlarge bbox with second child
 		M_AddToBox(bbox, bsp->bbox[1][BOXLEFT  ],
@@ -786,7 +786,7 @@ static void SearchSegInBSP(INT32 bspnum,polyvertex_t *p,poly_t *poly)
 					&& PointInSeg(p, &q->pts[j],
 						&q->pts[k]))
 				{
-					poly_t *newpoly = HWR_AllocPoly(q->numpts+1);
+					poly_t *newpoly = HWR_AllocPoly(&mainpool, q->numpts+1);
 					INT32 n;
 
 					for (n = 0; n <= j; n++)
@@ -797,7 +797,7 @@ static void SearchSegInBSP(INT32 bspnum,polyvertex_t *p,poly_t *poly)
 					numsplitpoly++;
 					extrasubsectors[bspnum].planepoly =
 						newpoly;
-					HWR_FreePoly(q);
+					HWR_FreePoly(&mainpool, q);
 					return;
 				}
 			}
@@ -851,6 +851,16 @@ static INT32 SolveTProblem(void)
 	return numsplitpoly;
 }
 
+static void HWR_SetSegLength(seg_t *lseg)
+{
+	float x,y;
+	x = ((polyvertex_t *)lseg->pv2)->x - ((polyvertex_t *)lseg->pv1)->x
+		+ FIXED_TO_FLOAT(FRACUNIT/2);
+	y = ((polyvertex_t *)lseg->pv2)->y - ((polyvertex_t *)lseg->pv1)->y
+		+ FIXED_TO_FLOAT(FRACUNIT/2);
+	lseg->flength = (float)hypot(x, y);
+}
+
 #define NEARDIST (0.75f)
 #define MYMAX    (10000000000000.0f)
 
@@ -859,7 +869,7 @@ static INT32 SolveTProblem(void)
  * This also convert fixed_t point of segs in float (in moste case
  * it share the same vertice
  */
-static void AdjustSegs(void)
+static void AdjustSegs(polypool_t *pool, size_t first, size_t last)
 {
 	size_t i, count;
 	INT32 j;
@@ -868,7 +878,7 @@ static void AdjustSegs(void)
 	INT32 v1found = 0, v2found = 0;
 	float nearv1, nearv2;
 
-	for (i = 0; i < numsubsectors; i++)
+	for (i = first; i < last; i++)
 	{
 		count = subsectors[i].numlines;
 		lseg = &segs[subsectors[i].firstline];
@@ -917,7 +927,7 @@ static void AdjustSegs(void)
 				// solve a T-intersection, but too mush work
 
 				// convert fixed vertex to float vertex
-				polyvertex_t *pv = HWR_AllocVertex();
+				polyvertex_t *pv = HWR_AllocVertex(pool);
 				pv->x = FIXED_TO_FLOAT(lseg->v1->x);
 				pv->y = FIXED_TO_FLOAT(lseg->v1->y);
 				lseg->pv1 = pv;
@@ -926,28 +936,345 @@ static void AdjustSegs(void)
 				lseg->pv2 = &(p->pts[v2found]);
 			else
 			{
-				polyvertex_t *pv = HWR_AllocVertex();
+				polyvertex_t *pv = HWR_AllocVertex(pool);
 				pv->x = FIXED_TO_FLOAT(lseg->v2->x);
 				pv->y = FIXED_TO_FLOAT(lseg->v2->y);
 				lseg->pv2 = pv;
 			}
 
 			// recompute length
-			{
-				float x,y;
-				x = ((polyvertex_t *)lseg->pv2)->x - ((polyvertex_t *)lseg->pv1)->x
-					+ FIXED_TO_FLOAT(FRACUNIT/2);
-				y = ((polyvertex_t *)lseg->pv2)->y - ((polyvertex_t *)lseg->pv1)->y
-					+ FIXED_TO_FLOAT(FRACUNIT/2);
-				lseg->flength = (float)hypot(x, y);
-				// BP: debug see this kind of segs
-				//if (nearv2 > NEARDIST*NEARDIST || nearv1 > NEARDIST*NEARDIST)
-				//    lseg->length = 1;
-			}
+			HWR_SetSegLength(lseg);
+			// BP: debug see this kind of segs
+			//if (nearv2 > NEARDIST*NEARDIST || nearv1 > NEARDIST*NEARDIST)
+			//    lseg->length = 1;
 		}
 	}
 }
 
+// --------------------------------------------------------------------------
+// Parallel polygon generation
+// --------------------------------------------------------------------------
+// The top of the BSP is split on the main thread, and the subtrees below
+// it are walked as separate jobs. Subtrees never touch each other's nodes
+// or subsectors, so the result is the same however the jobs get scheduled.
+
+#define POLYJOBDEPTH 6
+#define NUMPOLYJOBS (1<<POLYJOBDEPTH)
+
+typedef struct
+{
+	INT32 bspnum;
+	poly_t *poly;
+	UINT16 *leafnode;
+	fixed_t *bbox;
+} polyjob_t;
+
+// a node split on the main thread, whose bbox is filled once its subtrees are done
+typedef struct
+{
+	node_t *bsp;
+	fixed_t *bbox;
+	boolean back;
+} polysplit_t;
+
+static polypool_t polyjobpools[NUMPOLYJOBS];
+static polyjob_t polyjobs[NUMPOLYJOBS];
+static size_t numpolyjobs;
+static polysplit_t polysplits[NUMPOLYJOBS-1];
+static size_t numpolysplits;
+
+// Same as WalkBSPNode, but stops POLYJOBDEPTH nodes down and queues the subtrees.
+static void SplitBSPNode(INT32 bspnum, poly_t *poly, UINT16 *leafnode, fixed_t *bbox, INT32 depth)
+{
+	node_t *bsp;
+	poly_t *backpoly, *frontpoly;
+	fdivline_t fdivline;
+	polysplit_t *split;
+
+	if ((bspnum & NF_SUBSECTOR) || depth == POLYJOBDEPTH)
+	{
+		polyjob_t *job = &polyjobs[numpolyjobs++];
+		job->bspnum = bspnum;
+		job->poly = poly;
+		job->leafnode = leafnode;
+		job->bbox = bbox;
+		return;
+	}
+
+	bsp = &nodes[bspnum];
+	SearchDivline(bsp, &fdivline);
+	SplitPoly(&mainpool, &fdivline, poly, &frontpoly, &backpoly);
+
+	//debug
+	if (!backpoly)
+		mainpool.nobackpoly++;
+
+	if (!frontpoly)
+		I_Error("WalkBSPNode: no front poly?");
+
+	split = &polysplits[numpolysplits++];
+	split->bsp = bsp;
+	split->bbox = bbox;
+	split->back = (backpoly != NULL);
+
+	SplitBSPNode(bsp->children[0], frontpoly, &bsp->children[0], bsp->bbox[0], depth+1);
+	if (backpoly)
+		SplitBSPNode(bsp->children[1], backpoly, &bsp->children[1], bsp->bbox[1], depth+1);
+}
+
+static void WalkBSPJob(void *userdata, size_t job)
+{
+	polyjob_t *j = &polyjobs[job];
+	(void)userdata;
+	WalkBSPNode(&polyjobpools[job], j->bspnum, j->poly, j->leafnode, j->bbox);
+}
+
+static void AdjustSegsJob(void *userdata, size_t job)
+{
+	(void)userdata;
+	AdjustSegs(&polyjobpools[job],
+		numsubsectors * job / NUMPOLYJOBS,
+		numsubsectors * (job+1) / NUMPOLYJOBS);
+}
+
+static void HWR_WalkBSP(INT32 bspnum, poly_t *poly, fixed_t *bbox)
+{
+	polysplit_t *split;
+	size_t i;
+
+	for (i = 0; i < NUMPOLYJOBS; i++)
+		HWR_ClearPolyPool(&polyjobpools[i]);
+	numpolyjobs = numpolysplits = 0;
+
+	SplitBSPNode(bspnum, poly, NULL, bbox, 0);
+	I_run_jobs("hwr-planepolys", WalkBSPJob, NULL, numpolyjobs);
+
+	// fill in the bboxes above the subtrees, children first
+	for (i = numpolysplits; i--;)
+	{
+		split = &polysplits[i];
+
+		// copy child bbox
+		M_Memcpy(split->bbox, split->bsp->bbox[0], 4*sizeof (fixed_t));
+
+		// enlarge bbox with second child
+		if (split->back)
+		{
+			M_AddToBox(split->bbox, split->bsp->bbox[1][BOXLEFT  ],
+			                        split->bsp->bbox[1][BOXTOP   ]);
+			M_AddToBox(split->bbox, split->bsp->bbox[1][BOXRIGHT ],
+			                        split->bsp->bbox[1][BOXBOTTOM]);
+		}
+	}
+
+	for (i = 0; i < numpolyjobs; i++)
+	{
+		mainpool.nobackpoly += polyjobpools[i].nobackpoly;
+		mainpool.skipcut += polyjobpools[i].skipcut;
+		mainpool.totalsubsecpolys += polyjobpools[i].totalsubsecpolys;
+	}
+}
+
+// --------------------------------------------------------------------------
+// Level cache
+// --------------------------------------------------------------------------
+
+// The polygons depend on whether T-joins get solved.
+#define PLANEPOLYCACHE (cv_glsolvetjoin.value ? "glpolys" : "glpolys_notjoin")
+
+// Index of a seg vertex in its subsector's polygon, or -1 if it has its own.
+static INT32 HWR_SegVertexIndex(poly_t *p, polyvertex_t *pv)
+{
+	if (p && pv >= p->pts && pv < p->pts + p->numpts)
+		return (INT32)(pv - p->pts);
+	return -1;
+}
+
+static polyvertex_t *HWR_SegVertex(poly_t *p, INT32 index, vertex_t *v)
+{
+	polyvertex_t *pv;
+
+	if (p && index >= 0 && index < p->numpts)
+		return &p->pts[index];
+
+	// convert fixed vertex to float vertex
+	pv = HWR_AllocVertex(&mainpool);
+	pv->x = FIXED_TO_FLOAT(v->x);
+	pv->y = FIXED_TO_FLOAT(v->y);
+	return pv;
+}
+
+// Saves everything HWR_CreatePlanePolygons produced: the polygons,
+// the node bounding boxes and leaves WalkBSPNode rewrote,
+// and which polygon vertices the segs ended up sharing.
+static void HWR_CachePlanePolygons(void)
+{
+	size_t size, i, l, count;
+	UINT8 *data, *p;
+	INT32 j;
+	seg_t *lseg;
+	poly_t *poly;
+
+	size = 4 * sizeof(UINT32);
+	size += numnodes * (2 * sizeof(UINT16) + 8 * sizeof(fixed_t));
+	for (l = 0; l < addsubsector; l++)
+	{
+		size += sizeof(INT32);
+		if (extrasubsectors[l].planepoly)
+			size += extrasubsectors[l].planepoly->numpts * sizeof(polyvertex_t);
+	}
+	size += numsegs * 2 * sizeof(INT32);
+
+	data = p = Z_Malloc(size, PU_STATIC, NULL);
+
+	WRITEUINT32(p, numnodes);
+	WRITEUINT32(p, numsubsectors);
+	WRITEUINT32(p, numsegs);
+	WRITEUINT32(p, addsubsector);
+
+	for (i = 0; i < numnodes; i++)
+	{
+		WRITEUINT16(p, nodes[i].children[0]);
+		WRITEUINT16(p, nodes[i].children[1]);
+		for (j = 0; j < 4; j++)
+			WRITEFIXED(p, nodes[i].bbox[0][j]);
+		for (j = 0; j < 4; j++)
+			WRITEFIXED(p, nodes[i].bbox[1][j]);
+	}
+
+	for (l = 0; l < addsubsector; l++)
+	{
+		poly = extrasubsectors[l].planepoly;
+		WRITEINT32(p, poly ? poly->numpts : -1);
+		if (poly)
+		{
+			M_Memcpy(p, poly->pts, poly->numpts * sizeof(polyvertex_t));
+			p += poly->numpts * sizeof(polyvertex_t);
+		}
+	}
+
+	for (i = 0; i < numsubsectors; i++)
+	{
+		poly = extrasubsectors[i].planepoly;
+		lseg = &segs[subsectors[i].firstline];
+		for (count = subsectors[i].numlines; count--; lseg++)
+		{
+			if (lseg->polyseg)
+				continue;
+			WRITEINT32(p, HWR_SegVertexIndex(poly, lseg->pv1));
+			WRITEINT32(p, HWR_SegVertexIndex(poly, lseg->pv2));
+		}
+	}
+
+	P_WriteLevelCache(PLANEPOLYCACHE, data, p - data);
+	Z_Free(data);
+}
+
+static boolean HWR_LoadCachedPlanePolygons(void)
+{
+	size_t length, i, l, count, numcachedsegs;
+	UINT8 *data, *p, *end;
+	INT32 j, numpts;
+	seg_t *lseg;
+	poly_t *poly;
+	boolean valid;
+
+	data = P_ReadLevelCache(PLANEPOLYCACHE, &length, PU_STATIC);
+	if (!data)
+		return false;
+
+	p = data;
+	end = data + length;
+
+	// Check everything adds up before touching any level data.
+	valid = (length >= 4 * sizeof(UINT32)
+		&& READUINT32(p) == numnodes
+		&& READUINT32(p) == numsubsectors
+		&& READUINT32(p) == numsegs);
+
+	if (valid)
+	{
+		addsubsector = READUINT32(p);
+		valid = (addsubsector >= numsubsectors && addsubsector <= totsubsectors);
+	}
+
+	if (valid)
+	{
+		p += numnodes * (2 * sizeof(UINT16) + 8 * sizeof(fixed_t));
+		for (l = 0; l < addsubsector && p + sizeof(INT32) <= end; l++)
+		{
+			numpts = READINT32(p);
+			if (numpts <= 0)
+				continue;
+			if ((size_t)numpts > (size_t)(end - p) / sizeof(polyvertex_t))
+				break;
+			p += numpts * sizeof(polyvertex_t);
+		}
+
+		numcachedsegs = 0;
+		for (i = 0; i < numsubsectors; i++)
+		{
+			lseg = &segs[subsectors[i].firstline];
+			for (count = subsectors[i].numlines; count--; lseg++)
+				if (!lseg->polyseg)
+					numcachedsegs++;
+		}
+
+		valid = (l == addsubsector && p <= end
+			&& (size_t)(end - p) == numcachedsegs * 2 * sizeof(INT32));
+	}
+
+	if (!valid)
+	{
+		CONS_Debug(DBG_RENDER, "Plane polygon cache is invalid\n");
+		addsubsector = numsubsectors;
+		Z_Free(data);
+		return false;
+	}
+
+	p = data + 4 * sizeof(UINT32);
+
+	for (i = 0; i < numnodes; i++)
+	{
+		nodes[i].children[0] = READUINT16(p);
+		nodes[i].children[1] = READUINT16(p);
+		for (j = 0; j < 4; j++)
+			nodes[i].bbox[0][j] = READFIXED(p);
+		for (j = 0; j < 4; j++)
+			nodes[i].bbox[1][j] = READFIXED(p);
+	}
+
+	for (l = 0; l < addsubsector; l++)
+	{
+		numpts = READINT32(p);
+		if (numpts < 0)
+			continue;
+		poly = HWR_AllocPoly(&mainpool, numpts);
+		M_Memcpy(poly->pts, p, numpts * sizeof(polyvertex_t));
+		p += numpts * sizeof(polyvertex_t);
+		extrasubsectors[l].planepoly = poly;
+	}
+
+	for (i = 0; i < numsubsectors; i++)
+	{
+		poly = extrasubsectors[i].planepoly;
+		lseg = &segs[subsectors[i].firstline];
+		for (count = subsectors[i].numlines; count--; lseg++)
+		{
+			if (lseg->polyseg)
+				continue;
+			j = READINT32(p);
+			lseg->pv1 = HWR_SegVertex(poly, j, lseg->v1);
+			j = READINT32(p);
+			lseg->pv2 = HWR_SegVertex(poly, j, lseg->v2);
+			HWR_SetSegLength(lseg);
+		}
+	}
+
+	Z_Free(data);
+	return true;
+}
+
 
 // call this routine after the BSP of a Doom wad file is loaded,
 // and it will generate all the convex polys for the hardware renderer
@@ -965,7 +1292,7 @@ void HWR_CreatePlanePolygons(INT32 bspnum)
 	I_FinishUpdate(); // page flip or blit buffer
 #endif
 
-	HWR_ClearPolys();
+	HWR_ClearPolyPool(&mainpool);
 
 	// find min/max boundaries of map
 	//CONS_Debug(DBG_RENDER, "Looking for boundaries of map...\n");
@@ -990,8 +1317,11 @@ void HWR_CreatePlanePolygons(INT32 bspnum)
 	// number of the first new subsector that might be added
 	addsubsector = numsubsectors;
 
+	if (HWR_LoadCachedPlanePolygons())
+		return;
+
 	// construct the initial convex poly that encloses the full map
-	rootp = HWR_AllocPoly(4);
+	rootp = HWR_AllocPoly(&mainpool, 4);
 	rootpv = rootp->pts;
 
 	rootpv->x = FIXED_TO_FLOAT(rootbbox[BOXLEFT  ]);
@@ -1007,20 +1337,22 @@ void HWR_CreatePlanePolygons(INT32 bspnum)
 	rootpv->y = FIXED_TO_FLOAT(rootbbox[BOXBOTTOM]);  //ll
 	rootpv++;
 
-	WalkBSPNode(bspnum, rootp, NULL,rootbbox);
+	HWR_WalkBSP(bspnum, rootp, rootbbox);
 
 	i = SolveTProblem();
 	//CONS_Debug(DBG_RENDER, "%d point divides a polygon line\n",i);
-	AdjustSegs();
+	I_run_jobs("hwr-adjustsegs", AdjustSegsJob, NULL, NUMPOLYJOBS);
+
+	HWR_CachePlanePolygons();
 
 	//debug debug..
-	//if (nobackpoly)
-	//    CONS_Debug(DBG_RENDER, "no back polygon %u times\n",nobackpoly);
+	//if (mainpool.nobackpoly)
+	//    CONS_Debug(DBG_RENDER, "no back polygon %u times\n",mainpool.nobackpoly);
 	//"(should happen only with the deep water trick)"
-	//if (skipcut)
-	//    CONS_Debug(DBG_RENDER, "%u cuts were skipped because of only one point\n",skipcut);
+	//if (mainpool.skipcut)
+	//    CONS_Debug(DBG_RENDER, "%u cuts were skipped because of only one point\n",mainpool.skipcut);
 
-	//CONS_Debug(DBG_RENDER, "done: %u total subsector convex polygons\n", totalsubsecpolys);
+	//CONS_Debug(DBG_RENDER, "done: %u total subsector convex polygons\n", mainpool.totalsubsecpolys);
 }
 
 #endif //HWRENDER
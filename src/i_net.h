@@ -33,6 +33,7 @@
 
 extern INT16 hardware_MAXPACKETLENGTH;
 extern INT32 net_bandwidth; // in byte/s
+extern precise_t net_arrivaltime; // When the last packet from I_NetGet arrived, 0 if the driver doesn't say
 
 #if defined(_MSC_VER)
 #pragma pack(1)
@@ -99,6 +100,10 @@ extern void (*I_NetSend)(void);
 */
 extern boolean (*I_NetCanSend)(void);
 
+/**	\brief send everything the driver is holding back, if it batches sends
+*/
+extern void (*I_NetFlush)(void);
+
 /**	\brief	close a connection
 
 	\param	nodenum	node to be closed
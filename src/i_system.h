@@ -258,6 +258,22 @@ char *I_GetUserName(void);
 */
 INT32 I_mkdir(const char *dirname, INT32 unixright);
 
+/**	\brief	Maps a whole file in memory, read only
+
+	\param	file	an open file
+	\param	size	size of the file
+
+	\return	the file's contents, or NULL if it can't be mapped
+*/
+void *I_MapFile(FILE *file, size_t size);
+
+/**	\brief	Unmaps a file mapped with I_MapFile
+
+	\param	data	the file's contents
+	\param	size	size of the file
+*/
+void I_UnmapFile(void *data, size_t size);
+
 typedef struct {
 	int FPU        : 1; ///< FPU availabile
 	int CPUID      : 1; ///< CPUID instruction
@@ -12,6 +12,10 @@
 ///        This is not really OS-dependent because all OSes have the same socket API.
 ///        Just use ifdef for OS-dependent parts.
 
+#if defined (__linux__) && !defined (_GNU_SOURCE)
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -66,7 +70,14 @@
 
 		#if defined (__unix__) || defined (__APPLE__) || defined (UNIXCOMMON)
 			#include <sys/time.h>
+			#include <poll.h>
+			#include <fcntl.h>
+			#define USE_POLL
 		#endif // UNIXCOMMON
+
+		#if defined (__linux__) && defined (MSG_WAITFORONE)
+			#define HAVE_MMSG // Batched recvmmsg/sendmmsg
+		#endif
 	#endif
 
 	#ifdef USE_WINSOCK
@@ -142,6 +153,11 @@
 
 #include "doomstat.h"
 
+#if defined (HAVE_THREADS) && defined (USE_POLL)
+	#define NETTHREAD // Optional thread that owns the sockets, see -netthread
+	#include "i_threads.h"
+#endif
+
 // win32
 #ifdef USE_WINSOCK
 	// winsock stuff (in winsock a socket is not a file)
@@ -545,65 +561,427 @@ void Command_Numnodes(void)
 #endif
 
 #ifndef NONET
-// Returns true if a packet was received from a new node, false in all other cases
-static boolean SOCK_Get(void)
+#if defined (HAVE_MMSG) || defined (NETTHREAD)
+typedef struct
 {
-	size_t i, n;
-	int j;
+	SOCKET_TYPE socket;
+	mysockaddr_t address;
+	socklen_t addresslen;
+	INT32 node; // Destination, for error messages
+	precise_t time; // When it arrived
+	size_t length;
+	char data[MAXPACKETLENGTH];
+} sockpacket_t;
+#endif
+
+#ifdef HAVE_MMSG
+// Datagrams read or written with a single system call
+#define MMSGBATCH 32
+
+// Packets read by the last recvmmsg, handed out one at a time by SOCK_Get
+static sockpacket_t recvqueue[MMSGBATCH];
+static size_t recvhead = 0, recvcount = 0;
+
+// Packets waiting for SOCK_FlushSends
+static sockpacket_t sendqueue[MMSGBATCH];
+static size_t sendcount = 0;
+#endif
+
+static inline socklen_t SOCK_AddrLen(const mysockaddr_t *sockaddr)
+{
+	switch (sockaddr->any.sa_family)
+	{
+		case AF_INET:  return (socklen_t)sizeof(struct sockaddr_in);
+#ifdef HAVE_IPV6
+		case AF_INET6: return (socklen_t)sizeof(struct sockaddr_in6);
+#endif
+		default:       return (socklen_t)sizeof(mysockaddr_t);
+	}
+}
+
+#ifdef NETTHREAD
+// With -netthread, a thread does all the reading and writing on the sockets,
+// so packets are picked up as soon as they arrive however long a tic takes.
+// Packets go through a ring each way, with the game thread at one end and
+// the network thread at the other. The thread sleeps in poll until a packet
+// comes in or the game thread writes to the wake pipe.
+// Acks, keepalives and ping replies are still made by the game thread in
+// d_net.c, so they wait for the tic to end like before.
+#define NETRINGSIZE 256 // Must be a power of two
+#define NETTHREADTIMEOUT 100 // Milliseconds, only to notice stopped threads
+
+typedef struct
+{
+	sockpacket_t *packets;
+	I_atomic head; // Next slot to write, owned by the producer
+	I_atomic tail; // Next slot to read, owned by the consumer
+} netring_t;
+
+static netring_t recvring, sendring;
+
+static boolean netthreadactive = false;
+static I_atomic netthreadrunning;
+static I_atomic netthreaderror; // errno of a failed send, for the game thread to report
+static INT32 netthreaderrornode;
+
+static I_mutex netthread_mutex;
+static I_cond netthread_cond;
+static boolean netthreadstopped;
+
+static int netwakepipe[2] = {-1, -1}; // Read end polled by the thread, write end for the game thread
+
+// Indices run over twice the ring size, so a full ring can be told from an empty one
+#define NETRINGINDEX(i) ((i) & (2*NETRINGSIZE - 1))
+
+// Returns the slot to fill next, or NULL if the ring is full
+static sockpacket_t *NetRing_Write(netring_t *ring)
+{
+	const int head = I_atomic_get(&ring->head);
+
+	if (NETRINGINDEX(head - I_atomic_get(&ring->tail)) == NETRINGSIZE)
+		return NULL;
+	return &ring->packets[head & (NETRINGSIZE - 1)];
+}
+
+static void NetRing_Push(netring_t *ring)
+{
+	I_atomic_set(&ring->head, NETRINGINDEX(I_atomic_get(&ring->head) + 1));
+}
+
+// Returns the oldest slot, or NULL if the ring is empty
+static sockpacket_t *NetRing_Read(netring_t *ring)
+{
+	const int tail = I_atomic_get(&ring->tail);
+
+	if (tail == I_atomic_get(&ring->head))
+		return NULL;
+	return &ring->packets[tail & (NETRINGSIZE - 1)];
+}
+
+static void NetRing_Pop(netring_t *ring)
+{
+	I_atomic_set(&ring->tail, NETRINGINDEX(I_atomic_get(&ring->tail) + 1));
+}
+
+// Wakes the network thread up from poll
+static void SOCK_WakeNetThread(void)
+{
+	const char c = 0;
+
+	// If the pipe is full, the thread has a wakeup pending anyway
+	if (write(netwakepipe[1], &c, 1) < 0)
+		return;
+}
+
+static void SOCK_NetThread(void *userdata)
+{
+	struct pollfd fds[MAXNETNODES+2];
+	nfds_t numfds = 0;
+	sockpacket_t *pak;
+	char drain[64];
+	size_t i;
 	ssize_t c;
-	mysockaddr_t fromaddress;
-	socklen_t fromlen;
 
-	for (n = 0; n < mysocketses; n++)
+	(void)userdata;
+
+	fds[numfds].fd = netwakepipe[0];
+	fds[numfds].events = POLLIN;
+	numfds++;
+
+	// The sockets don't change while the thread runs
+	for (i = 0; i < mysocketses; i++)
 	{
-		fromlen = (socklen_t)sizeof(fromaddress);
-		c = recvfrom(mysockets[n], (char *)&doomcom->data, MAXPACKETLENGTH, 0,
-			(void *)&fromaddress, &fromlen);
-		if (c != ERRSOCKET)
+		if (mysockets[i] == (SOCKET_TYPE)ERRSOCKET)
+			continue;
+		fds[numfds].fd = mysockets[i];
+		fds[numfds].events = POLLIN;
+		numfds++;
+	}
+
+	while (I_atomic_get(&netthreadrunning) && !I_thread_is_stopped())
+	{
+		// With the receive ring full, leave the sockets alone until the game thread catches up
+		const boolean canreceive = (NetRing_Write(&recvring) != NULL);
+
+		if (poll(fds, canreceive ? numfds : 1, canreceive ? NETTHREADTIMEOUT : 1) > 0)
 		{
-			// find remote node number
-			for (j = 1; j <= MAXNETNODES; j++) //include LAN
+			if (fds[0].revents & POLLIN)
+				while (read(netwakepipe[0], drain, sizeof (drain)) > 0)
+					;
+
+			for (i = 1; canreceive && i < numfds; i++)
 			{
-				if (SOCK_cmpaddr(&fromaddress, &clientaddress[j], 0))
+				if (!(fds[i].revents & POLLIN))
+					continue;
+
+				while ((pak = NetRing_Write(&recvring)) != NULL)
 				{
-					doomcom->remotenode = (INT16)j; // good packet from a game player
-					doomcom->datalength = (INT16)c;
-					nodesocket[j] = mysockets[n];
-					return false;
+					pak->addresslen = (socklen_t)sizeof (pak->address);
+					c = recvfrom(fds[i].fd, pak->data, sizeof (pak->data), 0,
+						(void *)&pak->address, &pak->addresslen);
+					if (c == ERRSOCKET)
+						break;
+
+					pak->socket = fds[i].fd;
+					pak->length = (size_t)c;
+					pak->time = I_GetPreciseTime();
+					NetRing_Push(&recvring);
 				}
 			}
-			// not found
+		}
 
-			// find a free slot
-			j = getfreenode();
-			if (j > 0)
+		while ((pak = NetRing_Read(&sendring)) != NULL)
+		{
+			c = sendto(pak->socket, pak->data, pak->length, 0, &pak->address.any, pak->addresslen);
+			if (c == ERRSOCKET)
 			{
-				M_Memcpy(&clientaddress[j], &fromaddress, fromlen);
-				nodesocket[j] = mysockets[n];
-				DEBFILE(va("New node detected: node:%d address:%s\n", j,
-						SOCK_GetNodeAddress(j)));
-				doomcom->remotenode = (INT16)j; // good packet from a game player
-				doomcom->datalength = (INT16)c;
-
-				// check if it's a banned dude so we can send a refusal later
-				for (i = 0; i < numbans; i++)
+				int e = errno;
+				if (e != ECONNREFUSED && e != EWOULDBLOCK && !I_atomic_get(&netthreaderror))
 				{
-					if (SOCK_cmpaddr(&fromaddress, &banned[i], bannedmask[i]))
-					{
-						SOCK_bannednode[j] = true;
-						DEBFILE("This dude has been banned\n");
-						break;
-					}
+					netthreaderrornode = pak->node;
+					I_atomic_set(&netthreaderror, e);
 				}
-				if (i == numbans)
-					SOCK_bannednode[j] = false;
-				return true;
 			}
-			else
-				DEBFILE("New node detected: No more free slots\n");
+			NetRing_Pop(&sendring);
 		}
 	}
 
+	I_lock_mutex(&netthread_mutex);
+	netthreadstopped = true;
+	I_wake_all_cond(&netthread_cond);
+	I_unlock_mutex(netthread_mutex);
+}
+
+static void SOCK_StartNetThread(void)
+{
+	recvring.packets = malloc(NETRINGSIZE * sizeof (*recvring.packets));
+	sendring.packets = malloc(NETRINGSIZE * sizeof (*sendring.packets));
+	if (!recvring.packets || !sendring.packets)
+		I_Error("SOCK_StartNetThread: out of memory");
+
+	I_atomic_set(&recvring.head, 0);
+	I_atomic_set(&recvring.tail, 0);
+	I_atomic_set(&sendring.head, 0);
+	I_atomic_set(&sendring.tail, 0);
+	I_atomic_set(&netthreaderror, 0);
+	I_atomic_set(&netthreadrunning, 1);
+	netthreadstopped = false;
+
+	if (pipe(netwakepipe) != 0
+	 || fcntl(netwakepipe[0], F_SETFL, O_NONBLOCK) != 0
+	 || fcntl(netwakepipe[1], F_SETFL, O_NONBLOCK) != 0)
+		I_Error("SOCK_StartNetThread: can't make the wake pipe: %s", strerror(errno));
+
+	netthreadactive = true;
+
+	I_spawn_thread("net-io", SOCK_NetThread, NULL);
+	CONS_Printf("Network thread started\n");
+}
+
+static void SOCK_StopNetThread(void)
+{
+	if (!netthreadactive)
+		return;
+
+	I_atomic_set(&netthreadrunning, 0);
+	SOCK_WakeNetThread();
+
+	// Once threads are stopped the pool has already waited for it
+	if (!I_thread_is_stopped())
+	{
+		I_lock_mutex(&netthread_mutex);
+		while (!netthreadstopped)
+			I_hold_cond(&netthread_cond, netthread_mutex);
+		I_unlock_mutex(netthread_mutex);
+	}
+
+	free(recvring.packets);
+	free(sendring.packets);
+	recvring.packets = sendring.packets = NULL;
+	close(netwakepipe[0]);
+	close(netwakepipe[1]);
+	netwakepipe[0] = netwakepipe[1] = -1;
+	netthreadactive = false;
+}
+
+// Reports a send error the network thread ran into
+static void SOCK_CheckNetThreadError(void)
+{
+	int e = I_atomic_get(&netthreaderror);
+	if (e)
+		I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", netthreaderrornode,
+			SOCK_GetNodeAddress(netthreaderrornode), e, strerror(e));
+}
+#endif
+
+// Finds the node a packet now in doomcom came from, making a new one if needed
+// Returns false if the packet has to be dropped
+static boolean SOCK_AcceptPacket(SOCKET_TYPE socket, mysockaddr_t *fromaddress, socklen_t fromlen, size_t length, boolean *newnode)
+{
+	size_t i;
+	int j;
+
+	*newnode = false;
+
+	// find remote node number
+	for (j = 1; j <= MAXNETNODES; j++) //include LAN
+	{
+		if (SOCK_cmpaddr(fromaddress, &clientaddress[j], 0))
+		{
+			doomcom->remotenode = (INT16)j; // good packet from a game player
+			doomcom->datalength = (INT16)length;
+			nodesocket[j] = socket;
+			return true;
+		}
+	}
+	// not found
+
+	// find a free slot
+	j = getfreenode();
+	if (j > 0)
+	{
+		M_Memcpy(&clientaddress[j], fromaddress, fromlen);
+		nodesocket[j] = socket;
+		DEBFILE(va("New node detected: node:%d address:%s\n", j,
+				SOCK_GetNodeAddress(j)));
+		doomcom->remotenode = (INT16)j; // good packet from a game player
+		doomcom->datalength = (INT16)length;
+
+		// check if it's a banned dude so we can send a refusal later
+		for (i = 0; i < numbans; i++)
+		{
+			if (SOCK_cmpaddr(fromaddress, &banned[i], bannedmask[i]))
+			{
+				SOCK_bannednode[j] = true;
+				DEBFILE("This dude has been banned\n");
+				break;
+			}
+		}
+		if (i == numbans)
+			SOCK_bannednode[j] = false;
+		*newnode = true;
+		return true;
+	}
+
+	DEBFILE("New node detected: No more free slots\n");
+	return false;
+}
+
+#ifdef HAVE_MMSG
+static void SOCK_FlushSends(void);
+
+// Reads as many waiting packets as fit in the queue, sharing it between sockets
+static void SOCK_ReadPackets(void)
+{
+	struct mmsghdr msgs[MMSGBATCH];
+	struct iovec iovs[MMSGBATCH];
+	size_t n, i, room;
+	int got;
+
+	recvhead = recvcount = 0;
+
+	if (!mysocketses)
+		return;
+
+	for (n = 0; n < mysocketses && recvcount < MMSGBATCH; n++)
+	{
+		room = min(MMSGBATCH - recvcount, max(MMSGBATCH / mysocketses, 1));
+
+		for (i = 0; i < room; i++)
+		{
+			sockpacket_t *pak = &recvqueue[recvcount + i];
+
+			iovs[i].iov_base = pak->data;
+			iovs[i].iov_len = sizeof (pak->data);
+			memset(&msgs[i], 0, sizeof (msgs[i]));
+			msgs[i].msg_hdr.msg_name = &pak->address;
+			msgs[i].msg_hdr.msg_namelen = (socklen_t)sizeof (pak->address);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		got = recvmmsg(mysockets[n], msgs, (unsigned int)room, MSG_DONTWAIT, NULL);
+		if (got <= 0)
+			continue;
+
+		for (i = 0; i < (size_t)got; i++)
+		{
+			sockpacket_t *pak = &recvqueue[recvcount + i];
+
+			pak->socket = mysockets[n];
+			pak->addresslen = msgs[i].msg_hdr.msg_namelen;
+			pak->length = msgs[i].msg_len;
+		}
+		recvcount += got;
+	}
+}
+#endif
+
+// Returns true if a packet was received from a new node, false in all other cases
+static boolean SOCK_Get(void)
+{
+	boolean newnode;
+#if defined (HAVE_MMSG) || defined (NETTHREAD)
+	sockpacket_t *pak;
+#endif
+
+#ifdef NETTHREAD
+	if (netthreadactive)
+	{
+		SOCK_CheckNetThreadError();
+
+		while ((pak = NetRing_Read(&recvring)) != NULL)
+		{
+			boolean accepted;
+
+			M_Memcpy(&doomcom->data, pak->data, pak->length);
+			net_arrivaltime = pak->time;
+			accepted = SOCK_AcceptPacket(pak->socket, &pak->address, pak->addresslen, pak->length, &newnode);
+			NetRing_Pop(&recvring);
+			if (accepted)
+				return newnode;
+		}
+
+		doomcom->remotenode = -1; // no packet
+		return false;
+	}
+#endif
+
+#ifdef HAVE_MMSG
+	while (true)
+	{
+		if (recvhead == recvcount)
+		{
+			// Out of packets: a good time to send what is queued,
+			// in case the caller is waiting for an answer to it
+			SOCK_FlushSends();
+			SOCK_ReadPackets();
+			if (!recvcount)
+				break;
+		}
+
+		pak = &recvqueue[recvhead++];
+		M_Memcpy(&doomcom->data, pak->data, pak->length);
+		if (SOCK_AcceptPacket(pak->socket, &pak->address, pak->addresslen, pak->length, &newnode))
+			return newnode;
+	}
+#else
+	size_t n;
+	ssize_t c;
+	mysockaddr_t fromaddress;
+	socklen_t fromlen;
+
+	for (n = 0; n < mysocketses; n++)
+	{
+		fromlen = (socklen_t)sizeof(fromaddress);
+		c = recvfrom(mysockets[n], (char *)&doomcom->data, MAXPACKETLENGTH, 0,
+			(void *)&fromaddress, &fromlen);
+		if (c != ERRSOCKET
+			&& SOCK_AcceptPacket(mysockets[n], &fromaddress, fromlen, (size_t)c, &newnode))
+			return newnode;
+	}
+#endif
+
 	doomcom->remotenode = -1; // no packet
 	return false;
 }
@@ -615,6 +993,51 @@ static boolean SOCK_Get(void)
 static fd_set masterset;
 
 #ifdef SELECTTEST
+#ifdef USE_POLL
+static boolean SOCK_Poll(short events)
+{
+	struct pollfd fds[MAXNETNODES+1];
+	size_t i;
+	nfds_t n = 0;
+
+	for (i = 0; i < mysocketses; i++)
+	{
+		if (mysockets[i] != (SOCKET_TYPE)ERRSOCKET && FD_ISSET(mysockets[i], &masterset))
+		{
+			fds[n].fd = mysockets[i];
+			fds[n].events = events;
+			fds[n].revents = 0;
+			n++;
+		}
+	}
+
+	if (!n)
+		return false;
+	return poll(fds, n, 0) >= 1;
+}
+
+static boolean SOCK_CanSend(void)
+{
+#ifdef NETTHREAD
+	if (netthreadactive)
+		return NetRing_Write(&sendring) != NULL;
+#endif
+	return SOCK_Poll(POLLOUT);
+}
+
+static boolean SOCK_CanGet(void)
+{
+#ifdef NETTHREAD
+	if (netthreadactive)
+		return NetRing_Read(&recvring) != NULL;
+#endif
+#ifdef HAVE_MMSG
+	if (recvhead < recvcount)
+		return true;
+#endif
+	return SOCK_Poll(POLLIN);
+}
+#else
 static boolean FD_CPY(fd_set *src, fd_set *dst, SOCKET_TYPE *fd, size_t len)
 {
 	size_t i;
@@ -661,27 +1084,77 @@ static boolean SOCK_CanGet(void)
 }
 #endif
 #endif
+#endif
 
 #ifndef NONET
 static inline ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr)
 {
-	socklen_t d4 = (socklen_t)sizeof(struct sockaddr_in);
-#ifdef HAVE_IPV6
-	socklen_t d6 = (socklen_t)sizeof(struct sockaddr_in6);
-#endif
-	socklen_t d, da = (socklen_t)sizeof(mysockaddr_t);
+	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, SOCK_AddrLen(sockaddr));
+}
 
-	switch (sockaddr->any.sa_family)
+static void SOCK_SendError(INT32 node)
+{
+	int e = errno; // save error code so it can't be modified later
+	if (e != ECONNREFUSED && e != EWOULDBLOCK)
+		I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", node,
+			SOCK_GetNodeAddress(node), e, strerror(e));
+}
+
+#ifdef HAVE_MMSG
+// Sends every queued packet, with one call per run of packets on the same socket
+static void SOCK_FlushSends(void)
+{
+	struct mmsghdr msgs[MMSGBATCH];
+	struct iovec iovs[MMSGBATCH];
+	size_t i, start, end;
+	int sent;
+
+	for (i = 0; i < sendcount; i++)
 	{
-		case AF_INET:  d = d4; break;
-#ifdef HAVE_IPV6
-		case AF_INET6: d = d6; break;
-#endif
-		default:       d = da; break;
+		sockpacket_t *pak = &sendqueue[i];
+
+		iovs[i].iov_base = pak->data;
+		iovs[i].iov_len = pak->length;
+		memset(&msgs[i], 0, sizeof (msgs[i]));
+		msgs[i].msg_hdr.msg_name = &pak->address;
+		msgs[i].msg_hdr.msg_namelen = pak->addresslen;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (start = 0; start < sendcount; start += sent)
+	{
+		for (end = start; end < sendcount && sendqueue[end].socket == sendqueue[start].socket; end++)
+			;
+
+		// On a short count, the next call reports the error for the packet that failed
+		sent = sendmmsg(sendqueue[start].socket, &msgs[start], (unsigned int)(end - start), 0);
+		if (sent <= 0)
+		{
+			SOCK_SendError(sendqueue[start].node);
+			sent = 1; // Drop it like sendto would
+		}
 	}
 
-	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, d);
+	sendcount = 0;
+}
+
+static void SOCK_QueueSend(INT32 node)
+{
+	sockpacket_t *pak;
+
+	if (sendcount == MMSGBATCH)
+		SOCK_FlushSends();
+
+	pak = &sendqueue[sendcount++];
+	pak->socket = nodesocket[node];
+	pak->address = clientaddress[node];
+	pak->addresslen = SOCK_AddrLen(&clientaddress[node]);
+	pak->node = node;
+	pak->length = doomcom->datalength;
+	M_Memcpy(pak->data, &doomcom->data, pak->length);
 }
+#endif
 
 static void SOCK_Send(void)
 {
@@ -714,16 +1187,43 @@ static void SOCK_Send(void)
 	}
 	else
 	{
+#ifdef NETTHREAD
+		if (netthreadactive)
+		{
+			sockpacket_t *pak = NetRing_Write(&sendring);
+
+			SOCK_CheckNetThreadError();
+
+			if (!pak) // Dropped, as if the socket buffer was full
+			{
+				DEBFILE("SOCK_Send: network thread is behind\n");
+				return;
+			}
+
+			pak->socket = nodesocket[doomcom->remotenode];
+			pak->address = clientaddress[doomcom->remotenode];
+			pak->addresslen = SOCK_AddrLen(&clientaddress[doomcom->remotenode]);
+			pak->node = doomcom->remotenode;
+			pak->length = doomcom->datalength;
+			M_Memcpy(pak->data, &doomcom->data, pak->length);
+
+			// Always wake it: the thread may have just found the ring empty
+			// and be on its way back into poll.
+			NetRing_Push(&sendring);
+			SOCK_WakeNetThread();
+			return;
+		}
+#endif
+#ifdef HAVE_MMSG
+		SOCK_QueueSend(doomcom->remotenode);
+		return;
+#else
 		c = SOCK_SendToAddr(nodesocket[doomcom->remotenode], &clientaddress[doomcom->remotenode]);
+#endif
 	}
 
 	if (c == ERRSOCKET)
-	{
-		int e = errno; // save error code so it can't be modified later
-		if (e != ECONNREFUSED && e != EWOULDBLOCK)
-			I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", doomcom->remotenode,
-				SOCK_GetNodeAddress(doomcom->remotenode), e, strerror(e));
-	}
+		SOCK_SendError(doomcom->remotenode);
 }
 #endif
 
@@ -1150,6 +1650,15 @@ boolean I_InitTcpDriver(void)
 static void SOCK_CloseSocket(void)
 {
 	size_t i;
+
+#ifdef NETTHREAD
+	SOCK_StopNetThread();
+#endif
+#ifdef HAVE_MMSG
+	SOCK_FlushSends();
+	recvhead = recvcount = 0;
+#endif
+
 	for (i=0; i < MAXNETNODES+1; i++)
 	{
 		if (mysockets[i] != (SOCKET_TYPE)ERRSOCKET
@@ -1252,6 +1761,9 @@ static boolean SOCK_OpenSocket(void)
 	I_NetCloseSocket = SOCK_CloseSocket;
 	I_NetFreeNodenum = SOCK_FreeNodenum;
 	I_NetMakeNodewPort = SOCK_NetMakeNodewPort;
+#ifdef HAVE_MMSG
+	I_NetFlush = SOCK_FlushSends;
+#endif
 
 #ifdef SELECTTEST
 	// seem like not work with libsocket : (
@@ -1261,7 +1773,14 @@ static boolean SOCK_OpenSocket(void)
 
 	// build the socket but close it first
 	SOCK_CloseSocket();
-	return UDP_Socket();
+	if (!UDP_Socket())
+		return false;
+
+#ifdef NETTHREAD
+	if (M_CheckParm("-netthread"))
+		SOCK_StartNetThread();
+#endif
+	return true;
 #else
 	return false;
 #endif
@@ -9,16 +9,22 @@
 /// \file  i_threads.h
 /// \brief Multithreading abstraction
 
-#ifdef HAVE_THREADS
-
 #ifndef I_THREADS_H
 #define I_THREADS_H
 
+/* one unit of work out of a batch, see I_run_jobs */
+typedef void (*I_job_fn)(void *userdata, size_t job);
+
+#ifdef HAVE_THREADS
+
 typedef void (*I_thread_fn)(void *userdata);
 
 typedef void * I_mutex;
 typedef void * I_cond;
 
+/* an int that threads can share without a mutex */
+typedef struct { int value; } I_atomic;
+
 void      I_start_threads (void);
 void      I_stop_threads  (void);
 
@@ -35,5 +41,37 @@ void      I_hold_cond       (I_cond *, I_mutex);
 void      I_wake_one_cond   (I_cond *);
 void      I_wake_all_cond   (I_cond *);
 
-#endif/*I_THREADS_H*/
+/* full memory barriers, so writes made before a set are seen after a get */
+int       I_atomic_get      (I_atomic *);
+void      I_atomic_set      (I_atomic *, int);
+
+/* number of threads I_run_jobs spreads work over, caller included */
+int       I_job_thread_count (void);
+
+/*
+run jobs 0 to count-1 over the worker threads and the calling thread,
+returns once every job has finished; jobs may run in any order
+*/
+void      I_run_jobs (const char *name, I_job_fn, void *userdata, size_t count);
+
+#else/*HAVE_THREADS*/
+
+#define   I_job_thread_count() 1
+
+static inline void
+I_run_jobs (
+		const char * name,
+		I_job_fn     fn,
+		void       * userdata,
+		size_t       count
+){
+	size_t job;
+
+	(void)name;
+
+	for (job = 0; job < count; ++job)
+		(*fn)(userdata, job);
+}
+
 #endif/*HAVE_THREADS*/
+#endif/*I_THREADS_H*/
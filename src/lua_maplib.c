@@ -2494,6 +2494,7 @@ static int slope_set(lua_State *L)
 		P_CalculateSlopeNormal(slope);
 		break;
 	}
+	P_SlopeModified(slope);
 	return 0;
 }
 
@@ -634,10 +634,16 @@ void LUA_LoadLump(UINT16 wad, UINT16 lump, boolean noresults)
 	MYFILE f;
 	char *name;
 	size_t len;
+	const void *mapped = W_MappedLumpPwad(wad, lump);
 	f.wad = wad;
 	f.size = W_LumpLengthPwad(wad, lump);
-	f.data = Z_Malloc(f.size, PU_LUA, NULL);
-	W_ReadLumpPwad(wad, lump, f.data);
+	if (mapped) // Lua only reads the script, so it can be parsed in place
+		f.data = (char *)mapped;
+	else
+	{
+		f.data = Z_Malloc(f.size, PU_LUA, NULL);
+		W_ReadLumpPwad(wad, lump, f.data);
+	}
 	f.curpos = f.data;
 
 	len = strlen(wadfiles[wad]->filename); // length of file name
@@ -659,7 +665,8 @@ void LUA_LoadLump(UINT16 wad, UINT16 lump, boolean noresults)
 	LUA_LoadFile(&f, name, noresults); // actually load file!
 
 	free(name);
-	Z_Free(f.data);
+	if (!mapped)
+		Z_Free(f.data);
 }
 
 #ifdef LUA_ALLOW_BYTECODE
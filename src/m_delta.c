@@ -0,0 +1,315 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_delta.c
+/// \brief Binary deltas between two buffers
+///
+///        A delta is a list of operations that rebuild the target from the
+///        base: either copy a run of bytes from the base, or insert literal
+///        bytes. Each operation starts with a varint holding the length
+///        shifted left once, with the low bit set for a copy. A copy is
+///        followed by a varint base offset, a literal by its bytes.
+///
+///        The encoder indexes the base in fixed size blocks and looks for
+///        them in the target with a rolling hash, so inserted or removed
+///        data only costs the bytes that actually changed.
+
+#include "doomdef.h"
+#include "z_zone.h"
+#include "m_delta.h"
+
+#define DELTABLOCK 16
+#define HASHMUL 0x01000193 // FNV prime, any odd constant will do
+
+typedef struct
+{
+	UINT32 hash;
+	UINT32 block; // block number + 1, 0 if the slot is empty
+} deltaslot_t;
+
+typedef struct
+{
+	UINT8 *p;
+	UINT8 *end;
+	boolean overflow;
+} deltawriter_t;
+
+static UINT32 Delta_HashBlock(const UINT8 *p)
+{
+	UINT32 hash = 0;
+	size_t i;
+
+	for (i = 0; i < DELTABLOCK; i++)
+		hash = hash * HASHMUL + p[i];
+
+	return hash;
+}
+
+static UINT32 Delta_Mix(UINT32 hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	return hash;
+}
+
+static void Delta_PutVarint(deltawriter_t *w, size_t value)
+{
+	do
+	{
+		UINT8 byte = value & 0x7F;
+		value >>= 7;
+		if (value)
+			byte |= 0x80;
+
+		if (w->p >= w->end)
+		{
+			w->overflow = true;
+			return;
+		}
+		*w->p++ = byte;
+	} while (value);
+}
+
+static void Delta_PutLiteral(deltawriter_t *w, const UINT8 *data, size_t length)
+{
+	if (!length)
+		return;
+
+	Delta_PutVarint(w, length << 1);
+
+	if (w->overflow || (size_t)(w->end - w->p) < length)
+	{
+		w->overflow = true;
+		return;
+	}
+
+	memcpy(w->p, data, length);
+	w->p += length;
+}
+
+static void Delta_PutCopy(deltawriter_t *w, size_t offset, size_t length)
+{
+	Delta_PutVarint(w, (length << 1) | 1);
+	Delta_PutVarint(w, offset);
+}
+
+static boolean Delta_GetVarint(const UINT8 **p, const UINT8 *end, size_t *value)
+{
+	size_t result = 0;
+	unsigned shift = 0;
+
+	while (*p < end && shift < sizeof(size_t) * 8)
+	{
+		UINT8 byte = *(*p)++;
+		result |= (size_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = result;
+			return true;
+		}
+		shift += 7;
+	}
+
+	return false;
+}
+
+/** Encodes the difference between two buffers.
+  *
+  * \param base         Data the receiver already has.
+  * \param baselength   Size of the base.
+  * \param target       Data the receiver should end up with.
+  * \param targetlength Size of the target.
+  * \param delta        Where to write the delta.
+  * \param maxlength    Size of the delta buffer.
+  * \return Size of the delta, or 0 if it did not fit in maxlength.
+  */
+size_t M_DeltaEncode(const UINT8 *base, size_t baselength,
+	const UINT8 *target, size_t targetlength,
+	UINT8 *delta, size_t maxlength)
+{
+	deltawriter_t w;
+	deltaslot_t *table = NULL;
+	size_t tablemask = 0;
+	size_t numblocks = baselength / DELTABLOCK;
+	size_t pos, literal;
+	size_t expected = 0; // where the base would continue after the last copy
+	UINT32 hash = 0;
+	UINT32 outmul = 1; // weight of the byte leaving the window
+	size_t i;
+
+	w.p = delta;
+	w.end = delta + maxlength;
+	w.overflow = false;
+
+	if (numblocks && targetlength >= DELTABLOCK)
+	{
+		size_t tablesize = 256;
+
+		// Keep the table at most half full.
+		while (tablesize < numblocks * 2)
+			tablesize <<= 1;
+		tablemask = tablesize - 1;
+
+		table = Z_Calloc(tablesize * sizeof(*table), PU_STATIC, NULL);
+
+		for (i = 0; i < numblocks; i++)
+		{
+			UINT32 h = Delta_HashBlock(&base[i * DELTABLOCK]);
+			size_t slot = Delta_Mix(h) & tablemask;
+
+			// Keep the first block with a given hash.
+			while (table[slot].block && table[slot].hash != h)
+				slot = (slot + 1) & tablemask;
+
+			if (!table[slot].block)
+			{
+				table[slot].hash = h;
+				table[slot].block = (UINT32)(i + 1);
+			}
+		}
+	}
+
+	for (i = 1; i < DELTABLOCK; i++)
+		outmul *= HASHMUL;
+
+	pos = literal = 0;
+
+	if (table)
+		hash = Delta_HashBlock(target);
+
+	while (table && pos + DELTABLOCK <= targetlength)
+	{
+		size_t match = (size_t)-1;
+
+		// Unchanged data usually carries on right where the last copy
+		// stopped, so try that before the hash table.
+		if (expected + DELTABLOCK <= baselength
+			&& !memcmp(&target[pos], &base[expected], DELTABLOCK))
+			match = expected;
+		else
+		{
+			size_t slot = Delta_Mix(hash) & tablemask;
+
+			for (; table[slot].block; slot = (slot + 1) & tablemask)
+			{
+				size_t offset = (table[slot].block - 1) * DELTABLOCK;
+
+				if (table[slot].hash == hash
+					&& !memcmp(&target[pos], &base[offset], DELTABLOCK))
+				{
+					match = offset;
+					break;
+				}
+			}
+		}
+
+		if (match != (size_t)-1)
+		{
+			size_t start = pos;
+			size_t end = pos + DELTABLOCK;
+
+			// Grow the match in both directions.
+			while (start > literal && match > 0 && target[start - 1] == base[match - 1])
+			{
+				start--;
+				match--;
+			}
+			while (end < targetlength && match + (end - start) < baselength
+				&& target[end] == base[match + (end - start)])
+				end++;
+
+			Delta_PutLiteral(&w, &target[literal], start - literal);
+			Delta_PutCopy(&w, match, end - start);
+			if (w.overflow)
+				break;
+
+			expected = match + (end - start);
+			pos = literal = end;
+
+			if (pos + DELTABLOCK <= targetlength)
+				hash = Delta_HashBlock(&target[pos]);
+			continue;
+		}
+
+		// No match, slide the window one byte.
+		if (pos + DELTABLOCK < targetlength)
+			hash = (hash - target[pos] * outmul) * HASHMUL + target[pos + DELTABLOCK];
+		pos++;
+
+		// Keep expected in step, so a single changed byte
+		// does not lose track of the base.
+		if (expected < baselength)
+			expected++;
+	}
+
+	if (table)
+		Z_Free(table);
+
+	Delta_PutLiteral(&w, &target[literal], targetlength - literal);
+
+	if (w.overflow)
+		return 0;
+
+	return w.p - delta;
+}
+
+/** Rebuilds a buffer from a base and a delta made by M_DeltaEncode.
+  *
+  * \param base         The base the delta was made against.
+  * \param baselength   Size of the base.
+  * \param delta        The delta.
+  * \param deltalength  Size of the delta.
+  * \param target       Where to rebuild the target.
+  * \param targetlength Expected size of the target.
+  * \return True if the delta was valid and rebuilt exactly targetlength bytes.
+  */
+boolean M_DeltaDecode(const UINT8 *base, size_t baselength,
+	const UINT8 *delta, size_t deltalength,
+	UINT8 *target, size_t targetlength)
+{
+	const UINT8 *p = delta;
+	const UINT8 *end = delta + deltalength;
+	size_t pos = 0;
+
+	while (p < end)
+	{
+		size_t op, length;
+
+		if (!Delta_GetVarint(&p, end, &op))
+			return false;
+
+		length = op >> 1;
+		if (length > targetlength - pos)
+			return false;
+
+		if (op & 1)
+		{
+			size_t offset;
+
+			if (!Delta_GetVarint(&p, end, &offset))
+				return false;
+			if (offset > baselength || length > baselength - offset)
+				return false;
+
+			memcpy(&target[pos], &base[offset], length);
+		}
+		else
+		{
+			if (length > (size_t)(end - p))
+				return false;
+
+			memcpy(&target[pos], p, length);
+			p += length;
+		}
+
+		pos += length;
+	}
+
+	return pos == targetlength;
+}
@@ -0,0 +1,25 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_delta.h
+/// \brief Binary deltas between two buffers
+
+#ifndef M_DELTA_H
+#define M_DELTA_H
+
+#include "doomtype.h"
+
+size_t M_DeltaEncode(const UINT8 *base, size_t baselength,
+	const UINT8 *target, size_t targetlength,
+	UINT8 *delta, size_t maxlength);
+
+boolean M_DeltaDecode(const UINT8 *base, size_t baselength,
+	const UINT8 *delta, size_t deltalength,
+	UINT8 *target, size_t targetlength);
+
+#endif
@@ -0,0 +1,441 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_md5cache.c
+/// \brief Persistent index of file MD5 sums
+///
+///        Hashing every addon at startup, and every candidate file when
+///        joining a server, costs seconds for large mods. The MD5 of each
+///        file is remembered in srb2home/md5cache.txt together with its
+///        size, modification time and inode, and reused for as long as
+///        none of those change. Batches of files that do need hashing are
+///        spread over the job threads.
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "doomdef.h"
+#include "d_main.h" // srb2home
+#include "i_system.h"
+#include "i_threads.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "z_zone.h"
+#include "md5.h"
+#include "m_md5cache.h"
+
+#ifndef NOMD5
+
+#define MD5CACHEFILE "md5cache.txt"
+#define MD5CACHEMAGIC "SRB2MD5"
+
+// Entries beyond this many are only kept if they were used this session.
+#define MD5CACHEMAX 4096
+
+#define MD5CACHEBUCKETS 256
+
+// A file modified this recently may still be written to within the
+// same second, without its modification time changing, so it isn't
+// saved to the index until it has settled.
+#define MD5CACHESETTLE 2
+
+typedef struct
+{
+	UINT64 size;
+	UINT64 mtime;
+	UINT64 inode;
+} md5filestat_t;
+
+typedef struct
+{
+	char *path;
+	UINT32 hash;
+	md5filestat_t stat;
+	UINT8 md5sum[16];
+	boolean used;
+	INT32 next; // Next entry in the same bucket, or -1
+} md5cacheentry_t;
+
+static md5cacheentry_t *md5entries = NULL;
+static INT32 nummd5entries = 0;
+static INT32 maxmd5entries = 0;
+static INT32 md5buckets[MD5CACHEBUCKETS];
+
+static boolean md5cacheloaded = false;
+static boolean md5cachedirty = false;
+
+static boolean M_MD5CacheEnabled(void)
+{
+	static INT32 enabled = -1;
+
+	if (enabled == -1)
+		enabled = !M_CheckParm("-nomd5cache");
+
+	return enabled;
+}
+
+static const char *M_MD5CachePath(void)
+{
+	return va("%s"PATHSEP MD5CACHEFILE, srb2home);
+}
+
+static UINT32 M_MD5CacheHash(const char *path)
+{
+	UINT32 hash = 2166136261u;
+
+	while (*path)
+	{
+		hash ^= (UINT8)*path++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static boolean M_StatMD5File(const char *filename, md5filestat_t *st)
+{
+	struct stat fsstat;
+
+	if (stat(filename, &fsstat) < 0 || (fsstat.st_mode & S_IFMT) != S_IFREG)
+		return false;
+
+	st->size = (UINT64)fsstat.st_size;
+	st->mtime = (UINT64)fsstat.st_mtime;
+	st->inode = (UINT64)fsstat.st_ino;
+	return true;
+}
+
+static md5cacheentry_t *M_FindMD5Entry(const char *path, UINT32 hash)
+{
+	INT32 i;
+
+	for (i = md5buckets[hash % MD5CACHEBUCKETS]; i != -1; i = md5entries[i].next)
+		if (md5entries[i].hash == hash && !strcmp(md5entries[i].path, path))
+			return &md5entries[i];
+
+	return NULL;
+}
+
+static void M_AddMD5Entry(const char *path, const md5filestat_t *st, const UINT8 *md5sum, boolean used)
+{
+	UINT32 hash = M_MD5CacheHash(path);
+	md5cacheentry_t *entry = M_FindMD5Entry(path, hash);
+
+	if (!entry)
+	{
+		if (nummd5entries == maxmd5entries)
+		{
+			maxmd5entries = maxmd5entries ? maxmd5entries * 2 : 64;
+			md5entries = Z_Realloc(md5entries, maxmd5entries * sizeof (*md5entries), PU_STATIC, NULL);
+		}
+
+		entry = &md5entries[nummd5entries];
+		entry->path = Z_StrDup(path);
+		entry->hash = hash;
+		entry->next = md5buckets[hash % MD5CACHEBUCKETS];
+		md5buckets[hash % MD5CACHEBUCKETS] = nummd5entries++;
+	}
+
+	entry->stat = *st;
+	memcpy(entry->md5sum, md5sum, 16);
+	entry->used = used;
+}
+
+static void M_LoadMD5Cache(void)
+{
+	UINT8 *buffer;
+	char *line, *next;
+	INT32 version;
+	INT32 i;
+
+	if (md5cacheloaded)
+		return;
+
+	md5cacheloaded = true;
+
+	for (i = 0; i < MD5CACHEBUCKETS; i++)
+		md5buckets[i] = -1;
+
+	if (!M_MD5CacheEnabled() || !FIL_ReadFile(M_MD5CachePath(), &buffer))
+		return;
+
+	line = (char *)buffer;
+	next = strchr(line, '\n');
+
+	if (next && sscanf(line, MD5CACHEMAGIC" %d", &version) == 1 && version == MD5CACHEVERSION)
+	{
+		// Each line is "md5 size mtime inode path", path last since
+		// it may contain spaces.
+		for (line = next + 1; (next = strchr(line, '\n')) != NULL; line = next + 1)
+		{
+			char md5hex[33];
+			unsigned long long size, mtime, inode;
+			md5filestat_t st;
+			UINT8 md5sum[16];
+			int pathstart;
+			unsigned int byte;
+
+			*next = '\0';
+
+			if (sscanf(line, "%32s %llu %llu %llu %n", md5hex, &size, &mtime, &inode, &pathstart) != 4
+				|| strlen(md5hex) != 32 || !line[pathstart])
+				continue;
+
+			for (i = 0; i < 16; i++)
+			{
+				if (sscanf(&md5hex[i*2], "%2x", &byte) != 1)
+					break;
+				md5sum[i] = (UINT8)byte;
+			}
+
+			if (i < 16)
+				continue;
+
+			st.size = size;
+			st.mtime = mtime;
+			st.inode = inode;
+			M_AddMD5Entry(&line[pathstart], &st, md5sum, false);
+		}
+	}
+	else
+		CONS_Debug(DBG_SETUP, "M_LoadMD5Cache: %s is from another version, ignoring it\n", MD5CACHEFILE);
+
+	Z_Free(buffer);
+	CONS_Debug(DBG_SETUP, "M_LoadMD5Cache: %d files indexed\n", nummd5entries);
+}
+
+static void M_SaveMD5Cache(void)
+{
+	char path[MAX_WADPATH];
+	char temppath[MAX_WADPATH + 4];
+	UINT64 settled = (UINT64)time(NULL) - MD5CACHESETTLE;
+	boolean unsettled = false;
+	INT32 numused = 0, numwritten = 0;
+	FILE *f;
+	INT32 i, j;
+
+	if (!md5cachedirty)
+		return;
+
+	md5cachedirty = false;
+
+	if (!M_MD5CacheEnabled())
+		return;
+
+	strlcpy(path, M_MD5CachePath(), sizeof(path));
+	snprintf(temppath, sizeof(temppath), "%s.tmp", path);
+
+	f = fopen(temppath, "wb");
+	if (!f)
+		return;
+
+	fprintf(f, MD5CACHEMAGIC" %d\n", MD5CACHEVERSION);
+
+	for (i = 0; i < nummd5entries; i++)
+		if (md5entries[i].used)
+			numused++;
+
+	for (i = 0; i < nummd5entries; i++)
+	{
+		const md5cacheentry_t *entry = &md5entries[i];
+
+		if (entry->stat.mtime > settled)
+		{
+			unsettled = true;
+			continue;
+		}
+
+		// Entries from earlier sessions make room for the ones used in this one.
+		if (!entry->used && numwritten + numused >= MD5CACHEMAX)
+			continue;
+
+		for (j = 0; j < 16; j++)
+			fprintf(f, "%02x", entry->md5sum[j]);
+
+		fprintf(f, " %llu %llu %llu %s\n",
+			(unsigned long long)entry->stat.size,
+			(unsigned long long)entry->stat.mtime,
+			(unsigned long long)entry->stat.inode,
+			entry->path);
+
+		if (!entry->used)
+			numwritten++;
+	}
+
+	// Write to a temporary file first, so an interrupted write
+	// can never leave a truncated index behind.
+	if (fclose(f) == 0)
+	{
+		remove(path);
+		if (rename(temppath, path) != 0)
+			remove(temppath);
+	}
+	else
+		remove(temppath);
+
+	// Try again on the next save, once the recent files have settled.
+	md5cachedirty = unsettled;
+}
+
+static md5cacheentry_t *M_LookupMD5Entry(const char *filename, const md5filestat_t *st)
+{
+	md5cacheentry_t *entry = M_FindMD5Entry(filename, M_MD5CacheHash(filename));
+
+	if (!entry || memcmp(&entry->stat, st, sizeof (*st)))
+		return NULL;
+
+	if (!entry->used)
+	{
+		entry->used = true;
+		md5cachedirty = true;
+	}
+
+	return entry;
+}
+
+typedef struct
+{
+	const char *filename;
+	md5filestat_t stat;
+	UINT8 md5sum[16];
+	boolean done;
+} md5job_t;
+
+// Runs on a job thread, so it may only touch its own job.
+static void M_MD5Job(void *userdata, size_t job)
+{
+	md5job_t *md5job = &((md5job_t *)userdata)[job];
+	FILE *fhandle = fopen(md5job->filename, "rb");
+
+	if (fhandle)
+	{
+		md5job->done = !md5_stream(fhandle, md5job->md5sum);
+		fclose(fhandle);
+	}
+}
+#endif
+
+/** Gets the MD5 sum of a file, from the index if the file is unchanged
+  * since it was last hashed.
+  *
+  * \param filename Path of the file.
+  * \param md5sum   Set to the file's MD5 sum.
+  * \return true if the MD5 sum was found, false if the file couldn't be read.
+  */
+boolean M_FileMD5(const char *filename, UINT8 *md5sum)
+{
+#ifdef NOMD5
+	(void)filename;
+	memset(md5sum, 0x00, 16);
+	return true;
+#else
+	md5filestat_t st;
+	md5cacheentry_t *entry;
+	FILE *fhandle;
+	precise_t t;
+	INT32 result;
+
+	if (!M_StatMD5File(filename, &st))
+		return false;
+
+	M_LoadMD5Cache();
+
+	if ((entry = M_LookupMD5Entry(filename, &st)) != NULL)
+	{
+		memcpy(md5sum, entry->md5sum, 16);
+		return true;
+	}
+
+	if ((fhandle = fopen(filename, "rb")) == NULL)
+		return false;
+
+	t = I_GetPreciseTime();
+	CONS_Debug(DBG_SETUP, "Making MD5 for %s\n", filename);
+	result = md5_stream(fhandle, md5sum);
+	fclose(fhandle);
+
+	if (result)
+		return false;
+
+	CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f seconds\n",
+		filename, (double)(I_GetPreciseTime() - t) / I_GetPrecisePrecision());
+
+	// Saved with the next batch, or on shutdown
+	M_AddMD5Entry(filename, &st, md5sum, true);
+	md5cachedirty = true;
+	return true;
+#endif
+}
+
+/** Makes sure the index holds the MD5 sums of a batch of files, hashing
+  * the ones that changed or are new in parallel. Later calls to M_FileMD5
+  * for these files then return at once.
+  *
+  * \param filenames Paths of the files. Missing files are skipped.
+  * \param count     Number of files.
+  */
+void M_PrecacheFileMD5s(const char **filenames, size_t count)
+{
+#ifdef NOMD5
+	(void)filenames;
+	(void)count;
+#else
+	md5job_t *jobs;
+	size_t numjobs = 0;
+	size_t i;
+	precise_t t;
+
+	if (!count)
+		return;
+
+	M_LoadMD5Cache();
+
+	jobs = Z_Calloc(count * sizeof (*jobs), PU_STATIC, NULL);
+
+	for (i = 0; i < count; i++)
+	{
+		md5job_t *job = &jobs[numjobs];
+
+		if (!M_StatMD5File(filenames[i], &job->stat) || M_LookupMD5Entry(filenames[i], &job->stat))
+			continue;
+
+		job->filename = filenames[i];
+		numjobs++;
+	}
+
+	if (numjobs)
+	{
+		t = I_GetPreciseTime();
+		I_run_jobs("md5", M_MD5Job, jobs, numjobs);
+		CONS_Debug(DBG_SETUP, "MD5 calc for %s files over %d threads took %f seconds\n",
+			sizeu1(numjobs), I_job_thread_count(), (double)(I_GetPreciseTime() - t) / I_GetPrecisePrecision());
+
+		for (i = 0; i < numjobs; i++)
+		{
+			if (!jobs[i].done)
+				continue;
+
+			M_AddMD5Entry(jobs[i].filename, &jobs[i].stat, jobs[i].md5sum, true);
+			md5cachedirty = true;
+		}
+	}
+
+	Z_Free(jobs);
+	M_SaveMD5Cache();
+#endif
+}
+
+/** Writes the index out if anything changed since it was last saved.
+  * Called on shutdown, for the sums M_FileMD5 found on its own.
+  */
+void M_SaveFileMD5Cache(void)
+{
+#ifndef NOMD5
+	M_SaveMD5Cache();
+#endif
+}
@@ -0,0 +1,24 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_md5cache.h
+/// \brief Persistent index of file MD5 sums
+
+#ifndef __M_MD5CACHE__
+#define __M_MD5CACHE__
+
+#include "doomtype.h"
+
+// Bump this whenever the layout of the index file changes.
+#define MD5CACHEVERSION 1
+
+boolean M_FileMD5(const char *filename, UINT8 *md5sum);
+void M_PrecacheFileMD5s(const char **filenames, size_t count);
+void M_SaveFileMD5Cache(void);
+
+#endif
@@ -0,0 +1,244 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_levelcache.c
+/// \brief On-disk cache of derived level data
+///
+///        Data that is expensive to build at level load (a generated
+///        blockmap, OpenGL plane polygons) is written to
+///        srb2home/levelcache, one file per section, and read back the
+///        next time the same map is loaded. Files are keyed by an MD5 of
+///        every lump of the map, and carry the engine version and build
+///        revision, so a changed map or a different executable never
+///        picks up stale data.
+
+#include "doomdef.h"
+#include "byteptr.h"
+#include "d_main.h" // srb2home
+#include "i_system.h" // I_mkdir
+#include "m_argv.h"
+#include "m_misc.h"
+#include "z_zone.h"
+#include "md5.h"
+#include "p_levelcache.h"
+
+#define LEVELCACHEDIR "levelcache"
+#define LEVELCACHEMAGIC "SRB2LVLC"
+#define LEVELCACHEREVLEN 16
+
+typedef struct
+{
+	char magic[8];
+	UINT16 cacheversion;
+	UINT16 version;
+	UINT16 subversion;
+	char revision[LEVELCACHEREVLEN];
+	UINT8 key[16];
+	UINT32 length;
+} ATTRPACK levelcacheheader_t;
+
+static lumpnum_t levelcachemap = LUMPERROR; // The map being loaded or played
+static const virtres_t *levelcachevirt = NULL; // Its lumps, while they're loaded
+static UINT8 levelcachekey[16];
+static boolean levelcachekeyset = false;
+
+static boolean P_GetLevelCacheKey(void);
+
+static boolean P_LevelCacheEnabled(void)
+{
+	static INT32 enabled = -1;
+
+	if (enabled == -1)
+		enabled = !M_CheckParm("-nolevelcache");
+
+	return enabled && P_GetLevelCacheKey();
+}
+
+static void P_FillLevelCacheHeader(levelcacheheader_t *header, size_t length)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, LEVELCACHEMAGIC, sizeof(header->magic));
+	header->cacheversion = LEVELCACHEVERSION;
+	header->version = VERSION;
+	header->subversion = SUBVERSION;
+	strncpy(header->revision, comprevision, LEVELCACHEREVLEN);
+	memcpy(header->key, levelcachekey, sizeof(header->key));
+	header->length = (UINT32)length;
+}
+
+static const char *P_LevelCachePath(const char *section)
+{
+	char keyhex[33];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&keyhex[i*2], "%02x", levelcachekey[i]);
+
+	return va("%s"PATHSEP LEVELCACHEDIR PATHSEP"%s.%s", srb2home, keyhex, section);
+}
+
+// Works out the key used for every section of the current map, the first
+// time a section is looked up or stored. The key covers the name, size and
+// contents of every map lump.
+static boolean P_GetLevelCacheKey(void)
+{
+#ifdef NOMD5
+	return false;
+#else
+	const virtres_t *virt = levelcachevirt;
+	virtres_t *reread = NULL;
+	UINT8 *digests;
+	UINT8 *p;
+	size_t i;
+
+	if (levelcachekeyset)
+		return true;
+	if (levelcachemap == LUMPERROR)
+		return false;
+
+	// The map is done loading, so its lumps have to be read again.
+	if (!virt)
+		virt = reread = vres_GetMap(levelcachemap);
+
+	// Hash every lump, then hash the list of names, sizes and hashes.
+	digests = p = Z_Malloc(virt->numlumps * (sizeof(virt->vlumps->name) + 4 + 16), PU_STATIC, NULL);
+
+	for (i = 0; i < virt->numlumps; i++)
+	{
+		const virtlump_t *vlump = &virt->vlumps[i];
+
+		memcpy(p, vlump->name, sizeof(vlump->name));
+		p += sizeof(vlump->name);
+		WRITEUINT32(p, vlump->size);
+		md5_buffer((const char *)vlump->data, vlump->size, p);
+		p += 16;
+	}
+
+	md5_buffer((const char *)digests, p - digests, levelcachekey);
+	Z_Free(digests);
+	if (reread)
+		vres_Free(reread);
+
+	levelcachekeyset = true;
+	return true;
+#endif
+}
+
+/** Sets the map the level cache is for. Its key is only worked out once
+  * a section is looked up or stored, so loading a map with nothing cached
+  * doesn't hash it.
+  *
+  * \param maplump The map's lump.
+  * \param virt    The map's lumps while they're loaded, or NULL once
+  *                they're about to be freed.
+  */
+void P_SetLevelCacheMap(lumpnum_t maplump, const virtres_t *virt)
+{
+	if (maplump != levelcachemap)
+	{
+		levelcachemap = maplump;
+		levelcachekeyset = false;
+	}
+	levelcachevirt = virt;
+}
+
+/** Forgets the current map, when it's unloaded.
+  */
+void P_ClearLevelCacheKey(void)
+{
+	levelcachemap = LUMPERROR;
+	levelcachevirt = NULL;
+	levelcachekeyset = false;
+}
+
+/** Reads a section of the level cache for the current map.
+  *
+  * \param section Name of the section.
+  * \param length  Set to the size of the returned data.
+  * \param tag     Zone tag to allocate the data with.
+  * \return The cached data, which the caller owns, or NULL if there is no
+  *         valid cache for this map.
+  */
+void *P_ReadLevelCache(const char *section, size_t *length, INT32 tag)
+{
+	levelcacheheader_t header, expected;
+	UINT8 *buffer;
+	size_t filelength;
+
+	if (!P_LevelCacheEnabled())
+		return NULL;
+
+	filelength = FIL_ReadFileTag(P_LevelCachePath(section), &buffer, tag);
+	if (!filelength)
+		return NULL;
+
+	if (filelength < sizeof(header))
+	{
+		Z_Free(buffer);
+		return NULL;
+	}
+
+	memcpy(&header, buffer, sizeof(header));
+	P_FillLevelCacheHeader(&expected, filelength - sizeof(header));
+
+	if (memcmp(&header, &expected, sizeof(header)))
+	{
+		CONS_Debug(DBG_SETUP, "P_ReadLevelCache: %s cache is stale\n", section);
+		Z_Free(buffer);
+		return NULL;
+	}
+
+	// Move the payload to the start of the buffer, so the caller
+	// gets something it can keep (and free) as is.
+	*length = header.length;
+	memmove(buffer, buffer + sizeof(header), header.length);
+
+	CONS_Debug(DBG_SETUP, "P_ReadLevelCache: loaded %s (%s bytes)\n", section, sizeu1(*length));
+	return buffer;
+}
+
+/** Writes a section of the level cache for the current map.
+  *
+  * \param section Name of the section.
+  * \param data    Data to store.
+  * \param length  Size of the data.
+  */
+void P_WriteLevelCache(const char *section, const void *data, size_t length)
+{
+	levelcacheheader_t header;
+	UINT8 *buffer;
+	char path[MAX_WADPATH];
+	char temppath[MAX_WADPATH + 4];
+
+	if (!P_LevelCacheEnabled())
+		return;
+
+	I_mkdir(va("%s"PATHSEP LEVELCACHEDIR, srb2home), 0755);
+
+	strlcpy(path, P_LevelCachePath(section), sizeof(path));
+	snprintf(temppath, sizeof(temppath), "%s.tmp", path);
+
+	P_FillLevelCacheHeader(&header, length);
+
+	buffer = Z_Malloc(sizeof(header) + length, PU_STATIC, NULL);
+	memcpy(buffer, &header, sizeof(header));
+	memcpy(buffer + sizeof(header), data, length);
+
+	// Write to a temporary file first, so an interrupted write
+	// can never leave a truncated cache behind.
+	if (FIL_WriteFile(temppath, buffer, sizeof(header) + length))
+	{
+		remove(path);
+		if (rename(temppath, path) != 0)
+			remove(temppath);
+	}
+	else
+		CONS_Debug(DBG_SETUP, "P_WriteLevelCache: could not write %s\n", temppath);
+
+	Z_Free(buffer);
+}
@@ -0,0 +1,27 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_levelcache.h
+/// \brief On-disk cache of derived level data
+
+#ifndef __P_LEVELCACHE__
+#define __P_LEVELCACHE__
+
+#include "doomtype.h"
+#include "w_wad.h"
+
+// Bump this whenever the layout of any cached section changes.
+#define LEVELCACHEVERSION 1
+
+void P_SetLevelCacheMap(lumpnum_t maplump, const virtres_t *virt);
+void P_ClearLevelCacheKey(void);
+
+void *P_ReadLevelCache(const char *section, size_t *length, INT32 tag);
+void P_WriteLevelCache(const char *section, const void *data, size_t length);
+
+#endif
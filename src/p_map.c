@@ -4487,6 +4487,11 @@ boolean P_CheckSector(sector_t *sector, boolean crunch)
 	//
 	// killough 4/7/98: simplified to avoid using complicated counter
 
+	// Every sector height change comes through here.
+	P_MixConsistancy(CONSISTANCY_SECTORS, sector - sectors);
+	P_MixConsistancy(CONSISTANCY_SECTORS, sector->floorheight);
+	P_MixConsistancy(CONSISTANCY_SECTORS, sector->ceilingheight);
+
 	// First, let's see if anything will keep it from crushing.
 	if (!P_CheckSectorHelper(sector, false, crunch))
 		return true;
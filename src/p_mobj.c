@@ -987,6 +987,8 @@ static fixed_t HighestOnLine(fixed_t radius, fixed_t x, fixed_t y, line_t *line,
 	// The solution is simple! Get the line's vertices, and pull each one in along its line until it touches the object's bounding box
 	// (assuming it isn't already inside), then test each point's slope Z and return the higher of the two.
 	vertex_t v1, v2;
+	vector2_t points[2];
+	fixed_t z[2];
 	v1.x = line->v1->x;
 	v1.y = line->v1->y;
 	v2.x = line->v2->x;
@@ -1067,16 +1069,16 @@ static fixed_t HighestOnLine(fixed_t radius, fixed_t x, fixed_t y, line_t *line,
 				);*/
 
 	// Return the higher of the two points
+	points[0].x = v1.x;
+	points[0].y = v1.y;
+	points[1].x = v2.x;
+	points[1].y = v2.y;
+	P_GetSlopeZAtPoints(slope, points, z, 2);
+
 	if (actuallylowest)
-		return min(
-			P_GetSlopeZAt(slope, v1.x, v1.y),
-			P_GetSlopeZAt(slope, v2.x, v2.y)
-		);
+		return min(z[0], z[1]);
 	else
-		return max(
-			P_GetSlopeZAt(slope, v1.x, v1.y),
-			P_GetSlopeZAt(slope, v2.x, v2.y)
-		);
+		return max(z[0], z[1]);
 }
 
 fixed_t P_MobjFloorZ(mobj_t *mobj, sector_t *sector, sector_t *boundsec, fixed_t x, fixed_t y, line_t *line, boolean lowest, boolean perfect)
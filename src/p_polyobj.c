@@ -101,6 +101,33 @@ polymaplink_t **polyblocklinks;
 
 // Polyobject Blockmap
 static polymaplink_t *bmap_freelist; // free list of blockmap links
+static polymaplink_t **bmap_relinkbuf; // scratch space for Polyobj_relinkInBlockmap
+static size_t bmap_relinkbufsize;
+
+// Rotations of a polyobject's vertices for recently used angles. The
+// vertices are kept relative to the spawn spot, which makes them, and the
+// line values derived from them, independent of where the polyobject is.
+#define POLYROTCACHESIZE 32
+
+typedef struct
+{
+	fixed_t dx, dy;
+	angle_t angle;
+	slopetype_t slopetype;
+} polyrotline_t;
+
+typedef struct
+{
+	angle_t angle; // fine angle
+	vertex_t *verts;
+	polyrotline_t *lines;
+} polyrotation_t;
+
+typedef struct polyrotcache_s
+{
+	boolean usable; // false if a line has a vertex the polyobject doesn't move
+	polyrotation_t rotations[POLYROTCACHESIZE];
+} polyrotcache_t;
 
 
 //
@@ -599,7 +626,10 @@ static void Polyobj_moveToSpawnSpot(mapthing_t *anchor)
 	Polyobj_attachToSubsec(po);
 }
 
-// Attaches a polyobject to its appropriate subsector.
+static void Polyobj_removeFromSubsec(polyobj_t *po);
+
+// Attaches a polyobject to its appropriate subsector,
+// moving it there if it's attached elsewhere.
 static void Polyobj_attachToSubsec(polyobj_t *po)
 {
 	subsector_t  *ss;
@@ -624,7 +654,12 @@ static void Polyobj_attachToSubsec(polyobj_t *po)
 
 	ss = R_PointInSubsector(po->centerPt.x, po->centerPt.y);
 
-	M_DLListInsert(&po->link, (mdllistitem_t **)(void *)(&ss->polyList));
+	// already at the front of this subsector's list, same as relinking would leave it
+	if (!(po->attached && ss->polyList == po))
+	{
+		Polyobj_removeFromSubsec(po);
+		M_DLListInsert(&po->link, (mdllistitem_t **)(void *)(&ss->polyList));
+	}
 
 #ifdef R_LINKEDPORTALS
 	// set spawnSpot's groupid for correct portal sound behavior
@@ -677,15 +712,12 @@ static void Polyobj_putLink(polymaplink_t *l)
 // polyobjects need to be linked into every blockmap cell which their
 // bounding box intersects. This ensures the accurate level of clipping
 // which is present with linedefs but absent from most mobj interactions.
-static void Polyobj_linkToBlockmap(polyobj_t *po)
+// Works out the blockmap cells a polyobject's bounding box covers.
+static void Polyobj_setBlockbox(polyobj_t *po)
 {
 	fixed_t *blockbox = po->blockbox;
+	INT32 *linkbox = po->linkbox;
 	size_t i;
-	fixed_t x, y;
-
-	// never link a bad polyobject or a polyobject already linked
-	if (po->isBad || po->linked)
-		return;
 
 	// 2/26/06: start line box with values of first vertex, not INT32_MIN/INT32_MAX
 	blockbox[BOXLEFT]   = blockbox[BOXRIGHT] = po->vertices[0]->x;
@@ -701,62 +733,154 @@ static void Polyobj_linkToBlockmap(polyobj_t *po)
 	blockbox[BOXTOP]    = (unsigned)(blockbox[BOXTOP]    - bmaporgy) >> MAPBLOCKSHIFT;
 	blockbox[BOXBOTTOM] = (unsigned)(blockbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
 
+	// the cells that actually exist; the shifts above never go negative
+	linkbox[BOXLEFT]   = blockbox[BOXLEFT];
+	linkbox[BOXRIGHT]  = min(blockbox[BOXRIGHT], bmapwidth - 1);
+	linkbox[BOXBOTTOM] = blockbox[BOXBOTTOM];
+	linkbox[BOXTOP]    = min(blockbox[BOXTOP], bmapheight - 1);
+}
+
+// Number of cells in a polyobject's linkbox.
+static size_t Polyobj_numLinkCells(const INT32 *linkbox)
+{
+	if (linkbox[BOXLEFT] > linkbox[BOXRIGHT] || linkbox[BOXBOTTOM] > linkbox[BOXTOP])
+		return 0;
+
+	return (size_t)(linkbox[BOXRIGHT] - linkbox[BOXLEFT] + 1)
+		* (size_t)(linkbox[BOXTOP] - linkbox[BOXBOTTOM] + 1);
+}
+
+// Makes room for a polyobject's links to the given number of cells.
+static void Polyobj_allocBlockLinks(polyobj_t *po, size_t numcells)
+{
+	if (numcells > po->numBlockLinksAlloc)
+	{
+		po->numBlockLinksAlloc = numcells;
+		po->blocklinks = Z_Realloc(po->blocklinks,
+			numcells * sizeof(*po->blocklinks), PU_LEVEL, NULL);
+	}
+}
+
+// Inserts a polyobject into the polyobject blockmap. Unlike, mobj_t's,
+// polyobjects need to be linked into every blockmap cell which their
+// bounding box intersects. This ensures the accurate level of clipping
+// which is present with linedefs but absent from most mobj interactions.
+static void Polyobj_linkToBlockmap(polyobj_t *po)
+{
+	INT32 *linkbox = po->linkbox;
+	polymaplink_t **links;
+	INT32 x, y;
+
+	// never link a bad polyobject or a polyobject already linked
+	if (po->isBad || po->linked)
+		return;
+
+	Polyobj_setBlockbox(po);
+	Polyobj_allocBlockLinks(po, Polyobj_numLinkCells(linkbox));
+	links = po->blocklinks;
+
 	// link polyobject to every block its bounding box intersects
-	for (y = blockbox[BOXBOTTOM]; y <= blockbox[BOXTOP]; ++y)
+	for (y = linkbox[BOXBOTTOM]; y <= linkbox[BOXTOP]; ++y)
 	{
-		for (x = blockbox[BOXLEFT]; x <= blockbox[BOXRIGHT]; ++x)
+		for (x = linkbox[BOXLEFT]; x <= linkbox[BOXRIGHT]; ++x)
 		{
-			if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
-			{
-				polymaplink_t  *l = Polyobj_getLink();
+			polymaplink_t  *l = Polyobj_getLink();
 
-				l->po = po;
+			l->po = po;
 
-				M_DLListInsert(&l->link,
-							(mdllistitem_t **)(&polyblocklinks[y*bmapwidth + x]));
-			}
+			M_DLListInsert(&l->link,
+						(mdllistitem_t **)(&polyblocklinks[y*bmapwidth + x]));
+
+			*links++ = l;
 		}
 	}
 
 	po->linked = true;
 }
 
-// Unlinks a polyobject from all blockmap cells it intersects and returns
-// its polymaplink objects to the free list.
-static void Polyobj_removeFromBlockmap(polyobj_t *po)
+// Moves a linked polyobject to the blockmap cells it covers now. Only
+// cells it entered or left have links added or removed; the end result is
+// the same as removing and relinking it, including the polyobject being
+// first in every cell it's in.
+static void Polyobj_relinkInBlockmap(polyobj_t *po)
 {
-	polymaplink_t *rover;
-	fixed_t *blockbox = po->blockbox;
-	INT32 x, y;
+	INT32 oldbox[4];
+	INT32 *newbox = po->linkbox;
+	polymaplink_t **oldlinks = po->blocklinks;
+	polymaplink_t **newlinks;
+	size_t i, numoldcells, numnewcells;
+	INT32 x, y, oldwidth;
+
+	if (po->isBad)
+		return;
 
-	// don't bother trying to unlink one that's not linked
 	if (!po->linked)
+	{
+		Polyobj_linkToBlockmap(po);
 		return;
+	}
+
+	M_Memcpy(oldbox, po->linkbox, sizeof(oldbox));
+	numoldcells = Polyobj_numLinkCells(oldbox);
+	oldwidth = oldbox[BOXRIGHT] - oldbox[BOXLEFT] + 1;
+
+	Polyobj_setBlockbox(po);
+	numnewcells = Polyobj_numLinkCells(newbox);
 
-	// search all cells the polyobject touches
-	for (y = blockbox[BOXBOTTOM]; y <= blockbox[BOXTOP]; ++y)
+	if (numnewcells > bmap_relinkbufsize)
 	{
-		for (x = blockbox[BOXLEFT]; x <= blockbox[BOXRIGHT]; ++x)
+		bmap_relinkbufsize = numnewcells;
+		bmap_relinkbuf = Z_Realloc(bmap_relinkbuf,
+			numnewcells * sizeof(*bmap_relinkbuf), PU_STATIC, NULL);
+	}
+	newlinks = bmap_relinkbuf;
+
+	for (y = newbox[BOXBOTTOM]; y <= newbox[BOXTOP]; ++y)
+	{
+		for (x = newbox[BOXLEFT]; x <= newbox[BOXRIGHT]; ++x)
 		{
-			if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
-			{
-				rover = polyblocklinks[y * bmapwidth + x];
+			polymaplink_t **head = &polyblocklinks[y*bmapwidth + x];
+			polymaplink_t *l;
 
-				while (rover && rover->po != po)
-					rover = (polymaplink_t *)(rover->link.next);
+			if (numoldcells
+				&& x >= oldbox[BOXLEFT] && x <= oldbox[BOXRIGHT]
+				&& y >= oldbox[BOXBOTTOM] && y <= oldbox[BOXTOP])
+			{
+				// still in this cell, just make sure it comes first
+				polymaplink_t **old = &oldlinks[(y - oldbox[BOXBOTTOM])*oldwidth + (x - oldbox[BOXLEFT])];
 
-				// polyobject not in this cell? go on to next.
-				if (!rover)
-					continue;
+				l = *old;
+				*old = NULL;
 
-				// remove this link from the blockmap and put it on the freelist
-				M_DLListRemove(&rover->link);
-				Polyobj_putLink(rover);
+				if (*head != l)
+				{
+					M_DLListRemove(&l->link);
+					M_DLListInsert(&l->link, (mdllistitem_t **)head);
+				}
 			}
+			else
+			{
+				l = Polyobj_getLink();
+				l->po = po;
+				M_DLListInsert(&l->link, (mdllistitem_t **)head);
+			}
+
+			*newlinks++ = l;
 		}
 	}
 
-	po->linked = false;
+	// unlink from the cells it left
+	for (i = 0; i < numoldcells; ++i)
+	{
+		if (oldlinks[i])
+		{
+			M_DLListRemove(&oldlinks[i]->link);
+			Polyobj_putLink(oldlinks[i]);
+		}
+	}
+
+	Polyobj_allocBlockLinks(po, numnewcells);
+	M_Memcpy(po->blocklinks, bmap_relinkbuf, numnewcells * sizeof(*po->blocklinks));
 }
 
 // Movement functions
@@ -1024,10 +1148,8 @@ boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y, boolean checkmobjs)
 
 		if (checkmobjs)
 			Polyobj_carryThings(po, x, y);
-		Polyobj_removeFromBlockmap(po); // unlink it from the blockmap
-		Polyobj_removeFromSubsec(po);   // unlink it from its subsector
-		Polyobj_linkToBlockmap(po);     // relink to blockmap
-		Polyobj_attachToSubsec(po);     // relink to subsector
+		Polyobj_relinkInBlockmap(po); // relink to blockmap
+		Polyobj_attachToSubsec(po);   // relink to subsector
 	}
 
 	return !(hitflags & 2);
@@ -1048,6 +1170,8 @@ static inline void Polyobj_rotatePoint(vertex_t *v, const vector2_t *c, angle_t
 	v->y += c->y;
 }
 
+static void Polyobj_setLineBBox(line_t *ld);
+
 // Taken from P_LoadLineDefs; simply updates the linedef's dx, dy, slopetype,
 // and bounding box to be consistent with its vertices.
 static void Polyobj_rotateLine(line_t *ld)
@@ -1067,7 +1191,14 @@ static void Polyobj_rotateLine(line_t *ld)
 	ld->slopetype = !ld->dx ? ST_VERTICAL : !ld->dy ? ST_HORIZONTAL :
 			((ld->dy > 0) == (ld->dx > 0)) ? ST_POSITIVE : ST_NEGATIVE;
 
-	// update bounding box
+	Polyobj_setLineBBox(ld);
+}
+
+// Updates a linedef's bounding box to be consistent with its vertices.
+static void Polyobj_setLineBBox(line_t *ld)
+{
+	vertex_t *v1 = ld->v1, *v2 = ld->v2;
+
 	if (v1->x < v2->x)
 	{
 		ld->bbox[BOXLEFT]  = v1->x;
@@ -1165,6 +1296,109 @@ static void Polyobj_rotateThings(polyobj_t *po, vector2_t origin, angle_t delta,
 	}
 }
 
+// Checks that every vertex of the polyobject's lines moves with it, which
+// is what lets line values be reused wherever the polyobject is.
+static boolean Polyobj_linesMoveWithVertices(polyobj_t *po)
+{
+	size_t i, j;
+
+	for (i = 0; i < po->numLines; ++i)
+	{
+		line_t *ld = po->lines[i];
+		UINT8 found = 0;
+
+		for (j = 0; j < po->numVertices && found != 3; ++j)
+		{
+			if (po->vertices[j] == ld->v1)
+				found |= 1;
+			if (po->vertices[j] == ld->v2)
+				found |= 2;
+		}
+
+		if (found != 3)
+			return false;
+	}
+
+	return true;
+}
+
+// Moves the vertices and lines of a polyobject to the given fine angle
+// about origin, using the rotation cache when it has this angle.
+static void Polyobj_rotateToAngle(polyobj_t *po, const vector2_t *origin, angle_t angle)
+{
+	polyrotcache_t *cache = po->rotcache;
+	polyrotation_t *rot;
+	size_t i;
+
+	if (!cache)
+	{
+		cache = po->rotcache = Z_Calloc(sizeof(*cache), PU_LEVEL, NULL);
+		cache->usable = Polyobj_linesMoveWithVertices(po);
+	}
+
+	rot = &cache->rotations[angle % POLYROTCACHESIZE];
+
+	if (cache->usable && rot->verts && rot->angle == angle)
+	{
+		for (i = 0; i < po->numVertices; ++i)
+		{
+			po->vertices[i]->x = rot->verts[i].x + origin->x;
+			po->vertices[i]->y = rot->verts[i].y + origin->y;
+		}
+
+		for (i = 0; i < po->numLines; ++i)
+		{
+			line_t *ld = po->lines[i];
+
+			ld->dx = rot->lines[i].dx;
+			ld->dy = rot->lines[i].dy;
+			ld->angle = rot->lines[i].angle;
+			ld->slopetype = rot->lines[i].slopetype;
+			Polyobj_setLineBBox(ld);
+		}
+
+		return;
+	}
+
+	// use original pts to rotate to new position
+	for (i = 0; i < po->numVertices; ++i)
+	{
+		*(po->vertices[i]) = po->origVerts[i];
+		Polyobj_rotatePoint(po->vertices[i], origin, angle);
+	}
+
+	for (i = 0; i < po->numLines; ++i)
+		Polyobj_rotateLine(po->lines[i]);
+
+	if (!cache->usable)
+		return;
+
+	// remember this angle
+	if (!rot->verts)
+	{
+		rot->verts = Z_Malloc(po->numVertices * sizeof(*rot->verts), PU_LEVEL, NULL);
+		rot->lines = Z_Malloc(po->numLines * sizeof(*rot->lines), PU_LEVEL, NULL);
+	}
+
+	rot->angle = angle;
+
+	for (i = 0; i < po->numVertices; ++i)
+	{
+		rot->verts[i].x = po->vertices[i]->x - origin->x;
+		rot->verts[i].y = po->vertices[i]->y - origin->y;
+	}
+
+	for (i = 0; i < po->numLines; ++i)
+	{
+		line_t *ld = po->lines[i];
+
+		rot->lines[i].dx = ld->dx;
+		rot->lines[i].dy = ld->dy;
+		rot->lines[i].angle = ld->angle;
+		rot->lines[i].slopetype = ld->slopetype;
+	}
+}
+
 // Rotates a polyobject around its start point.
 boolean Polyobj_rotate(polyobj_t *po, angle_t delta, boolean turnplayers, boolean turnothers, boolean checkmobjs)
 {
@@ -1183,20 +1417,12 @@ boolean Polyobj_rotate(polyobj_t *po, angle_t delta, boolean turnplayers, boolea
 	origin.x = po->spawnSpot.x;
 	origin.y = po->spawnSpot.y;
 
-	// save current positions and rotate all vertices
+	// save current positions
 	for (i = 0; i < po->numVertices; ++i)
-	{
 		po->tmpVerts[i] = *(po->vertices[i]);
 
-		// use original pts to rotate to new position
-		*(po->vertices[i]) = po->origVerts[i];
-
-		Polyobj_rotatePoint(po->vertices[i], &origin, angle);
-	}
-
-	// rotate lines
-	for (i = 0; i < po->numLines; ++i)
-		Polyobj_rotateLine(po->lines[i]);
+	// rotate all vertices and lines
+	Polyobj_rotateToAngle(po, &origin, angle);
 
 	if (checkmobjs)
 	{
@@ -1226,10 +1452,8 @@ boolean Polyobj_rotate(polyobj_t *po, angle_t delta, boolean turnplayers, boolea
 		// update polyobject's angle
 		po->angle += delta;
 
-		Polyobj_removeFromBlockmap(po); // unlink it from the blockmap
-		Polyobj_removeFromSubsec(po);   // remove from subsector
-		Polyobj_linkToBlockmap(po);     // relink to blockmap
-		Polyobj_attachToSubsec(po);     // relink to subsector
+		Polyobj_relinkInBlockmap(po); // relink to blockmap
+		Polyobj_attachToSubsec(po);   // relink to subsector
 	}
 
 	return !(hitflags & 2);
@@ -2479,10 +2703,8 @@ void T_PolyObjFlag(polymove_t *th)
 	for (i = 0; i < po->numLines; i++)
 		Polyobj_rotateLine(po->lines[i]);
 
-	Polyobj_removeFromBlockmap(po); // unlink it from the blockmap
-	Polyobj_removeFromSubsec(po);   // unlink it from its subsector
-	Polyobj_linkToBlockmap(po);     // relink to blockmap
-	Polyobj_attachToSubsec(po);     // relink to subsector
+	Polyobj_relinkInBlockmap(po); // relink to blockmap
+	Polyobj_attachToSubsec(po);   // relink to subsector
 }
 
 boolean EV_DoPolyObjFlag(polyflagdata_t *pfdata)
@@ -35,9 +35,77 @@
 #include "p_polyobj.h"
 #include "lua_script.h"
 #include "p_slopes.h"
+#include "i_threads.h"
 
 savedata_t savedata;
+#ifdef PARALLELSAVE
+ATTRTHREADLOCAL UINT8 *save_p;
+#else
 UINT8 *save_p;
+#endif
+
+// A colormap index that can only be filled in once all sections are saved
+typedef struct
+{
+	size_t offset;
+	extracolormap_t *colormap;
+} colormapfixup_t;
+
+// A part of a netgame save archived into a buffer of its own
+typedef struct
+{
+	void (*archive)(void);
+	UINT8 *buffer;
+	size_t capacity;
+	size_t length;
+	colormapfixup_t *fixups;
+	size_t numfixups;
+	size_t maxfixups;
+	UINT32 numsaved[NUM_THINKERLISTS]; // Thinkers saved per list, for the log
+} savesection_t;
+
+#define SAVESECTIONSIZE (64*1024)
+#define SAVERECORDSIZE 4096 // Room to leave for any single record
+#define NETSAVEPARTSIZE (64*1024) // Room to leave for each part saved outside a section
+#define NETSAVELUASIZE (768*1024) // Room to leave for Lua, which writes without reserving
+
+// The section this thread is archiving, if any
+#ifdef PARALLELSAVE
+static ATTRTHREADLOCAL savesection_t *save_section;
+#else
+static savesection_t *save_section;
+#endif
+
+// The buffer P_SaveNetGame puts everything together in
+static savesection_t netsave;
+
+/** Makes sure the section being archived, or else the netgame being
+  * saved, has room for size more bytes, growing its buffer if needed.
+  *
+  * \param size Number of bytes about to be written.
+  */
+static void P_ReserveSaveSpace(size_t size)
+{
+	savesection_t *section = save_section ? save_section : &netsave;
+	size_t used;
+
+	if (!section->buffer)
+		return;
+
+	used = save_p - section->buffer;
+	if (section->capacity - used >= size)
+		return;
+
+	while (section->capacity - used < size)
+		section->capacity *= 2;
+
+	// Not the zone: this can run on a worker thread.
+	section->buffer = realloc(section->buffer, section->capacity);
+	if (!section->buffer)
+		I_Error("No more free memory for savegame");
+
+	save_p = section->buffer + used;
+}
 
 // Block UINT32s to attempt to ensure that the correct data is
 // being sent and received
@@ -135,6 +203,8 @@ static void P_NetArchivePlayers(void)
 
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
+		P_ReserveSaveSpace(SAVERECORDSIZE);
+
 		WRITESINT8(save_p, (SINT8)adminplayers[i]);
 
 		if (!playeringame[i])
@@ -607,6 +677,38 @@ static UINT32 CheckAddNetColormapToList(extracolormap_t *extra_colormap)
 	return i;
 }
 
+/** Writes the index of a colormap in the list saved by
+  * P_NetArchiveColormaps. In a section, the list is shared with other
+  * threads, so the index is left blank and filled in once every section
+  * is done, in the same order as a serial save would have added them.
+  *
+  * \param extra_colormap The colormap.
+  */
+static void WriteNetColormap(extracolormap_t *extra_colormap)
+{
+	savesection_t *section = save_section;
+
+	if (!section)
+	{
+		WRITEUINT32(save_p, CheckAddNetColormapToList(extra_colormap));
+		return;
+	}
+
+	if (section->numfixups == section->maxfixups)
+	{
+		section->maxfixups = section->maxfixups ? section->maxfixups * 2 : 16;
+		section->fixups = realloc(section->fixups, section->maxfixups * sizeof(*section->fixups));
+		if (!section->fixups)
+			I_Error("No more free memory for savegame");
+	}
+
+	section->fixups[section->numfixups].offset = save_p - section->buffer;
+	section->fixups[section->numfixups].colormap = extra_colormap;
+	section->numfixups++;
+
+	WRITEUINT32(save_p, 0);
+}
+
 static extracolormap_t *GetNetColormapFromList(UINT32 index)
 {
 	// For loading, we have to be tricky:
@@ -940,6 +1042,8 @@ static void ArchiveFFloors(const sector_t *ss)
 	UINT8 fflr_diff;
 	for (rover = ss->ffloors; rover; rover = rover->next)
 	{
+		P_ReserveSaveSpace(SAVERECORDSIZE);
+
 		fflr_diff = 0; // reset diff flags
 		if (rover->fofflags != rover->spawnflags)
 			fflr_diff |= FD_FLAGS;
@@ -1009,6 +1113,8 @@ static void ArchiveSectors(void)
 
 	for (i = 0; i < numsectors; i++, ss++, spawnss++)
 	{
+		P_ReserveSaveSpace(SAVERECORDSIZE + ss->tags.count * sizeof(INT16));
+
 		diff = diff2 = diff3 = diff4 = 0;
 		if (ss->floorheight != spawnss->floorheight)
 			diff |= SD_FLOORHT;
@@ -1119,7 +1225,7 @@ static void ArchiveSectors(void)
 			}
 
 			if (diff3 & SD_COLORMAP)
-				WRITEUINT32(save_p, CheckAddNetColormapToList(ss->extra_colormap));
+				WriteNetColormap(ss->extra_colormap);
 					// returns existing index if already added, or appends to net_colormaps and returns new index
 			if (diff3 & SD_CRUMBLESTATE)
 				WRITEINT32(save_p, ss->crumblestate);
@@ -1282,6 +1388,8 @@ static void ArchiveLines(void)
 
 	for (i = 0; i < numlines; i++, spawnli++, li++)
 	{
+		P_ReserveSaveSpace(SAVERECORDSIZE);
+
 		diff = diff2 = 0;
 
 		if (li->special != spawnli->special)
@@ -1382,6 +1490,7 @@ static void ArchiveLines(void)
 					}
 
 					len = strlen(li->stringargs[j]);
+					P_ReserveSaveSpace(SAVERECORDSIZE + len);
 					WRITEINT32(save_p, len);
 					for (k = 0; k < len; k++)
 						WRITECHAR(save_p, li->stringargs[j][k]);
@@ -1479,14 +1588,10 @@ static void UnArchiveLines(void)
 
 static void P_NetArchiveWorld(void)
 {
-	// initialize colormap vars because paranoia
-	ClearNetColormaps();
-
 	WRITEUINT32(save_p, ARCHIVEBLOCK_WORLD);
 
 	ArchiveSectors();
 	ArchiveLines();
-	R_ClearTextureNumCache(false);
 }
 
 static void P_NetUnArchiveWorld(void)
@@ -2317,7 +2422,7 @@ static void SaveFadeThinker(const thinker_t *th, const UINT8 type)
 {
 	const fade_t *ht = (const void *)th;
 	WRITEUINT8(save_p, type);
-	WRITEUINT32(save_p, CheckAddNetColormapToList(ht->dest_exc));
+	WriteNetColormap(ht->dest_exc);
 	WRITEUINT32(save_p, ht->sectornum);
 	WRITEUINT32(save_p, ht->ffloornum);
 	WRITEINT32(save_p, ht->alpha);
@@ -2341,8 +2446,8 @@ static void SaveFadeColormapThinker(const thinker_t *th, const UINT8 type)
 	const fadecolormap_t *ht = (const void *)th;
 	WRITEUINT8(save_p, type);
 	WRITEUINT32(save_p, SaveSector(ht->sector));
-	WRITEUINT32(save_p, CheckAddNetColormapToList(ht->source_exc));
-	WRITEUINT32(save_p, CheckAddNetColormapToList(ht->dest_exc));
+	WriteNetColormap(ht->source_exc);
+	WriteNetColormap(ht->dest_exc);
 	WRITEUINT8(save_p, (UINT8)ht->ticbased);
 	WRITEINT32(save_p, ht->duration);
 	WRITEINT32(save_p, ht->timer);
@@ -2503,6 +2608,8 @@ static void P_NetArchiveThinkers(void)
 		// save off the current thinkers
 		for (th = thlist[i].next; th != &thlist[i]; th = th->next)
 		{
+			P_ReserveSaveSpace(SAVERECORDSIZE);
+
 			if (!(th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed
 			 || th->function.acp1 == (actionf_p1)P_NullPrecipThinker))
 				numsaved++;
@@ -2721,7 +2828,8 @@ static void P_NetArchiveThinkers(void)
 #endif
 		}
 
-		CONS_Debug(DBG_NETPLAY, "%u thinkers saved in list %d\n", numsaved, i);
+		// P_NetArchiveSections prints this, we may be on a worker thread
+		save_section->numsaved[i] = numsaved;
 
 		WRITEUINT8(save_p, tc_end);
 	}
@@ -3584,6 +3692,7 @@ static inline thinker_t* LoadDynamicVertexSlopeThinker(actionf_p1 thinker)
 	READMEM(save_p, ht->origsecheights, sizeof(ht->origsecheights));
 	READMEM(save_p, ht->origvecheights, sizeof(ht->origvecheights));
 	ht->relative = READUINT8(save_p);
+	ht->slopeversion = ht->slope->version - 1; // set the slope up on the next tic
 	return &ht->thinker;
 }
 
@@ -4023,7 +4132,10 @@ static inline void P_ArchivePolyObjects(void)
 	WRITEINT32(save_p, numPolyObjects);
 
 	for (i = 0; i < numPolyObjects; ++i)
+	{
+		P_ReserveSaveSpace(SAVERECORDSIZE);
 		P_ArchivePolyObj(&PolyObjects[i]);
+	}
 }
 
 static inline void P_UnArchivePolyObjects(void)
@@ -4167,6 +4279,8 @@ static inline void P_NetArchiveSpecials(void)
 	i = iquetail;
 	while (iquehead != i)
 	{
+		P_ReserveSaveSpace(SAVERECORDSIZE);
+
 		for (z = 0; z < nummapthings; z++)
 		{
 			if (&mapthings[z] == itemrespawnque[i])
@@ -4318,6 +4432,10 @@ static void P_NetArchiveMisc(boolean resending)
 
 	WRITEUINT32(save_p, P_GetRandSeed());
 
+	// The tic hashes can't be rebuilt from the state alone
+	for (i = 0; i < NUMCONSISTANCY; i++)
+		WRITEUINT32(save_p, consistancyhash[i]);
+
 	WRITEUINT32(save_p, tokenlist);
 
 	WRITEUINT32(save_p, leveltime);
@@ -4412,6 +4530,9 @@ static inline boolean P_NetUnArchiveMisc(boolean reloading)
 
 	P_SetRandSeed(READUINT32(save_p));
 
+	for (i = 0; i < NUMCONSISTANCY; i++)
+		consistancyhash[i] = READUINT32(save_p);
+
 	tokenlist = READUINT32(save_p);
 
 	if (!P_LoadLevel(true, reloading))
@@ -4790,14 +4911,109 @@ void P_SaveGame(INT16 mapnum)
 	P_ArchiveLuabanksAndConsistency();
 }
 
-void P_SaveNetGame(boolean resending)
+// Everything from the players to the specials, in save order. These only
+// read the game state, so they can be archived at the same time.
+static savesection_t savesections[] = {
+	{P_NetArchivePlayers, NULL, 0, 0, NULL, 0, 0, {0}},
+	{P_NetArchiveWorld, NULL, 0, 0, NULL, 0, 0, {0}},
+	{P_ArchivePolyObjects, NULL, 0, 0, NULL, 0, 0, {0}},
+	{P_NetArchiveThinkers, NULL, 0, 0, NULL, 0, 0, {0}},
+	{P_NetArchiveSpecials, NULL, 0, 0, NULL, 0, 0, {0}},
+};
+#define NUMSAVESECTIONS (sizeof(savesections) / sizeof(*savesections))
+
+static void P_ArchiveSectionJob(void *userdata, size_t job)
+{
+	savesection_t *section = &((savesection_t *)userdata)[job];
+	UINT8 *oldsave_p = save_p;
+
+	if (!section->buffer)
+	{
+		section->capacity = SAVESECTIONSIZE;
+		section->buffer = malloc(section->capacity);
+		if (!section->buffer)
+			I_Error("No more free memory for savegame");
+	}
+
+	section->numfixups = 0;
+
+	save_section = section;
+	save_p = section->buffer;
+
+	section->archive();
+
+	section->length = save_p - section->buffer;
+	save_section = NULL;
+	save_p = oldsave_p;
+}
+
+/** Archives the first count sections, on worker threads if possible,
+  * and appends them to save_p in order.
+  *
+  * \param count Number of sections to archive.
+  */
+static void P_NetArchiveSections(size_t count)
+{
+	size_t total = 0;
+	size_t i, j;
+
+#ifdef PARALLELSAVE
+	I_run_jobs("netsave", P_ArchiveSectionJob, savesections, count);
+#else
+	for (i = 0; i < count; i++)
+		P_ArchiveSectionJob(savesections, i);
+#endif
+
+	for (i = 0; i < count; i++)
+		total += savesections[i].length;
+	P_ReserveSaveSpace(total);
+
+	for (i = 0; i < count; i++)
+	{
+		savesection_t *section = &savesections[i];
+
+		// Add colormaps to the list in the order a serial save would have.
+		for (j = 0; j < section->numfixups; j++)
+		{
+			UINT8 *p = section->buffer + section->fixups[j].offset;
+			WRITEUINT32(p, CheckAddNetColormapToList(section->fixups[j].colormap));
+		}
+
+		if (section->archive == P_NetArchiveThinkers)
+		{
+			for (j = 0; j < NUM_THINKERLISTS; j++)
+				CONS_Debug(DBG_NETPLAY, "%u thinkers saved in list %s\n", section->numsaved[j], sizeu1(j));
+		}
+
+		memcpy(save_p, section->buffer, section->length);
+		save_p += section->length;
+	}
+}
+
+/** Saves the netgame into a buffer grown to fit it.
+  *
+  * \param resending Whether the gamestate is being resent to a client.
+  * \param header    Bytes to leave free at the start, for the caller.
+  * \param length    Set to the size of the saved data, header included.
+  * \return The buffer, to free with free(), or NULL if out of memory.
+  */
+UINT8 *P_SaveNetGame(boolean resending, size_t header, size_t *length)
 {
 	thinker_t *th;
 	mobj_t *mobj;
+	UINT8 *buffer;
 	INT32 i = 1; // don't start from 0, it'd be confused with a blank pointer otherwise
 
+	netsave.capacity = header + NETSAVEPARTSIZE;
+	netsave.buffer = malloc(netsave.capacity);
+	if (!netsave.buffer)
+		return NULL;
+	save_p = netsave.buffer + header;
+
 	CV_SaveNetVars(&save_p);
+	P_ReserveSaveSpace(NETSAVEPARTSIZE);
 	P_NetArchiveMisc(resending);
+	P_ReserveSaveSpace(NETSAVEPARTSIZE);
 	P_NetArchiveEmblems();
 
 	// Assign the mobjnumber for pointer tracking
@@ -4812,19 +5028,36 @@ void P_SaveNetGame(boolean resending)
 		mobj->mobjnum = i++;
 	}
 
-	P_NetArchivePlayers();
 	if (gamestate == GS_LEVEL)
 	{
-		P_NetArchiveWorld();
-		P_ArchivePolyObjects();
-		P_NetArchiveThinkers();
-		P_NetArchiveSpecials();
+		// initialize colormap vars because paranoia
+		ClearNetColormaps();
+	}
+
+	P_NetArchiveSections(gamestate == GS_LEVEL ? NUMSAVESECTIONS : 1);
+
+	if (gamestate == GS_LEVEL)
+	{
+		R_ClearTextureNumCache(false);
+		P_ReserveSaveSpace(NETSAVEPARTSIZE);
 		P_NetArchiveColormaps();
+		P_ReserveSaveSpace(NETSAVEPARTSIZE);
 		P_NetArchiveWaypoints();
 	}
+
+	P_ReserveSaveSpace(NETSAVELUASIZE);
 	LUA_Archive();
+	if (save_p > netsave.buffer + netsave.capacity)
+		I_Error("Savegame buffer overrun");
 
+	P_ReserveSaveSpace(NETSAVEPARTSIZE);
 	P_ArchiveLuabanksAndConsistency();
+
+	*length = save_p - netsave.buffer;
+	buffer = netsave.buffer;
+	netsave.buffer = NULL;
+	save_p = NULL;
+	return buffer;
 }
 
 boolean P_LoadGame(INT16 mapoverride)
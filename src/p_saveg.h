@@ -24,7 +24,7 @@
 // These are the load / save game routines.
 
 void P_SaveGame(INT16 mapnum);
-void P_SaveNetGame(boolean resending);
+UINT8 *P_SaveNetGame(boolean resending, size_t header, size_t *length);
 boolean P_LoadGame(INT16 mapoverride);
 boolean P_LoadNetGame(boolean reloading);
 
@@ -42,6 +42,13 @@ typedef struct
 } savedata_t;
 
 extern savedata_t savedata;
+// Sections of a netgame save are archived on worker threads when the
+// compiler can give each thread its own save_p.
+#if defined (HAVE_THREADS) && defined (ATTRTHREADLOCAL)
+#define PARALLELSAVE
+extern ATTRTHREADLOCAL UINT8 *save_p;
+#else
 extern UINT8 *save_p;
+#endif
 
 #endif
@@ -83,8 +83,8 @@
 #endif
 
 #include "p_slopes.h"
+#include "p_levelcache.h"
 
-#include "fastcmp.h" // textmap parsing
 
 #include "taglist.h"
 #include "speedrun.h"
@@ -1535,18 +1535,611 @@ static void P_LoadThings(UINT8 *data)
 	}
 }
 
-// Stores positions for relevant map data spread through a TEXTMAP.
-UINT32 mapthingsPos[UINT16_MAX];
-UINT32 linesPos[UINT16_MAX];
-UINT32 sidesPos[UINT16_MAX];
-UINT32 vertexesPos[UINT16_MAX];
-UINT32 sectorsPos[UINT16_MAX];
+//
+// TEXTMAP tokenizer
+//
+// The TEXTMAP is tokenized once, straight out of the lump data. Tokens and
+// values are kept as pointer + length pairs into the lump, so nothing is
+// copied or allocated per token; field names are resolved to a textmapkey_t
+// through a collision-free hash table, and the element parsers below just
+// switch on that.
+//
+
+typedef enum
+{
+	TMK_UNKNOWN = 0,
+
+	// Shared
+	TMK_ID,
+	TMK_MOREIDS,
+	TMK_X,
+	TMK_Y,
+	TMK_ARG, // argN, with the number stored separately
+	TMK_STRINGARG, // stringargN, likewise
+
+	// Vertices
+	TMK_ZFLOOR,
+	TMK_ZCEILING,
+
+	// Sectors
+	TMK_HEIGHTFLOOR,
+	TMK_HEIGHTCEILING,
+	TMK_TEXTUREFLOOR,
+	TMK_TEXTURECEILING,
+	TMK_LIGHTLEVEL,
+	TMK_LIGHTFLOOR,
+	TMK_LIGHTFLOORABSOLUTE,
+	TMK_LIGHTCEILING,
+	TMK_LIGHTCEILINGABSOLUTE,
+	TMK_XPANNINGFLOOR,
+	TMK_YPANNINGFLOOR,
+	TMK_XPANNINGCEILING,
+	TMK_YPANNINGCEILING,
+	TMK_ROTATIONFLOOR,
+	TMK_ROTATIONCEILING,
+	TMK_FLOORPLANE_A,
+	TMK_FLOORPLANE_B,
+	TMK_FLOORPLANE_C,
+	TMK_FLOORPLANE_D,
+	TMK_CEILINGPLANE_A,
+	TMK_CEILINGPLANE_B,
+	TMK_CEILINGPLANE_C,
+	TMK_CEILINGPLANE_D,
+	TMK_LIGHTCOLOR,
+	TMK_LIGHTALPHA,
+	TMK_FADECOLOR,
+	TMK_FADEALPHA,
+	TMK_FADESTART,
+	TMK_FADEEND,
+	TMK_COLORMAPFOG,
+	TMK_COLORMAPFADESPRITES,
+	TMK_COLORMAPPROTECTED,
+	TMK_FLIPSPECIAL_NOFLOOR,
+	TMK_FLIPSPECIAL_CEILING,
+	TMK_TRIGGERSPECIAL_TOUCH,
+	TMK_TRIGGERSPECIAL_HEADBUMP,
+	TMK_TRIGGERLINE_PLANE,
+	TMK_TRIGGERLINE_MOBJ,
+	TMK_INVERTPRECIP,
+	TMK_GRAVITYFLIP,
+	TMK_HEATWAVE,
+	TMK_NOCLIPCAMERA,
+	TMK_OUTERSPACE,
+	TMK_DOUBLESTEPUP,
+	TMK_NOSTEPDOWN,
+	TMK_SPEEDPAD,
+	TMK_STARPOSTACTIVATOR,
+	TMK_EXIT,
+	TMK_SPECIALSTAGEPIT,
+	TMK_RETURNFLAG,
+	TMK_REDTEAMBASE,
+	TMK_BLUETEAMBASE,
+	TMK_FAN,
+	TMK_SUPERTRANSFORM,
+	TMK_FORCESPIN,
+	TMK_ZOOMTUBESTART,
+	TMK_ZOOMTUBEEND,
+	TMK_FINISHLINE,
+	TMK_ROPEHANG,
+	TMK_JUMPFLIP,
+	TMK_GRAVITYOVERRIDE,
+	TMK_FRICTION,
+	TMK_GRAVITY,
+	TMK_DAMAGETYPE,
+	TMK_TRIGGERTAG,
+	TMK_TRIGGERER,
+
+	// Sidedefs
+	TMK_OFFSETX,
+	TMK_OFFSETY,
+	TMK_OFFSETX_TOP,
+	TMK_OFFSETX_MID,
+	TMK_OFFSETX_BOTTOM,
+	TMK_OFFSETY_TOP,
+	TMK_OFFSETY_MID,
+	TMK_OFFSETY_BOTTOM,
+	TMK_TEXTURETOP,
+	TMK_TEXTUREBOTTOM,
+	TMK_TEXTUREMIDDLE,
+	TMK_SECTOR,
+	TMK_REPEATCNT,
+
+	// Linedefs
+	TMK_SPECIAL,
+	TMK_V1,
+	TMK_V2,
+	TMK_SIDEFRONT,
+	TMK_SIDEBACK,
+	TMK_ALPHA,
+	TMK_BLENDMODE,
+	TMK_RENDERSTYLE,
+	TMK_EXECUTORDELAY,
+	TMK_BLOCKING,
+	TMK_BLOCKMONSTERS,
+	TMK_TWOSIDED,
+	TMK_DONTPEGTOP,
+	TMK_DONTPEGBOTTOM,
+	TMK_SKEWTD,
+	TMK_NOCLIMB,
+	TMK_NOSKEW,
+	TMK_MIDPEG,
+	TMK_MIDSOLID,
+	TMK_WRAPMIDTEX,
+	TMK_NONET,
+	TMK_NETONLY,
+	TMK_BOUNCY,
+	TMK_TRANSFER,
+
+	// Things
+	TMK_HEIGHT,
+	TMK_ANGLE,
+	TMK_PITCH,
+	TMK_ROLL,
+	TMK_TYPE,
+	TMK_SCALE,
+	TMK_SCALEX,
+	TMK_SCALEY,
+	TMK_MOBJSCALE,
+	TMK_FLIP,
+	TMK_ABSOLUTEZ,
+
+	NUMTEXTMAPKEYS
+} textmapkey_t;
+
+// Must match the order of textmapkey_t.
+static const char *const textmapkeynames[NUMTEXTMAPKEYS] = {
+	NULL,
+
+	"id",
+	"moreids",
+	"x",
+	"y",
+	NULL, // argN
+	NULL, // stringargN
+
+	"zfloor",
+	"zceiling",
+
+	"heightfloor",
+	"heightceiling",
+	"texturefloor",
+	"textureceiling",
+	"lightlevel",
+	"lightfloor",
+	"lightfloorabsolute",
+	"lightceiling",
+	"lightceilingabsolute",
+	"xpanningfloor",
+	"ypanningfloor",
+	"xpanningceiling",
+	"ypanningceiling",
+	"rotationfloor",
+	"rotationceiling",
+	"floorplane_a",
+	"floorplane_b",
+	"floorplane_c",
+	"floorplane_d",
+	"ceilingplane_a",
+	"ceilingplane_b",
+	"ceilingplane_c",
+	"ceilingplane_d",
+	"lightcolor",
+	"lightalpha",
+	"fadecolor",
+	"fadealpha",
+	"fadestart",
+	"fadeend",
+	"colormapfog",
+	"colormapfadesprites",
+	"colormapprotected",
+	"flipspecial_nofloor",
+	"flipspecial_ceiling",
+	"triggerspecial_touch",
+	"triggerspecial_headbump",
+	"triggerline_plane",
+	"triggerline_mobj",
+	"invertprecip",
+	"gravityflip",
+	"heatwave",
+	"noclipcamera",
+	"outerspace",
+	"doublestepup",
+	"nostepdown",
+	"speedpad",
+	"starpostactivator",
+	"exit",
+	"specialstagepit",
+	"returnflag",
+	"redteambase",
+	"blueteambase",
+	"fan",
+	"supertransform",
+	"forcespin",
+	"zoomtubestart",
+	"zoomtubeend",
+	"finishline",
+	"ropehang",
+	"jumpflip",
+	"gravityoverride",
+	"friction",
+	"gravity",
+	"damagetype",
+	"triggertag",
+	"triggerer",
+
+	"offsetx",
+	"offsety",
+	"offsetx_top",
+	"offsetx_mid",
+	"offsetx_bottom",
+	"offsety_top",
+	"offsety_mid",
+	"offsety_bottom",
+	"texturetop",
+	"texturebottom",
+	"texturemiddle",
+	"sector",
+	"repeatcnt",
+
+	"special",
+	"v1",
+	"v2",
+	"sidefront",
+	"sideback",
+	"alpha",
+	"blendmode",
+	"renderstyle",
+	"executordelay",
+	"blocking",
+	"blockmonsters",
+	"twosided",
+	"dontpegtop",
+	"dontpegbottom",
+	"skewtd",
+	"noclimb",
+	"noskew",
+	"midpeg",
+	"midsolid",
+	"wrapmidtex",
+	"nonet",
+	"netonly",
+	"bouncy",
+	"transfer",
+
+	"height",
+	"angle",
+	"pitch",
+	"roll",
+	"type",
+	"scale",
+	"scalex",
+	"scaley",
+	"mobjscale",
+	"flip",
+	"absolutez",
+};
+
+// Key lookup table. The seed is picked once so that every key above lands
+// in its own slot, making a lookup one hash and one compare.
+#define TEXTMAPKEYHASHBITS 11
+#define TEXTMAPKEYHASHSIZE (1<<TEXTMAPKEYHASHBITS)
+static UINT8 textmapkeyhash[TEXTMAPKEYHASHSIZE];
+static UINT8 textmapkeylen[NUMTEXTMAPKEYS];
+static UINT32 textmapkeyseed = 0;
+static boolean textmapkeysready = false;
+
+static inline UINT32 TextmapKeySlot(const char *s, size_t len, UINT32 seed)
+{
+	UINT32 h = 2166136261u ^ seed;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		h ^= (UINT8)s[i];
+		h *= 16777619u;
+	}
+
+	h ^= h >> 15;
+	return h & (TEXTMAPKEYHASHSIZE - 1);
+}
+
+static void TextmapInitKeys(void)
+{
+	UINT32 seed;
+	size_t i;
 
-// Determine total amount of map data in TEXTMAP.
-static boolean TextmapCount(size_t size)
+	for (i = 1; i < NUMTEXTMAPKEYS; i++)
+		textmapkeylen[i] = textmapkeynames[i] ? (UINT8)strlen(textmapkeynames[i]) : 0;
+
+	for (seed = 0;; seed++)
+	{
+		memset(textmapkeyhash, 0, sizeof(textmapkeyhash));
+
+		for (i = 1; i < NUMTEXTMAPKEYS; i++)
+		{
+			UINT32 slot;
+
+			if (!textmapkeynames[i])
+				continue;
+
+			slot = TextmapKeySlot(textmapkeynames[i], textmapkeylen[i], seed);
+			if (textmapkeyhash[slot])
+				break;
+			textmapkeyhash[slot] = (UINT8)i;
+		}
+
+		if (i == NUMTEXTMAPKEYS)
+			break;
+	}
+
+	textmapkeyseed = seed;
+	textmapkeysready = true;
+}
+
+typedef enum
 {
-	const char *tkn = M_TokenizerRead(0);
-	UINT8 brackets = 0;
+	TMB_VERTEX,
+	TMB_SECTOR,
+	TMB_SIDEDEF,
+	TMB_LINEDEF,
+	TMB_THING,
+	NUMTEXTMAPBLOCKS
+} textmapblocktype_t;
+
+typedef struct
+{
+	const char *str;
+	size_t len;
+} textmaptoken_t;
+
+typedef struct
+{
+	UINT8 key; // textmapkey_t
+	UINT8 argnum; // for TMK_ARG and TMK_STRINGARG
+	UINT32 len;
+	const char *val; // Not NUL-terminated! Always followed by a delimiter, though.
+} textmapfield_t;
+
+typedef struct
+{
+	UINT8 type; // textmapblocktype_t
+	UINT32 firstfield;
+	UINT32 numfields;
+} textmapblock_t;
+
+static const char *textmapdata;
+static size_t textmapsize;
+static size_t textmappos;
+
+static textmapfield_t *textmapfields = NULL;
+static UINT32 numtextmapfields, maxtextmapfields;
+static textmapblock_t *textmapblocks = NULL;
+static UINT32 numtextmapblocks, maxtextmapblocks;
+
+static inline boolean TextmapTokenIs(const textmaptoken_t *tkn, const char *str)
+{
+	return (tkn->len == strlen(str) && !memcmp(tkn->str, str, tkn->len));
+}
+
+static inline boolean TextmapIsDelimiter(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\r' || c == '\n'
+		|| c == ',' || c == '{' || c == '}'
+		|| c == '=' || c == ';'); // UDMF TEXTMAP.
+}
+
+static inline boolean TextmapIsCommentStart(size_t pos)
+{
+	return (pos + 1 < textmapsize && textmapdata[pos] == '/'
+		&& (textmapdata[pos + 1] == '/' || textmapdata[pos + 1] == '*'));
+}
+
+// Same token rules as M_TokenizerRead, minus the copying.
+static boolean TextmapReadToken(textmaptoken_t *tkn)
+{
+	const char *s = textmapdata;
+	size_t pos = textmappos;
+	size_t start;
+
+	// Skip whitespace, separators and comments.
+	while (pos < textmapsize)
+	{
+		const char c = s[pos];
+
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0' || c == '=' || c == ';')
+			pos++;
+		else if (TextmapIsCommentStart(pos))
+		{
+			if (s[pos + 1] == '/')
+			{
+				while (pos < textmapsize && s[pos] != '\n')
+					pos++;
+			}
+			else
+			{
+				pos += 2;
+				while (pos < textmapsize && !(s[pos] == '*' && pos + 1 < textmapsize && s[pos + 1] == '/'))
+					pos++;
+				pos += 2;
+			}
+		}
+		else
+			break;
+	}
+
+	if (pos >= textmapsize)
+	{
+		textmappos = textmapsize;
+		return false;
+	}
+
+	start = pos;
+
+	if (s[pos] == ',' || s[pos] == '{' || s[pos] == '}')
+		pos++;
+	else if (s[pos] == '"')
+	{
+		// Entire string within quotes, except without the quotes.
+		start = ++pos;
+		while (pos < textmapsize && s[pos] != '"')
+			pos++;
+		tkn->str = s + start;
+		tkn->len = pos - start;
+		textmappos = pos + 1;
+		return true;
+	}
+	else
+	{
+		pos++;
+		while (pos < textmapsize && !TextmapIsDelimiter(s[pos]) && !TextmapIsCommentStart(pos))
+			pos++;
+	}
+
+	tkn->str = s + start;
+	tkn->len = pos - start;
+	textmappos = pos;
+	return true;
+}
+
+// Out of range argument numbers are clamped to one no element has.
+static UINT8 TextmapArgNum(const char *s)
+{
+	long argnum = atol(s);
+	if (argnum < 0 || argnum > UINT8_MAX)
+		argnum = UINT8_MAX;
+	return (UINT8)argnum;
+}
+
+static textmapkey_t TextmapGetKey(const textmaptoken_t *tkn, UINT8 *argnum)
+{
+	const char *s = tkn->str;
+	size_t len = tkn->len;
+	textmapkey_t key;
+
+	// argN and stringargN carry their index in the name.
+	if (len > 9 && !memcmp(s, "stringarg", 9))
+	{
+		*argnum = TextmapArgNum(s + 9);
+		return TMK_STRINGARG;
+	}
+	if (len > 3 && !memcmp(s, "arg", 3))
+	{
+		*argnum = TextmapArgNum(s + 3);
+		return TMK_ARG;
+	}
+
+	if (len > UINT8_MAX)
+		return TMK_UNKNOWN;
+
+	key = textmapkeyhash[TextmapKeySlot(s, len, textmapkeyseed)];
+	if (key != TMK_UNKNOWN && textmapkeylen[key] == len && !memcmp(textmapkeynames[key], s, len))
+		return key;
+
+	return TMK_UNKNOWN;
+}
+
+static void TextmapAddField(textmapkey_t key, UINT8 argnum, const textmaptoken_t *val)
+{
+	textmapfield_t *field;
+
+	if (numtextmapfields >= maxtextmapfields)
+	{
+		maxtextmapfields = maxtextmapfields ? maxtextmapfields * 2 : 1024;
+		textmapfields = Z_Realloc(textmapfields, maxtextmapfields * sizeof(*textmapfields), PU_STATIC, NULL);
+	}
+
+	field = &textmapfields[numtextmapfields++];
+	field->key = (UINT8)key;
+	field->argnum = argnum;
+	field->val = val->str;
+	field->len = (UINT32)val->len;
+}
+
+static textmapblock_t *TextmapAddBlock(textmapblocktype_t type)
+{
+	textmapblock_t *block;
+
+	if (numtextmapblocks >= maxtextmapblocks)
+	{
+		maxtextmapblocks = maxtextmapblocks ? maxtextmapblocks * 2 : 256;
+		textmapblocks = Z_Realloc(textmapblocks, maxtextmapblocks * sizeof(*textmapblocks), PU_STATIC, NULL);
+	}
+
+	block = &textmapblocks[numtextmapblocks++];
+	block->type = (UINT8)type;
+	block->firstfield = numtextmapfields;
+	block->numfields = 0;
+	return block;
+}
+
+static void TextmapClose(void)
+{
+	Z_Free(textmapfields);
+	Z_Free(textmapblocks);
+	textmapfields = NULL;
+	textmapblocks = NULL;
+	numtextmapfields = maxtextmapfields = 0;
+	numtextmapblocks = maxtextmapblocks = 0;
+	textmapdata = NULL;
+	textmapsize = textmappos = 0;
+}
+
+// Reads the fields of one {}-encapsulated element.
+static boolean TextmapReadBlock(textmapblock_t *block)
+{
+	textmaptoken_t tkn, val;
+	UINT8 argnum;
+	textmapkey_t key;
+
+	while (true)
+	{
+		if (!TextmapReadToken(&tkn))
+			return false;
+		if (TextmapTokenIs(&tkn, "}"))
+			return true;
+		if (!TextmapReadToken(&val))
+			return false;
+
+		argnum = 0;
+		key = TextmapGetKey(&tkn, &argnum);
+		if (key == TMK_UNKNOWN)
+			continue;
+
+		TextmapAddField(key, argnum, &val);
+		block->numfields++;
+	}
+}
+
+// Skips a bracketed block, starting past its opening bracket.
+static boolean TextmapSkipBlock(void)
+{
+	textmaptoken_t tkn;
+	UINT32 brackets = 1;
+
+	while (brackets && TextmapReadToken(&tkn))
+	{
+		if (TextmapTokenIs(&tkn, "{"))
+			brackets++;
+		else if (TextmapTokenIs(&tkn, "}"))
+			brackets--;
+	}
+
+	return !brackets;
+}
+
+// Tokenizes the whole TEXTMAP, recording every element and its fields,
+// and determines the total amount of map data in it.
+static boolean TextmapTokenize(const UINT8 *data, size_t size)
+{
+	textmaptoken_t tkn;
+
+	if (!textmapkeysready)
+		TextmapInitKeys();
+
+	textmapdata = (const char *)data;
+	textmapsize = size;
+	textmappos = 0;
+	numtextmapfields = numtextmapblocks = 0;
 
 	nummapthings = 0;
 	numlines = 0;
@@ -1555,66 +2148,141 @@ static boolean TextmapCount(size_t size)
 	numsectors = 0;
 
 	// Look for namespace at the beginning.
-	if (!fastcmp(tkn, "namespace"))
+	if (!TextmapReadToken(&tkn) || !TextmapTokenIs(&tkn, "namespace"))
 	{
 		CONS_Alert(CONS_ERROR, "No namespace at beginning of lump!\n");
 		return false;
 	}
 
 	// Check if namespace is valid.
-	tkn = M_TokenizerRead(0);
-	if (!fastcmp(tkn, "srb2"))
-		CONS_Alert(CONS_WARNING, "Invalid namespace '%s', only 'srb2' is supported.\n", tkn);
+	if (!TextmapReadToken(&tkn))
+		tkn.len = 0;
+	if (!TextmapTokenIs(&tkn, "srb2"))
+		CONS_Alert(CONS_WARNING, "Invalid namespace '%.*s', only 'srb2' is supported.\n", (int)tkn.len, tkn.str);
 
-	while ((tkn = M_TokenizerRead(0)) && M_TokenizerGetEndPos() < size)
+	while (TextmapReadToken(&tkn))
 	{
+		textmapblocktype_t type;
+		textmapblock_t *block;
+
 		// Avoid anything inside bracketed stuff, only look for external keywords.
-		if (brackets)
+		if (TextmapTokenIs(&tkn, "{"))
 		{
-			if (fastcmp(tkn, "}"))
-				brackets--;
+			if (!TextmapSkipBlock())
+			{
+				CONS_Alert(CONS_ERROR, "Unclosed brackets detected in textmap lump.\n");
+				return false;
+			}
+			continue;
 		}
-		else if (fastcmp(tkn, "{"))
-			brackets++;
 		// Check for valid fields.
-		else if (fastcmp(tkn, "thing"))
-			mapthingsPos[nummapthings++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "linedef"))
-			linesPos[numlines++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "sidedef"))
-			sidesPos[numsides++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "vertex"))
-			vertexesPos[numvertexes++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "sector"))
-			sectorsPos[numsectors++] = M_TokenizerGetEndPos();
+		else if (TextmapTokenIs(&tkn, "thing"))
+			type = TMB_THING;
+		else if (TextmapTokenIs(&tkn, "linedef"))
+			type = TMB_LINEDEF;
+		else if (TextmapTokenIs(&tkn, "sidedef"))
+			type = TMB_SIDEDEF;
+		else if (TextmapTokenIs(&tkn, "vertex"))
+			type = TMB_VERTEX;
+		else if (TextmapTokenIs(&tkn, "sector"))
+			type = TMB_SECTOR;
 		else
-			CONS_Alert(CONS_NOTICE, "Unknown field '%s'.\n", tkn);
-	}
+		{
+			CONS_Alert(CONS_NOTICE, "Unknown field '%.*s'.\n", (int)tkn.len, tkn.str);
+			continue;
+		}
 
-	if (brackets)
-	{
-		CONS_Alert(CONS_ERROR, "Unclosed brackets detected in textmap lump.\n");
-		return false;
+		if (!TextmapReadToken(&tkn))
+			break;
+		if (!TextmapTokenIs(&tkn, "{"))
+		{
+			CONS_Alert(CONS_WARNING, "Invalid UDMF data capsule!\n");
+			continue;
+		}
+
+		switch (type)
+		{
+			case TMB_THING:   nummapthings++; break;
+			case TMB_LINEDEF: numlines++;     break;
+			case TMB_SIDEDEF: numsides++;     break;
+			case TMB_VERTEX:  numvertexes++;  break;
+			case TMB_SECTOR:  numsectors++;   break;
+			default: break;
+		}
+
+		block = TextmapAddBlock(type);
+		if (!TextmapReadBlock(block))
+		{
+			CONS_Alert(CONS_ERROR, "Unclosed brackets detected in textmap lump.\n");
+			return false;
+		}
 	}
 
 	return true;
 }
 
-static void ParseTextmapVertexParameter(UINT32 i, const char *param, const char *val)
+static inline boolean TextmapValueIs(const textmapfield_t *field, const char *str)
+{
+	return (field->len == strlen(str) && !memcmp(field->val, str, field->len));
+}
+
+#define TextmapTrue(field) TextmapValueIs(field, "true")
+
+// Copies a value into a NUL-terminated buffer, truncating if needed.
+static const char *TextmapValueString(const textmapfield_t *field, char *buf, size_t bufsize)
+{
+	size_t len = min((size_t)field->len, bufsize - 1);
+	M_Memcpy(buf, field->val, len);
+	buf[len] = '\0';
+	return buf;
+}
+
+static char *TextmapValueZString(const textmapfield_t *field)
 {
-	if (fastcmp(param, "x"))
-		vertexes[i].x = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "y"))
-		vertexes[i].y = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "zfloor"))
+	char *str = Z_Malloc(field->len + 1, PU_LEVEL, NULL);
+	M_Memcpy(str, field->val, field->len);
+	str[field->len] = '\0';
+	return str;
+}
+
+static void TextmapAddMoreIDs(taglist_t *tags, const textmapfield_t *field)
+{
+	const char *id = field->val;
+	const char *end = field->val + field->len;
+
+	while (true)
 	{
-		vertexes[i].floorz = FLOAT_TO_FIXED(atof(val));
-		vertexes[i].floorzset = true;
+		Tag_Add(tags, atol(id));
+		while (id < end && *id != ' ')
+			id++;
+		if (id >= end)
+			break;
+		id++;
 	}
-	else if (fastcmp(param, "zceiling"))
+}
+
+static void ParseTextmapVertexParameter(UINT32 i, const textmapfield_t *field)
+{
+	const char *val = field->val;
+
+	switch (field->key)
 	{
-		vertexes[i].ceilingz = FLOAT_TO_FIXED(atof(val));
-		vertexes[i].ceilingzset = true;
+		case TMK_X:
+			vertexes[i].x = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_Y:
+			vertexes[i].y = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_ZFLOOR:
+			vertexes[i].floorz = FLOAT_TO_FIXED(atof(val));
+			vertexes[i].floorzset = true;
+			break;
+		case TMK_ZCEILING:
+			vertexes[i].ceilingz = FLOAT_TO_FIXED(atof(val));
+			vertexes[i].ceilingzset = true;
+			break;
+		default:
+			break;
 	}
 }
 
@@ -1647,439 +2315,452 @@ typedef struct textmap_plane_s {
 textmap_plane_t textmap_planefloor = {0, 0, 0, 0, 0};
 textmap_plane_t textmap_planeceiling = {0, 0, 0, 0, 0};
 
-static void ParseTextmapSectorParameter(UINT32 i, const char *param, const char *val)
-{
-	if (fastcmp(param, "heightfloor"))
-		sectors[i].floorheight = atol(val) << FRACBITS;
-	else if (fastcmp(param, "heightceiling"))
-		sectors[i].ceilingheight = atol(val) << FRACBITS;
-	if (fastcmp(param, "texturefloor"))
-		sectors[i].floorpic = P_AddLevelFlat(val, foundflats);
-	else if (fastcmp(param, "textureceiling"))
-		sectors[i].ceilingpic = P_AddLevelFlat(val, foundflats);
-	else if (fastcmp(param, "lightlevel"))
-		sectors[i].lightlevel = atol(val);
-	else if (fastcmp(param, "lightfloor"))
-		sectors[i].floorlightlevel = atol(val);
-	else if (fastcmp(param, "lightfloorabsolute") && fastcmp("true", val))
-		sectors[i].floorlightabsolute = true;
-	else if (fastcmp(param, "lightceiling"))
-		sectors[i].ceilinglightlevel = atol(val);
-	else if (fastcmp(param, "lightceilingabsolute") && fastcmp("true", val))
-		sectors[i].ceilinglightabsolute = true;
-	else if (fastcmp(param, "id"))
-		Tag_FSet(&sectors[i].tags, atol(val));
-	else if (fastcmp(param, "moreids"))
-	{
-		const char* id = val;
-		while (id)
-		{
-			Tag_Add(&sectors[i].tags, atol(id));
-			if ((id = strchr(id, ' ')))
-				id++;
-		}
-	}	
-	else if (fastcmp(param, "xpanningfloor"))
-		sectors[i].floorxoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "ypanningfloor"))
-		sectors[i].flooryoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "xpanningceiling"))
-		sectors[i].ceilingxoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "ypanningceiling"))
-		sectors[i].ceilingyoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "rotationfloor"))
-		sectors[i].floorangle = FixedAngle(FLOAT_TO_FIXED(atof(val)));
-	else if (fastcmp(param, "rotationceiling"))
-		sectors[i].ceilingangle = FixedAngle(FLOAT_TO_FIXED(atof(val)));
-	else if (fastcmp(param, "floorplane_a"))
-	{
-		textmap_planefloor.defined |= PD_A;
-		textmap_planefloor.a = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "floorplane_b"))
-	{
-		textmap_planefloor.defined |= PD_B;
-		textmap_planefloor.b = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "floorplane_c"))
-	{
-		textmap_planefloor.defined |= PD_C;
-		textmap_planefloor.c = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "floorplane_d"))
-	{
-		textmap_planefloor.defined |= PD_D;
-		textmap_planefloor.d = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_a"))
-	{
-		textmap_planeceiling.defined |= PD_A;
-		textmap_planeceiling.a = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_b"))
-	{
-		textmap_planeceiling.defined |= PD_B;
-		textmap_planeceiling.b = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_c"))
-	{
-		textmap_planeceiling.defined |= PD_C;
-		textmap_planeceiling.c = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_d"))
-	{
-		textmap_planeceiling.defined |= PD_D;
-		textmap_planeceiling.d = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "lightcolor"))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.lightcolor = atol(val);
-	}
-	else if (fastcmp(param, "lightalpha"))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.lightalpha = atol(val);
-	}
-	else if (fastcmp(param, "fadecolor"))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.fadecolor = atol(val);
-	}
-	else if (fastcmp(param, "fadealpha"))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.fadealpha = atol(val);
-	}
-	else if (fastcmp(param, "fadestart"))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.fadestart = atol(val);
-	}
-	else if (fastcmp(param, "fadeend"))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.fadeend = atol(val);
-	}
-	else if (fastcmp(param, "colormapfog") && fastcmp("true", val))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.flags |= CMF_FOG;
-	}
-	else if (fastcmp(param, "colormapfadesprites") && fastcmp("true", val))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.flags |= CMF_FADEFULLBRIGHTSPRITES;
-	}
-	else if (fastcmp(param, "colormapprotected") && fastcmp("true", val))
-		sectors[i].colormap_protected = true;
-	else if (fastcmp(param, "flipspecial_nofloor") && fastcmp("true", val))
-		sectors[i].flags &= ~MSF_FLIPSPECIAL_FLOOR;
-	else if (fastcmp(param, "flipspecial_ceiling") && fastcmp("true", val))
-		sectors[i].flags |= MSF_FLIPSPECIAL_CEILING;
-	else if (fastcmp(param, "triggerspecial_touch") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERSPECIAL_TOUCH;
-	else if (fastcmp(param, "triggerspecial_headbump") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERSPECIAL_HEADBUMP;
-	else if (fastcmp(param, "triggerline_plane") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERLINE_PLANE;
-	else if (fastcmp(param, "triggerline_mobj") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERLINE_MOBJ;
-	else if (fastcmp(param, "invertprecip") && fastcmp("true", val))
-		sectors[i].flags |= MSF_INVERTPRECIP;
-	else if (fastcmp(param, "gravityflip") && fastcmp("true", val))
-		sectors[i].flags |= MSF_GRAVITYFLIP;
-	else if (fastcmp(param, "heatwave") && fastcmp("true", val))
-		sectors[i].flags |= MSF_HEATWAVE;
-	else if (fastcmp(param, "noclipcamera") && fastcmp("true", val))
-		sectors[i].flags |= MSF_NOCLIPCAMERA;
-	else if (fastcmp(param, "outerspace") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_OUTERSPACE;
-	else if (fastcmp(param, "doublestepup") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_DOUBLESTEPUP;
-	else if (fastcmp(param, "nostepdown") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_NOSTEPDOWN;
-	else if (fastcmp(param, "speedpad") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_SPEEDPAD;
-	else if (fastcmp(param, "starpostactivator") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_STARPOSTACTIVATOR;
-	else if (fastcmp(param, "exit") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_EXIT;
-	else if (fastcmp(param, "specialstagepit") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_SPECIALSTAGEPIT;
-	else if (fastcmp(param, "returnflag") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_RETURNFLAG;
-	else if (fastcmp(param, "redteambase") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_REDTEAMBASE;
-	else if (fastcmp(param, "blueteambase") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_BLUETEAMBASE;
-	else if (fastcmp(param, "fan") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_FAN;
-	else if (fastcmp(param, "supertransform") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_SUPERTRANSFORM;
-	else if (fastcmp(param, "forcespin") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_FORCESPIN;
-	else if (fastcmp(param, "zoomtubestart") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_ZOOMTUBESTART;
-	else if (fastcmp(param, "zoomtubeend") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_ZOOMTUBEEND;
-	else if (fastcmp(param, "finishline") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_FINISHLINE;
-	else if (fastcmp(param, "ropehang") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_ROPEHANG;
-	else if (fastcmp(param, "jumpflip") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_JUMPFLIP;
-	else if (fastcmp(param, "gravityoverride") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_GRAVITYOVERRIDE;
-	else if (fastcmp(param, "friction"))
-		sectors[i].friction = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "gravity"))
-		sectors[i].gravity = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "damagetype"))
-	{
-		if (fastcmp(val, "Generic"))
-			sectors[i].damagetype = SD_GENERIC;
-		if (fastcmp(val, "Water"))
-			sectors[i].damagetype = SD_WATER;
-		if (fastcmp(val, "Fire"))
-			sectors[i].damagetype = SD_FIRE;
-		if (fastcmp(val, "Lava"))
-			sectors[i].damagetype = SD_LAVA;
-		if (fastcmp(val, "Electric"))
-			sectors[i].damagetype = SD_ELECTRIC;
-		if (fastcmp(val, "Spike"))
-			sectors[i].damagetype = SD_SPIKE;
-		if (fastcmp(val, "DeathPitTilt"))
-			sectors[i].damagetype = SD_DEATHPITTILT;
-		if (fastcmp(val, "DeathPitNoTilt"))
-			sectors[i].damagetype = SD_DEATHPITNOTILT;
-		if (fastcmp(val, "Instakill"))
-			sectors[i].damagetype = SD_INSTAKILL;
-		if (fastcmp(val, "SpecialStage"))
-			sectors[i].damagetype = SD_SPECIALSTAGE;
-	}
-	else if (fastcmp(param, "triggertag"))
-		sectors[i].triggertag = atol(val);
-	else if (fastcmp(param, "triggerer"))
-	{
-		if (fastcmp(val, "Player"))
-			sectors[i].triggerer = TO_PLAYER;
-		if (fastcmp(val, "AllPlayers"))
-			sectors[i].triggerer = TO_ALLPLAYERS;
-		if (fastcmp(val, "Mobj"))
-			sectors[i].triggerer = TO_MOBJ;
-	}
-}
-
-static void ParseTextmapSidedefParameter(UINT32 i, const char *param, const char *val)
-{
-	if (fastcmp(param, "offsetx"))
-		sides[i].textureoffset = atol(val)<<FRACBITS;
-	else if (fastcmp(param, "offsety"))
-		sides[i].rowoffset = atol(val)<<FRACBITS;
-	else if (fastcmp(param, "offsetx_top"))
-		sides[i].offsetx_top = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsetx_mid"))
-		sides[i].offsetx_mid = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsetx_bottom"))
-		sides[i].offsetx_bot = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsety_top"))
-		sides[i].offsety_top = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsety_mid"))
-		sides[i].offsety_mid = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsety_bottom"))
-		sides[i].offsety_bot = atol(val) << FRACBITS;
-	else if (fastcmp(param, "texturetop"))
-		sides[i].toptexture = R_TextureNumForName(val);
-	else if (fastcmp(param, "texturebottom"))
-		sides[i].bottomtexture = R_TextureNumForName(val);
-	else if (fastcmp(param, "texturemiddle"))
-		sides[i].midtexture = R_TextureNumForName(val);
-	else if (fastcmp(param, "sector"))
-		P_SetSidedefSector(i, atol(val));
-	else if (fastcmp(param, "repeatcnt"))
-		sides[i].repeatcnt = atol(val);
-}
-
-static void ParseTextmapLinedefParameter(UINT32 i, const char *param, const char *val)
-{
-	if (fastcmp(param, "id"))
-		Tag_FSet(&lines[i].tags, atol(val));
-	else if (fastcmp(param, "moreids"))
-	{
-		const char* id = val;
-		while (id)
-		{
-			Tag_Add(&lines[i].tags, atol(id));
-			if ((id = strchr(id, ' ')))
-				id++;
-		}
-	}
-	else if (fastcmp(param, "special"))
-		lines[i].special = atol(val);
-	else if (fastcmp(param, "v1"))
-		P_SetLinedefV1(i, atol(val));
-	else if (fastcmp(param, "v2"))
-		P_SetLinedefV2(i, atol(val));
-	else if (fastncmp(param, "stringarg", 9) && strlen(param) > 9)
+static void ParseTextmapSectorParameter(UINT32 i, const textmapfield_t *field)
+{
+	const char *val = field->val;
+	char name[9];
+
+	switch (field->key)
 	{
-		size_t argnum = atol(param + 9);
-		if (argnum >= NUMLINESTRINGARGS)
-			return;
-		lines[i].stringargs[argnum] = Z_Malloc(strlen(val) + 1, PU_LEVEL, NULL);
-		M_Memcpy(lines[i].stringargs[argnum], val, strlen(val) + 1);
+		case TMK_HEIGHTFLOOR:
+			sectors[i].floorheight = atol(val) << FRACBITS;
+			break;
+		case TMK_HEIGHTCEILING:
+			sectors[i].ceilingheight = atol(val) << FRACBITS;
+			break;
+		case TMK_TEXTUREFLOOR:
+			sectors[i].floorpic = P_AddLevelFlat(TextmapValueString(field, name, sizeof name), foundflats);
+			break;
+		case TMK_TEXTURECEILING:
+			sectors[i].ceilingpic = P_AddLevelFlat(TextmapValueString(field, name, sizeof name), foundflats);
+			break;
+		case TMK_LIGHTLEVEL:
+			sectors[i].lightlevel = atol(val);
+			break;
+		case TMK_LIGHTFLOOR:
+			sectors[i].floorlightlevel = atol(val);
+			break;
+		case TMK_LIGHTFLOORABSOLUTE:
+			if (TextmapTrue(field))
+				sectors[i].floorlightabsolute = true;
+			break;
+		case TMK_LIGHTCEILING:
+			sectors[i].ceilinglightlevel = atol(val);
+			break;
+		case TMK_LIGHTCEILINGABSOLUTE:
+			if (TextmapTrue(field))
+				sectors[i].ceilinglightabsolute = true;
+			break;
+		case TMK_ID:
+			Tag_FSet(&sectors[i].tags, atol(val));
+			break;
+		case TMK_MOREIDS:
+			TextmapAddMoreIDs(&sectors[i].tags, field);
+			break;
+		case TMK_XPANNINGFLOOR:
+			sectors[i].floorxoffset = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_YPANNINGFLOOR:
+			sectors[i].flooryoffset = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_XPANNINGCEILING:
+			sectors[i].ceilingxoffset = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_YPANNINGCEILING:
+			sectors[i].ceilingyoffset = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_ROTATIONFLOOR:
+			sectors[i].floorangle = FixedAngle(FLOAT_TO_FIXED(atof(val)));
+			break;
+		case TMK_ROTATIONCEILING:
+			sectors[i].ceilingangle = FixedAngle(FLOAT_TO_FIXED(atof(val)));
+			break;
+		case TMK_FLOORPLANE_A:
+			textmap_planefloor.defined |= PD_A;
+			textmap_planefloor.a = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_FLOORPLANE_B:
+			textmap_planefloor.defined |= PD_B;
+			textmap_planefloor.b = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_FLOORPLANE_C:
+			textmap_planefloor.defined |= PD_C;
+			textmap_planefloor.c = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_FLOORPLANE_D:
+			textmap_planefloor.defined |= PD_D;
+			textmap_planefloor.d = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_CEILINGPLANE_A:
+			textmap_planeceiling.defined |= PD_A;
+			textmap_planeceiling.a = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_CEILINGPLANE_B:
+			textmap_planeceiling.defined |= PD_B;
+			textmap_planeceiling.b = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_CEILINGPLANE_C:
+			textmap_planeceiling.defined |= PD_C;
+			textmap_planeceiling.c = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_CEILINGPLANE_D:
+			textmap_planeceiling.defined |= PD_D;
+			textmap_planeceiling.d = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_LIGHTCOLOR:
+			textmap_colormap.used = true;
+			textmap_colormap.lightcolor = atol(val);
+			break;
+		case TMK_LIGHTALPHA:
+			textmap_colormap.used = true;
+			textmap_colormap.lightalpha = atol(val);
+			break;
+		case TMK_FADECOLOR:
+			textmap_colormap.used = true;
+			textmap_colormap.fadecolor = atol(val);
+			break;
+		case TMK_FADEALPHA:
+			textmap_colormap.used = true;
+			textmap_colormap.fadealpha = atol(val);
+			break;
+		case TMK_FADESTART:
+			textmap_colormap.used = true;
+			textmap_colormap.fadestart = atol(val);
+			break;
+		case TMK_FADEEND:
+			textmap_colormap.used = true;
+			textmap_colormap.fadeend = atol(val);
+			break;
+		case TMK_COLORMAPFOG:
+			if (TextmapTrue(field))
+			{
+				textmap_colormap.used = true;
+				textmap_colormap.flags |= CMF_FOG;
+			}
+			break;
+		case TMK_COLORMAPFADESPRITES:
+			if (TextmapTrue(field))
+			{
+				textmap_colormap.used = true;
+				textmap_colormap.flags |= CMF_FADEFULLBRIGHTSPRITES;
+			}
+			break;
+		case TMK_COLORMAPPROTECTED:
+			if (TextmapTrue(field))
+				sectors[i].colormap_protected = true;
+			break;
+		case TMK_FLIPSPECIAL_NOFLOOR:
+			if (TextmapTrue(field))
+				sectors[i].flags &= ~MSF_FLIPSPECIAL_FLOOR;
+			break;
+
+#define SECTORFLAG(key, field_, flag) \
+		case key: \
+			if (TextmapTrue(field)) \
+				sectors[i].field_ |= flag; \
+			break;
+
+		SECTORFLAG(TMK_FLIPSPECIAL_CEILING, flags, MSF_FLIPSPECIAL_CEILING)
+		SECTORFLAG(TMK_TRIGGERSPECIAL_TOUCH, flags, MSF_TRIGGERSPECIAL_TOUCH)
+		SECTORFLAG(TMK_TRIGGERSPECIAL_HEADBUMP, flags, MSF_TRIGGERSPECIAL_HEADBUMP)
+		SECTORFLAG(TMK_TRIGGERLINE_PLANE, flags, MSF_TRIGGERLINE_PLANE)
+		SECTORFLAG(TMK_TRIGGERLINE_MOBJ, flags, MSF_TRIGGERLINE_MOBJ)
+		SECTORFLAG(TMK_INVERTPRECIP, flags, MSF_INVERTPRECIP)
+		SECTORFLAG(TMK_GRAVITYFLIP, flags, MSF_GRAVITYFLIP)
+		SECTORFLAG(TMK_HEATWAVE, flags, MSF_HEATWAVE)
+		SECTORFLAG(TMK_NOCLIPCAMERA, flags, MSF_NOCLIPCAMERA)
+		SECTORFLAG(TMK_OUTERSPACE, specialflags, SSF_OUTERSPACE)
+		SECTORFLAG(TMK_DOUBLESTEPUP, specialflags, SSF_DOUBLESTEPUP)
+		SECTORFLAG(TMK_NOSTEPDOWN, specialflags, SSF_NOSTEPDOWN)
+		SECTORFLAG(TMK_SPEEDPAD, specialflags, SSF_SPEEDPAD)
+		SECTORFLAG(TMK_STARPOSTACTIVATOR, specialflags, SSF_STARPOSTACTIVATOR)
+		SECTORFLAG(TMK_EXIT, specialflags, SSF_EXIT)
+		SECTORFLAG(TMK_SPECIALSTAGEPIT, specialflags, SSF_SPECIALSTAGEPIT)
+		SECTORFLAG(TMK_RETURNFLAG, specialflags, SSF_RETURNFLAG)
+		SECTORFLAG(TMK_REDTEAMBASE, specialflags, SSF_REDTEAMBASE)
+		SECTORFLAG(TMK_BLUETEAMBASE, specialflags, SSF_BLUETEAMBASE)
+		SECTORFLAG(TMK_FAN, specialflags, SSF_FAN)
+		SECTORFLAG(TMK_SUPERTRANSFORM, specialflags, SSF_SUPERTRANSFORM)
+		SECTORFLAG(TMK_FORCESPIN, specialflags, SSF_FORCESPIN)
+		SECTORFLAG(TMK_ZOOMTUBESTART, specialflags, SSF_ZOOMTUBESTART)
+		SECTORFLAG(TMK_ZOOMTUBEEND, specialflags, SSF_ZOOMTUBEEND)
+		SECTORFLAG(TMK_FINISHLINE, specialflags, SSF_FINISHLINE)
+		SECTORFLAG(TMK_ROPEHANG, specialflags, SSF_ROPEHANG)
+		SECTORFLAG(TMK_JUMPFLIP, specialflags, SSF_JUMPFLIP)
+		SECTORFLAG(TMK_GRAVITYOVERRIDE, specialflags, SSF_GRAVITYOVERRIDE)
+
+#undef SECTORFLAG
+
+		case TMK_FRICTION:
+			sectors[i].friction = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_GRAVITY:
+			sectors[i].gravity = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_DAMAGETYPE:
+			if (TextmapValueIs(field, "Generic"))
+				sectors[i].damagetype = SD_GENERIC;
+			else if (TextmapValueIs(field, "Water"))
+				sectors[i].damagetype = SD_WATER;
+			else if (TextmapValueIs(field, "Fire"))
+				sectors[i].damagetype = SD_FIRE;
+			else if (TextmapValueIs(field, "Lava"))
+				sectors[i].damagetype = SD_LAVA;
+			else if (TextmapValueIs(field, "Electric"))
+				sectors[i].damagetype = SD_ELECTRIC;
+			else if (TextmapValueIs(field, "Spike"))
+				sectors[i].damagetype = SD_SPIKE;
+			else if (TextmapValueIs(field, "DeathPitTilt"))
+				sectors[i].damagetype = SD_DEATHPITTILT;
+			else if (TextmapValueIs(field, "DeathPitNoTilt"))
+				sectors[i].damagetype = SD_DEATHPITNOTILT;
+			else if (TextmapValueIs(field, "Instakill"))
+				sectors[i].damagetype = SD_INSTAKILL;
+			else if (TextmapValueIs(field, "SpecialStage"))
+				sectors[i].damagetype = SD_SPECIALSTAGE;
+			break;
+		case TMK_TRIGGERTAG:
+			sectors[i].triggertag = atol(val);
+			break;
+		case TMK_TRIGGERER:
+			if (TextmapValueIs(field, "Player"))
+				sectors[i].triggerer = TO_PLAYER;
+			else if (TextmapValueIs(field, "AllPlayers"))
+				sectors[i].triggerer = TO_ALLPLAYERS;
+			else if (TextmapValueIs(field, "Mobj"))
+				sectors[i].triggerer = TO_MOBJ;
+			break;
+		default:
+			break;
 	}
-	else if (fastncmp(param, "arg", 3) && strlen(param) > 3)
+}
+
+static void ParseTextmapSidedefParameter(UINT32 i, const textmapfield_t *field)
+{
+	const char *val = field->val;
+	char name[9];
+
+	switch (field->key)
 	{
-		size_t argnum = atol(param + 3);
-		if (argnum >= NUMLINEARGS)
-			return;
-		lines[i].args[argnum] = atol(val);
-	}
-	else if (fastcmp(param, "sidefront"))
-		lines[i].sidenum[0] = atol(val);
-	else if (fastcmp(param, "sideback"))
-		lines[i].sidenum[1] = atol(val);
-	else if (fastcmp(param, "alpha"))
-		lines[i].alpha = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "blendmode") || fastcmp(param, "renderstyle"))
-	{
-		if (fastcmp(val, "translucent"))
-			lines[i].blendmode = AST_COPY;
-		else if (fastcmp(val, "add"))
-			lines[i].blendmode = AST_ADD;
-		else if (fastcmp(val, "subtract"))
-			lines[i].blendmode = AST_SUBTRACT;
-		else if (fastcmp(val, "reversesubtract"))
-			lines[i].blendmode = AST_REVERSESUBTRACT;
-		else if (fastcmp(val, "modulate"))
-			lines[i].blendmode = AST_MODULATE;
-		if (fastcmp(val, "fog"))
-			lines[i].blendmode = AST_FOG;
-	}
-	else if (fastcmp(param, "executordelay"))
-		lines[i].executordelay = atol(val);
-
-	// Flags
-	else if (fastcmp(param, "blocking") && fastcmp("true", val))
-		lines[i].flags |= ML_IMPASSIBLE;
-	else if (fastcmp(param, "blockmonsters") && fastcmp("true", val))
-		lines[i].flags |= ML_BLOCKMONSTERS;
-	else if (fastcmp(param, "twosided") && fastcmp("true", val))
-		lines[i].flags |= ML_TWOSIDED;
-	else if (fastcmp(param, "dontpegtop") && fastcmp("true", val))
-		lines[i].flags |= ML_DONTPEGTOP;
-	else if (fastcmp(param, "dontpegbottom") && fastcmp("true", val))
-		lines[i].flags |= ML_DONTPEGBOTTOM;
-	else if (fastcmp(param, "skewtd") && fastcmp("true", val))
-		lines[i].flags |= ML_SKEWTD;
-	else if (fastcmp(param, "noclimb") && fastcmp("true", val))
-		lines[i].flags |= ML_NOCLIMB;
-	else if (fastcmp(param, "noskew") && fastcmp("true", val))
-		lines[i].flags |= ML_NOSKEW;
-	else if (fastcmp(param, "midpeg") && fastcmp("true", val))
-		lines[i].flags |= ML_MIDPEG;
-	else if (fastcmp(param, "midsolid") && fastcmp("true", val))
-		lines[i].flags |= ML_MIDSOLID;
-	else if (fastcmp(param, "wrapmidtex") && fastcmp("true", val))
-		lines[i].flags |= ML_WRAPMIDTEX;
-	/*else if (fastcmp(param, "effect6") && fastcmp("true", val))
-		lines[i].flags |= ML_EFFECT6;*/
-	else if (fastcmp(param, "nonet") && fastcmp("true", val))
-		lines[i].flags |= ML_NONET;
-	else if (fastcmp(param, "netonly") && fastcmp("true", val))
-		lines[i].flags |= ML_NETONLY;
-	else if (fastcmp(param, "bouncy") && fastcmp("true", val))
-		lines[i].flags |= ML_BOUNCY;
-	else if (fastcmp(param, "transfer") && fastcmp("true", val))
-		lines[i].flags |= ML_TFERLINE;
-}
-
-static void ParseTextmapThingParameter(UINT32 i, const char *param, const char *val)
-{
-	if (fastcmp(param, "id"))
-		Tag_FSet(&mapthings[i].tags, atol(val));
-	else if (fastcmp(param, "moreids"))
-	{
-		const char* id = val;
-		while (id)
-		{
-			Tag_Add(&mapthings[i].tags, atol(id));
-			if ((id = strchr(id, ' ')))
-				id++;
-		}
+		case TMK_OFFSETX:
+			sides[i].textureoffset = atol(val)<<FRACBITS;
+			break;
+		case TMK_OFFSETY:
+			sides[i].rowoffset = atol(val)<<FRACBITS;
+			break;
+		case TMK_OFFSETX_TOP:
+			sides[i].offsetx_top = atol(val) << FRACBITS;
+			break;
+		case TMK_OFFSETX_MID:
+			sides[i].offsetx_mid = atol(val) << FRACBITS;
+			break;
+		case TMK_OFFSETX_BOTTOM:
+			sides[i].offsetx_bot = atol(val) << FRACBITS;
+			break;
+		case TMK_OFFSETY_TOP:
+			sides[i].offsety_top = atol(val) << FRACBITS;
+			break;
+		case TMK_OFFSETY_MID:
+			sides[i].offsety_mid = atol(val) << FRACBITS;
+			break;
+		case TMK_OFFSETY_BOTTOM:
+			sides[i].offsety_bot = atol(val) << FRACBITS;
+			break;
+		case TMK_TEXTURETOP:
+			sides[i].toptexture = R_TextureNumForName(TextmapValueString(field, name, sizeof name));
+			break;
+		case TMK_TEXTUREBOTTOM:
+			sides[i].bottomtexture = R_TextureNumForName(TextmapValueString(field, name, sizeof name));
+			break;
+		case TMK_TEXTUREMIDDLE:
+			sides[i].midtexture = R_TextureNumForName(TextmapValueString(field, name, sizeof name));
+			break;
+		case TMK_SECTOR:
+			P_SetSidedefSector(i, atol(val));
+			break;
+		case TMK_REPEATCNT:
+			sides[i].repeatcnt = atol(val);
+			break;
+		default:
+			break;
 	}
-	else if (fastcmp(param, "x"))
-		mapthings[i].x = atol(val);
-	else if (fastcmp(param, "y"))
-		mapthings[i].y = atol(val);
-	else if (fastcmp(param, "height"))
-		mapthings[i].z = atol(val);
-	else if (fastcmp(param, "angle"))
-		mapthings[i].angle = atol(val);
-	else if (fastcmp(param, "pitch"))
-		mapthings[i].pitch = atol(val);
-	else if (fastcmp(param, "roll"))
-		mapthings[i].roll = atol(val);
-	else if (fastcmp(param, "type"))
-		mapthings[i].type = atol(val);
-	else if (fastcmp(param, "scale"))
-		mapthings[i].spritexscale = mapthings[i].spriteyscale = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "scalex"))
-		mapthings[i].spritexscale = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "scaley"))
-		mapthings[i].spriteyscale = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "mobjscale"))
-		mapthings[i].scale = FLOAT_TO_FIXED(atof(val));
-	// Flags
-	else if (fastcmp(param, "flip") && fastcmp("true", val))
-		mapthings[i].options |= MTF_OBJECTFLIP;
-	else if (fastcmp(param, "absolutez") && fastcmp("true", val))
-		mapthings[i].options |= MTF_ABSOLUTEZ;
-
-	else if (fastncmp(param, "stringarg", 9) && strlen(param) > 9)
-	{
-		size_t argnum = atol(param + 9);
-		if (argnum >= NUMMAPTHINGSTRINGARGS)
-			return;
-		mapthings[i].stringargs[argnum] = Z_Malloc(strlen(val) + 1, PU_LEVEL, NULL);
-		M_Memcpy(mapthings[i].stringargs[argnum], val, strlen(val) + 1);
+}
+
+static void ParseTextmapLinedefParameter(UINT32 i, const textmapfield_t *field)
+{
+	const char *val = field->val;
+
+	switch (field->key)
+	{
+		case TMK_ID:
+			Tag_FSet(&lines[i].tags, atol(val));
+			break;
+		case TMK_MOREIDS:
+			TextmapAddMoreIDs(&lines[i].tags, field);
+			break;
+		case TMK_SPECIAL:
+			lines[i].special = atol(val);
+			break;
+		case TMK_V1:
+			P_SetLinedefV1(i, atol(val));
+			break;
+		case TMK_V2:
+			P_SetLinedefV2(i, atol(val));
+			break;
+		case TMK_STRINGARG:
+			if (field->argnum < NUMLINESTRINGARGS)
+				lines[i].stringargs[field->argnum] = TextmapValueZString(field);
+			break;
+		case TMK_ARG:
+			if (field->argnum < NUMLINEARGS)
+				lines[i].args[field->argnum] = atol(val);
+			break;
+		case TMK_SIDEFRONT:
+			lines[i].sidenum[0] = atol(val);
+			break;
+		case TMK_SIDEBACK:
+			lines[i].sidenum[1] = atol(val);
+			break;
+		case TMK_ALPHA:
+			lines[i].alpha = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_BLENDMODE:
+		case TMK_RENDERSTYLE:
+			if (TextmapValueIs(field, "translucent"))
+				lines[i].blendmode = AST_COPY;
+			else if (TextmapValueIs(field, "add"))
+				lines[i].blendmode = AST_ADD;
+			else if (TextmapValueIs(field, "subtract"))
+				lines[i].blendmode = AST_SUBTRACT;
+			else if (TextmapValueIs(field, "reversesubtract"))
+				lines[i].blendmode = AST_REVERSESUBTRACT;
+			else if (TextmapValueIs(field, "modulate"))
+				lines[i].blendmode = AST_MODULATE;
+			else if (TextmapValueIs(field, "fog"))
+				lines[i].blendmode = AST_FOG;
+			break;
+		case TMK_EXECUTORDELAY:
+			lines[i].executordelay = atol(val);
+			break;
+
+		// Flags
+#define LINEFLAG(key, flag) \
+		case key: \
+			if (TextmapTrue(field)) \
+				lines[i].flags |= flag; \
+			break;
+
+		LINEFLAG(TMK_BLOCKING, ML_IMPASSIBLE)
+		LINEFLAG(TMK_BLOCKMONSTERS, ML_BLOCKMONSTERS)
+		LINEFLAG(TMK_TWOSIDED, ML_TWOSIDED)
+		LINEFLAG(TMK_DONTPEGTOP, ML_DONTPEGTOP)
+		LINEFLAG(TMK_DONTPEGBOTTOM, ML_DONTPEGBOTTOM)
+		LINEFLAG(TMK_SKEWTD, ML_SKEWTD)
+		LINEFLAG(TMK_NOCLIMB, ML_NOCLIMB)
+		LINEFLAG(TMK_NOSKEW, ML_NOSKEW)
+		LINEFLAG(TMK_MIDPEG, ML_MIDPEG)
+		LINEFLAG(TMK_MIDSOLID, ML_MIDSOLID)
+		LINEFLAG(TMK_WRAPMIDTEX, ML_WRAPMIDTEX)
+		LINEFLAG(TMK_NONET, ML_NONET)
+		LINEFLAG(TMK_NETONLY, ML_NETONLY)
+		LINEFLAG(TMK_BOUNCY, ML_BOUNCY)
+		LINEFLAG(TMK_TRANSFER, ML_TFERLINE)
+
+#undef LINEFLAG
+
+		default:
+			break;
 	}
-	else if (fastncmp(param, "arg", 3) && strlen(param) > 3)
+}
+
+static void ParseTextmapThingParameter(UINT32 i, const textmapfield_t *field)
+{
+	const char *val = field->val;
+
+	switch (field->key)
 	{
-		size_t argnum = atol(param + 3);
-		if (argnum >= NUMMAPTHINGARGS)
-			return;
-		mapthings[i].args[argnum] = atol(val);
+		case TMK_ID:
+			Tag_FSet(&mapthings[i].tags, atol(val));
+			break;
+		case TMK_MOREIDS:
+			TextmapAddMoreIDs(&mapthings[i].tags, field);
+			break;
+		case TMK_X:
+			mapthings[i].x = atol(val);
+			break;
+		case TMK_Y:
+			mapthings[i].y = atol(val);
+			break;
+		case TMK_HEIGHT:
+			mapthings[i].z = atol(val);
+			break;
+		case TMK_ANGLE:
+			mapthings[i].angle = atol(val);
+			break;
+		case TMK_PITCH:
+			mapthings[i].pitch = atol(val);
+			break;
+		case TMK_ROLL:
+			mapthings[i].roll = atol(val);
+			break;
+		case TMK_TYPE:
+			mapthings[i].type = atol(val);
+			break;
+		case TMK_SCALE:
+			mapthings[i].spritexscale = mapthings[i].spriteyscale = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_SCALEX:
+			mapthings[i].spritexscale = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_SCALEY:
+			mapthings[i].spriteyscale = FLOAT_TO_FIXED(atof(val));
+			break;
+		case TMK_MOBJSCALE:
+			mapthings[i].scale = FLOAT_TO_FIXED(atof(val));
+			break;
+		// Flags
+		case TMK_FLIP:
+			if (TextmapTrue(field))
+				mapthings[i].options |= MTF_OBJECTFLIP;
+			break;
+		case TMK_ABSOLUTEZ:
+			if (TextmapTrue(field))
+				mapthings[i].options |= MTF_ABSOLUTEZ;
+			break;
+
+		case TMK_STRINGARG:
+			if (field->argnum < NUMMAPTHINGSTRINGARGS)
+				mapthings[i].stringargs[field->argnum] = TextmapValueZString(field);
+			break;
+		case TMK_ARG:
+			if (field->argnum < NUMMAPTHINGARGS)
+				mapthings[i].args[field->argnum] = atol(val);
+			break;
+		default:
+			break;
 	}
 }
 
-/** From a given position table, run a specified parser function through a {}-encapsuled text.
+/** Runs a specified parser function through the fields of the next element
+  * of the given type, in the order they appear in the textmap.
   *
-  * \param Position of the data to parse, in the textmap.
+  * \param Element type to look for.
+  * \param Block cursor for that element type, advanced past the element.
   * \param Structure number (mapthings, sectors, ...).
   * \param Parser function pointer.
   */
-static void TextmapParse(UINT32 dataPos, size_t num, void (*parser)(UINT32, const char *, const char *))
+static void TextmapParse(textmapblocktype_t type, UINT32 *cursor, UINT32 num, void (*parser)(UINT32, const textmapfield_t *))
 {
-	const char *param, *val;
+	const textmapblock_t *block;
+	UINT32 j;
 
-	M_TokenizerSetEndPos(dataPos);
-	param = M_TokenizerRead(0);
-	if (!fastcmp(param, "{"))
-	{
-		CONS_Alert(CONS_WARNING, "Invalid UDMF data capsule!\n");
-		return;
-	}
+	while (textmapblocks[*cursor].type != type)
+		(*cursor)++;
 
-	while (true)
-	{
-		param = M_TokenizerRead(0);
-		if (fastcmp(param, "}"))
-			break;
-		val = M_TokenizerRead(1);
-		parser(num, param, val);
-	}
+	block = &textmapblocks[(*cursor)++];
+
+	for (j = 0; j < block->numfields; j++)
+		parser(num, &textmapfields[block->firstfield + j]);
 }
 
 /** Provides a fix to the flat alignment coordinate transform from standard Textmaps.
@@ -2840,7 +3521,7 @@ static void P_WriteTextmap(void)
   */
 static void P_LoadTextmap(void)
 {
-	UINT32 i;
+	UINT32 i, cursor;
 
 	vertex_t   *vt;
 	sector_t   *sc;
@@ -2855,14 +3536,14 @@ static void P_LoadTextmap(void)
 	/// from the textmap, and therefore we have to account for it by
 	/// preemptively setting that value beforehand.
 
-	for (i = 0, vt = vertexes; i < numvertexes; i++, vt++)
+	for (i = 0, cursor = 0, vt = vertexes; i < numvertexes; i++, vt++)
 	{
 		// Defaults.
 		vt->x = vt->y = INT32_MAX;
 		vt->floorzset = vt->ceilingzset = false;
 		vt->floorz = vt->ceilingz = 0;
 
-		TextmapParse(vertexesPos[i], i, ParseTextmapVertexParameter);
+		TextmapParse(TMB_VERTEX, &cursor, i, ParseTextmapVertexParameter);
 
 		if (vt->x == INT32_MAX)
 			I_Error("P_LoadTextmap: vertex %s has no x value set!\n", sizeu1(i));
@@ -2870,7 +3551,7 @@ static void P_LoadTextmap(void)
 			I_Error("P_LoadTextmap: vertex %s has no y value set!\n", sizeu1(i));
 	}
 
-	for (i = 0, sc = sectors; i < numsectors; i++, sc++)
+	for (i = 0, cursor = 0, sc = sectors; i < numsectors; i++, sc++)
 	{
 		// Defaults.
 		sc->floorheight = 0;
@@ -2916,7 +3597,7 @@ static void P_LoadTextmap(void)
 		textmap_planefloor.defined = 0;
 		textmap_planeceiling.defined = 0;
 
-		TextmapParse(sectorsPos[i], i, ParseTextmapSectorParameter);
+		TextmapParse(TMB_SECTOR, &cursor, i, ParseTextmapSectorParameter);
 
 		P_InitializeSector(sc);
 		if (textmap_colormap.used)
@@ -2941,7 +3622,7 @@ static void P_LoadTextmap(void)
 		TextmapFixFlatOffsets(sc);
 	}
 
-	for (i = 0, ld = lines; i < numlines; i++, ld++)
+	for (i = 0, cursor = 0, ld = lines; i < numlines; i++, ld++)
 	{
 		// Defaults.
 		ld->v1 = ld->v2 = NULL;
@@ -2956,7 +3637,7 @@ static void P_LoadTextmap(void)
 		ld->sidenum[0] = 0xffff;
 		ld->sidenum[1] = 0xffff;
 
-		TextmapParse(linesPos[i], i, ParseTextmapLinedefParameter);
+		TextmapParse(TMB_LINEDEF, &cursor, i, ParseTextmapLinedefParameter);
 
 		if (!ld->v1)
 			I_Error("P_LoadTextmap: linedef %s has no v1 value set!\n", sizeu1(i));
@@ -2968,7 +3649,7 @@ static void P_LoadTextmap(void)
 		P_InitializeLinedef(ld);
 	}
 
-	for (i = 0, sd = sides; i < numsides; i++, sd++)
+	for (i = 0, cursor = 0, sd = sides; i < numsides; i++, sd++)
 	{
 		// Defaults.
 		sd->textureoffset = 0;
@@ -2981,7 +3662,7 @@ static void P_LoadTextmap(void)
 		sd->sector = NULL;
 		sd->repeatcnt = 0;
 
-		TextmapParse(sidesPos[i], i, ParseTextmapSidedefParameter);
+		TextmapParse(TMB_SIDEDEF, &cursor, i, ParseTextmapSidedefParameter);
 
 		if (!sd->sector)
 			I_Error("P_LoadTextmap: sidedef %s has no sector value set!\n", sizeu1(i));
@@ -2989,7 +3670,7 @@ static void P_LoadTextmap(void)
 		P_InitializeSidedef(sd);
 	}
 
-	for (i = 0, mt = mapthings; i < nummapthings; i++, mt++)
+	for (i = 0, cursor = 0, mt = mapthings; i < nummapthings; i++, mt++)
 	{
 		// Defaults.
 		mt->x = mt->y = 0;
@@ -3005,7 +3686,7 @@ static void P_LoadTextmap(void)
 		memset(mt->stringargs, 0x00, NUMMAPTHINGSTRINGARGS*sizeof(*mt->stringargs));
 		mt->mobj = NULL;
 
-		TextmapParse(mapthingsPos[i], i, ParseTextmapThingParameter);
+		TextmapParse(TMB_THING, &cursor, i, ParseTextmapThingParameter);
 	}
 }
 
@@ -3089,10 +3770,9 @@ static boolean P_LoadMapData(const virtres_t *virt)
 	if (udmf) // Count how many entries for each type we got in textmap.
 	{
 		virtlump_t *textmap = vres_Find(virt, "TEXTMAP");
-		M_TokenizerOpen((char *)textmap->data);
-		if (!TextmapCount(textmap->size))
+		if (!TextmapTokenize(textmap->data, textmap->size))
 		{
-			M_TokenizerClose();
+			TextmapClose();
 			return false;
 		}
 	}
@@ -3150,7 +3830,7 @@ static boolean P_LoadMapData(const virtres_t *virt)
 	if (udmf)
 	{
 		P_LoadTextmap();
-		M_TokenizerClose();
+		TextmapClose();
 	}
 	else
 	{
@@ -3623,6 +4303,27 @@ static void P_LoadMapBSP(const virtres_t *virt)
 	return;
 }
 
+// Sets the blockmap parameters from the blockmap lump header,
+// and clears out the mobj and polyobject chains.
+static void P_SetupBlockMap(void)
+{
+	size_t count;
+
+	bmaporgx = blockmaplump[0]<<FRACBITS;
+	bmaporgy = blockmaplump[1]<<FRACBITS;
+	bmapwidth = blockmaplump[2];
+	bmapheight = blockmaplump[3];
+
+	// clear out mobj chains
+	count = sizeof (*blocklinks)* bmapwidth*bmapheight;
+	blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+	blockmap = blockmaplump+4;
+
+	// haleyjd 2/22/06: setup polyobject blockmap
+	count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
+	polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+}
+
 // Split from P_LoadBlockMap for convenience
 // -- Monster Iestyn 08/01/18
 static void P_ReadBlockMapLump(INT16 *wadblockmaplump, size_t count)
@@ -3662,19 +4363,37 @@ static boolean P_LoadBlockMap(UINT8 *data, size_t count)
 	count /= 2;
 	P_ReadBlockMapLump((INT16 *)data, count);
 
-	bmaporgx = blockmaplump[0]<<FRACBITS;
-	bmaporgy = blockmaplump[1]<<FRACBITS;
-	bmapwidth = blockmaplump[2];
-	bmapheight = blockmaplump[3];
+	P_SetupBlockMap();
+	return true;
+}
 
-	// clear out mobj chains
-	count = sizeof (*blocklinks)* bmapwidth*bmapheight;
-	blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
-	blockmap = blockmaplump+4;
+// Loads a blockmap previously made by P_CreateBlockMap from the level cache.
+static boolean P_LoadCachedBlockMap(void)
+{
+	size_t length, count, tot, i;
+	INT32 *data = P_ReadLevelCache("blockmap", &length, PU_LEVEL);
 
-	// haleyjd 2/22/06: setup polyobject blockmap
-	count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
-	polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+	if (!data)
+		return false;
+
+	count = length / sizeof (*data);
+	tot = (count >= 4 && data[2] > 0 && data[3] > 0) ? (size_t)data[2] * data[3] : 0;
+
+	// Make sure every block offset points inside the lump.
+	if (!tot || count < tot + 6)
+	{
+		Z_Free(data);
+		return false;
+	}
+	for (i = 4; i < tot + 4; i++)
+		if (data[i] < 0 || (size_t)data[i] >= count)
+		{
+			Z_Free(data);
+			return false;
+		}
+
+	blockmaplump = data;
+	P_SetupBlockMap();
 	return true;
 }
 
@@ -3789,6 +4508,7 @@ static void P_CreateBlockMap(void)
 		} bmap_t; // blocklist structure
 
 		size_t tot = bmapwidth * bmapheight; // size of blockmap
+		size_t count = tot + 6; // we need at least 1 word per block, plus reserved's
 		bmap_t *bmap = calloc(tot, sizeof (*bmap)); // array of blocklists
 		boolean straight;
 
@@ -3883,9 +4603,8 @@ static void P_CreateBlockMap(void)
 		// Compression of empty blocks is performed by reserving two offset words
 		// at tot and tot+1.
 		//
-		// 4 words, unused if this routine is called, are reserved at the start.
+		// 4 words are reserved at the start, for the same header a BLOCKMAP lump has.
 		{
-			size_t count = tot + 6; // we need at least 1 word per block, plus reserved's
 
 			for (i = 0; i < tot; i++)
 				if (bmap[i].n)
@@ -3893,6 +4612,10 @@ static void P_CreateBlockMap(void)
 
 			// Allocate blockmap lump with computed count
 			blockmaplump = Z_Calloc(sizeof (*blockmaplump) * count, PU_LEVEL, NULL);
+			blockmaplump[0] = minx;
+			blockmaplump[1] = miny;
+			blockmaplump[2] = bmapwidth;
+			blockmaplump[3] = bmapheight;
 		}
 
 		// Now compress the blockmap.
@@ -3918,17 +4641,11 @@ static void P_CreateBlockMap(void)
 
 			free(bmap); // Free uncompressed blockmap
 		}
-	}
-	{
-		size_t count = sizeof (*blocklinks) * bmapwidth * bmapheight;
-		// clear out mobj chains (copied from from P_LoadBlockMap)
-		blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
-		blockmap = blockmaplump + 4;
 
-		// haleyjd 2/22/06: setup polyobject blockmap
-		count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
-		polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+		P_WriteLevelCache("blockmap", blockmaplump, sizeof (*blockmaplump) * count);
 	}
+
+	P_SetupBlockMap();
 }
 
 // PK3 version
@@ -3958,7 +4675,8 @@ static void P_LoadMapLUT(const virtres_t *virt)
 	else
 		rejectmatrix = NULL;
 
-	if (!(virtblockmap && P_LoadBlockMap(virtblockmap->data, virtblockmap->size)))
+	if (!(virtblockmap && P_LoadBlockMap(virtblockmap->data, virtblockmap->size))
+		&& !P_LoadCachedBlockMap())
 		P_CreateBlockMap();
 }
 
@@ -6943,6 +7661,8 @@ static boolean P_LoadMapFromFile(void)
 	size_t i;
 	udmf = textmap != NULL;
 
+	P_SetLevelCacheMap(lastloadedmaplumpnum, virt);
+
 	if (!P_LoadMapData(virt))
 		return false;
 	P_LoadMapBSP(virt);
@@ -6973,6 +7693,7 @@ static boolean P_LoadMapFromFile(void)
 
 	P_MakeMapMD5(virt, &mapmd5);
 
+	P_SetLevelCacheMap(lastloadedmaplumpnum, NULL);
 	vres_Free(virt);
 	return true;
 }
@@ -7644,6 +8365,318 @@ static void P_InitGametype(void)
 			: mapheaderinfo[gamemap - 1]->numlaps);
 }
 
+//
+// Warming up the next level while the intermission is up
+//
+
+#define PREFETCHMAXLUMPS 32
+#define PREFETCHTEXTCHUNK 16384 // TEXTMAP bytes to scan between looks at the clock
+#define PREFETCHRECORDCHUNK 512 // Sidedefs or sectors to scan between looks at the clock
+
+typedef struct
+{
+	char (*names)[8];
+	size_t count, capacity;
+} prefetchnames_t;
+
+static boolean levelprefetchscan = false; // Still have to look through the level's lumps
+static lumpnum_t levelprefetchmap = LUMPERROR;
+static INT16 levelprefetchsky = 0;
+static virtres_t *levelprefetchvirt = NULL; // The level's lumps, while they're scanned
+static size_t levelprefetchpos = 0; // How far the scan got through them
+static prefetchnames_t prefetchwalls, prefetchflats; // Textures and flats the level uses
+static size_t prefetchwall = 0, prefetchflat = 0; // Next one to warm up
+
+static void P_AddPrefetchName(prefetchnames_t *list, const char *name, size_t length)
+{
+	char padded[8];
+	size_t i;
+
+	memset(padded, 0, sizeof padded);
+	memcpy(padded, name, min(length, sizeof padded));
+	if (!padded[0] || (padded[0] == '-' && !padded[1]))
+		return;
+
+	// Levels use a handful of names over and over.
+	for (i = list->count; i--;)
+		if (!strnicmp(list->names[i], padded, 8))
+			return;
+
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->names = Z_Realloc(list->names, list->capacity * sizeof (*list->names), PU_STATIC, NULL);
+	}
+	memcpy(list->names[list->count++], padded, 8);
+}
+
+static void P_ClearPrefetchNames(prefetchnames_t *list)
+{
+	if (list->names)
+		Z_Free(list->names);
+	list->names = NULL;
+	list->count = list->capacity = 0;
+}
+
+// Picks the texture names out of part of a TEXTMAP without parsing it,
+// and returns where the next part starts
+static size_t P_ScanTextmapForPrefetch(const char *text, size_t size, size_t pos, size_t length)
+{
+	static const struct
+	{
+		const char *key;
+		prefetchnames_t *list;
+	} keys[] = {
+		{"texturetop", &prefetchwalls},
+		{"texturemiddle", &prefetchwalls},
+		{"texturebottom", &prefetchwalls},
+		{"texturefloor", &prefetchflats},
+		{"textureceiling", &prefetchflats},
+	};
+	const char *p, *end = text + size, *stop = text + min(pos + length, size);
+	size_t i;
+
+	// A name may run past stop, the next part starts after it.
+	for (p = text + pos; p < stop; p++)
+	{
+		if (*p != 't' || (size_t)(end - p) < 16 || memcmp(p, "texture", 7))
+			continue;
+
+		for (i = 0; i < sizeof keys / sizeof *keys; i++)
+		{
+			size_t keylen = strlen(keys[i].key);
+			const char *name;
+
+			if (memcmp(p, keys[i].key, keylen) || isalnum(p[keylen]))
+				continue;
+
+			p += keylen;
+			while (p < end && isspace(*p))
+				p++;
+			if (p >= end || *p != '=')
+				break;
+			p++;
+			while (p < end && isspace(*p))
+				p++;
+			if (p >= end || *p != '"')
+				break;
+
+			name = ++p;
+			while (p < end && *p != '"')
+				p++;
+			P_AddPrefetchName(keys[i].list, name, p - name);
+			break;
+		}
+	}
+
+	return min((size_t)(p - text), size);
+}
+
+// Does a little more of reading the level's lumps, once the prefetch
+// thread has inflated them, to note which textures and flats it uses.
+// Returns true once the whole level has been looked through.
+static boolean P_ScanLevelForPrefetch(void)
+{
+	virtlump_t *textmap, *virtsidedefs, *virtsectors;
+	size_t numsides, numsectors, stop;
+	char skytexname[12];
+
+	// Copying the lumps out of the cache is a step of its own.
+	if (!levelprefetchvirt)
+	{
+		levelprefetchvirt = vres_GetMap(levelprefetchmap);
+		levelprefetchpos = 0;
+		return false;
+	}
+
+	textmap = vres_Find(levelprefetchvirt, "TEXTMAP");
+	if (textmap)
+	{
+		if (levelprefetchpos < textmap->size)
+		{
+			levelprefetchpos = P_ScanTextmapForPrefetch((char *)textmap->data, textmap->size,
+				levelprefetchpos, PREFETCHTEXTCHUNK);
+			return false;
+		}
+	}
+	else
+	{
+		virtsidedefs = vres_Find(levelprefetchvirt, "SIDEDEFS");
+		virtsectors = vres_Find(levelprefetchvirt, "SECTORS");
+		numsides = virtsidedefs ? virtsidedefs->size / sizeof (mapsidedef_t) : 0;
+		numsectors = virtsectors ? virtsectors->size / sizeof (mapsector_t) : 0;
+
+		if (levelprefetchpos < numsides + numsectors)
+		{
+			stop = min(levelprefetchpos + PREFETCHRECORDCHUNK, numsides + numsectors);
+			for (; levelprefetchpos < stop; levelprefetchpos++)
+			{
+				if (levelprefetchpos < numsides)
+				{
+					mapsidedef_t *msd = (mapsidedef_t *)virtsidedefs->data + levelprefetchpos;
+					P_AddPrefetchName(&prefetchwalls, msd->toptexture, 8);
+					P_AddPrefetchName(&prefetchwalls, msd->midtexture, 8);
+					P_AddPrefetchName(&prefetchwalls, msd->bottomtexture, 8);
+				}
+				else
+				{
+					mapsector_t *ms = (mapsector_t *)virtsectors->data + (levelprefetchpos - numsides);
+					P_AddPrefetchName(&prefetchflats, ms->floorpic, 8);
+					P_AddPrefetchName(&prefetchflats, ms->ceilingpic, 8);
+				}
+			}
+			return false;
+		}
+	}
+
+	vres_Free(levelprefetchvirt);
+	levelprefetchvirt = NULL;
+
+	sprintf(skytexname, "SKY%d", levelprefetchsky);
+	P_AddPrefetchName(&prefetchwalls, skytexname, strlen(skytexname));
+	return true;
+}
+
+// Caches one of the level's textures or flats the way P_LoadLevel will
+static void P_PrefetchName(const char *name, boolean flat)
+{
+	char texname[9];
+	INT32 texnum;
+
+	memcpy(texname, name, 8);
+	texname[8] = '\0';
+
+	if (flat)
+	{
+		lumpnum_t flatnum = R_GetFlatNumForName(texname);
+		if (flatnum != LUMPERROR)
+		{
+			R_GetFlat(flatnum);
+			return;
+		}
+	}
+
+	// Composite textures are only kept around by the software renderer.
+	if (rendermode != render_soft)
+		return;
+
+	texnum = R_CheckTextureNumForName(texname);
+	if (texnum >= 0 && texnum < numtextures)
+		R_CheckTextureCache(texnum);
+}
+
+/** Stops warming up the next level, and lets go of what was gathered
+  * for it. Lumps the prefetch thread is still reading are left to it.
+  *
+  * \sa P_StartLevelPrefetch
+  */
+void P_StopLevelPrefetch(void)
+{
+	if (levelprefetchvirt)
+		vres_Free(levelprefetchvirt);
+	levelprefetchvirt = NULL;
+	levelprefetchscan = false;
+	levelprefetchmap = LUMPERROR;
+	P_ClearPrefetchNames(&prefetchwalls);
+	P_ClearPrefetchNames(&prefetchflats);
+	prefetchwall = prefetchflat = 0;
+}
+
+/** Starts warming up a level while the intermission is up: its lumps
+  * and music are read on the prefetch thread, then P_LevelPrefetchTicker
+  * caches its textures and flats a few at a time. Disabled with
+  * -noprefetch.
+  *
+  * \param map Map number of the level, starting at 1.
+  * \sa P_StopLevelPrefetch
+  */
+void P_StartLevelPrefetch(INT16 map)
+{
+	lumpnum_t lumps[PREFETCHMAXLUMPS];
+	size_t count = 0;
+	lumpnum_t maplump, lump;
+
+	P_StopLevelPrefetch();
+
+	if (map < 1 || map > NUMMAPS || !mapheaderinfo[map-1] || dedicated || M_CheckParm("-noprefetch"))
+		return;
+
+	maplump = W_CheckNumForMap(G_BuildMapName(map));
+	if (maplump == LUMPERROR)
+		return;
+
+	// The level itself: a WAD inside a PK3, or a marker and the lumps after it
+	lumps[count++] = maplump;
+	if (!W_IsLumpWad(maplump))
+	{
+		for (lump = maplump + 1; count < PREFETCHMAXLUMPS - 1
+			&& LUMPNUM(lump) < wadfiles[WADFILENUM(maplump)]->numlumps; lump++)
+		{
+			if (memcmp(W_CheckNameForNum(lump), "MAP", 3) == 0)
+				break;
+			lumps[count++] = lump;
+		}
+	}
+
+	// Its music
+	if (mapheaderinfo[map-1]->musname[0])
+	{
+		lump = W_CheckNumForName(va("O_%s", mapheaderinfo[map-1]->musname));
+		if (lump == LUMPERROR)
+			lump = W_CheckNumForName(va("D_%s", mapheaderinfo[map-1]->musname));
+		if (lump != LUMPERROR)
+			lumps[count++] = lump;
+	}
+
+	W_PrefetchLumps(lumps, count);
+
+	levelprefetchmap = maplump;
+	levelprefetchsky = mapheaderinfo[map-1]->skynum;
+	levelprefetchscan = true;
+}
+
+/** Caches some more of the next level's textures and flats, staying
+  * within a couple of milliseconds so the intermission keeps its pace.
+  * Run once per intermission tic.
+  */
+void P_LevelPrefetchTicker(void)
+{
+	const precise_t budget = I_GetPrecisePrecision() / 500;
+	precise_t start;
+
+	if (levelprefetchmap == LUMPERROR)
+		return;
+
+	start = I_GetPreciseTime();
+
+	if (levelprefetchscan)
+	{
+		// Wait for the thread instead of inflating the level twice.
+		if (W_IsPrefetching())
+			return;
+
+		// A big level takes a few tics to look through.
+		while (!P_ScanLevelForPrefetch())
+			if (I_GetPreciseTime() - start >= budget)
+				return;
+		levelprefetchscan = false;
+		return;
+	}
+
+	do
+	{
+		if (prefetchflat < prefetchflats.count)
+			P_PrefetchName(prefetchflats.names[prefetchflat++], true);
+		else if (prefetchwall < prefetchwalls.count)
+			P_PrefetchName(prefetchwalls.names[prefetchwall++], false);
+		else
+		{
+			P_StopLevelPrefetch();
+			return;
+		}
+	} while (I_GetPreciseTime() - start < budget);
+}
+
 /** Loads a level from a lump or external wad.
   *
   * \param fromnetsave If true, skip some stuff because we're loading a netgame snapshot.
@@ -7658,6 +8691,8 @@ boolean P_LoadLevel(boolean fromnetsave, boolean reloadinggamestate)
 	sector_t *ss;
 	levelloading = true;
 
+	P_StopLevelPrefetch();
+
 	// This is needed. Don't touch.
 	maptol = mapheaderinfo[gamemap-1]->typeoflevel;
 	gametyperules = gametypedefaultrules[gametype];
@@ -7813,6 +8848,7 @@ boolean P_LoadLevel(boolean fromnetsave, boolean reloadinggamestate)
 
 	Patch_FreeTag(PU_PATCH_LOWPRIORITY);
 	Patch_FreeTag(PU_PATCH_ROTATED);
+	P_ClearLevelCacheKey();
 	Z_FreeTags(PU_LEVEL, PU_PURGELEVEL - 1);
 
 	R_InitializeLevelInterpolators();
@@ -109,6 +109,9 @@ void P_LoadSoundsRange(UINT16 wadnum, UINT16 first, UINT16 num);
 void P_LoadMusicsRange(UINT16 wadnum, UINT16 first, UINT16 num);
 //void P_WriteThings(void);
 size_t P_PrecacheLevelFlats(void);
+void P_StartLevelPrefetch(INT16 map);
+void P_StopLevelPrefetch(void);
+void P_LevelPrefetchTicker(void);
 void P_AllocMapHeader(INT16 i);
 
 void P_SetDemoFlickies(INT16 i);
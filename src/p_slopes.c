@@ -89,6 +89,8 @@ static void ReconfigureViaVertexes (pslope_t *slope, const vector3_t v1, const v
 		slope->xydirection = R_PointToAngle2(0, 0, slope->d.x, slope->d.y)+ANGLE_180;
 		slope->zangle = InvAngle(R_PointToAngle2(0, 0, FRACUNIT, slope->zdelta));
 	}
+
+	P_SlopeModified(slope);
 }
 
 /// Setup slope via constants.
@@ -123,6 +125,8 @@ static void ReconfigureViaConstants (pslope_t *slope, const fixed_t a, const fix
 	// Get angles
 	slope->xydirection = R_PointToAngle2(0, 0, slope->d.x, slope->d.y)+ANGLE_180;
 	slope->zangle = InvAngle(R_PointToAngle2(0, 0, FRACUNIT, slope->zdelta));
+
+	P_SlopeModified(slope);
 }
 
 /// Recalculate dynamic slopes.
@@ -131,37 +135,43 @@ void T_DynamicSlopeLine (dynlineplanethink_t* th)
 	pslope_t* slope = th->slope;
 	line_t* srcline = th->sourceline;
 
-	fixed_t zdelta;
+	fixed_t zdelta, oz;
 
 	switch(th->type) {
 	case DP_FRONTFLOOR:
 		zdelta = srcline->backsector->floorheight - srcline->frontsector->floorheight;
-		slope->o.z = srcline->frontsector->floorheight;
+		oz = srcline->frontsector->floorheight;
 		break;
 
 	case DP_FRONTCEIL:
 		zdelta = srcline->backsector->ceilingheight - srcline->frontsector->ceilingheight;
-		slope->o.z = srcline->frontsector->ceilingheight;
+		oz = srcline->frontsector->ceilingheight;
 		break;
 
 	case DP_BACKFLOOR:
 		zdelta = srcline->frontsector->floorheight - srcline->backsector->floorheight;
-		slope->o.z = srcline->backsector->floorheight;
+		oz = srcline->backsector->floorheight;
 		break;
 
 	case DP_BACKCEIL:
 		zdelta = srcline->frontsector->ceilingheight - srcline->backsector->ceilingheight;
-		slope->o.z = srcline->backsector->ceilingheight;
+		oz = srcline->backsector->ceilingheight;
 		break;
 
 	default:
 		return;
 	}
 
+	if (slope->o.z != oz) {
+		slope->o.z = oz;
+		P_SlopeModified(slope);
+	}
+
 	if (slope->zdelta != FixedDiv(zdelta, th->extent)) {
 		slope->zdelta = FixedDiv(zdelta, th->extent);
 		slope->zangle = R_PointToAngle2(0, 0, th->extent, -zdelta);
 		P_CalculateSlopeNormal(slope);
+		P_SlopeModified(slope);
 	}
 }
 
@@ -169,6 +179,8 @@ void T_DynamicSlopeLine (dynlineplanethink_t* th)
 void T_DynamicSlopeVert (dynvertexplanethink_t* th)
 {
 	size_t i;
+	fixed_t z;
+	boolean moved = (th->slope->version != th->slopeversion);
 
 	for (i = 0; i < 3; i++)
 	{
@@ -176,12 +188,23 @@ void T_DynamicSlopeVert (dynvertexplanethink_t* th)
 			continue;
 
 		if (th->relative & (1 << i))
-			th->vex[i].z = th->origvecheights[i] + (th->secs[i]->floorheight - th->origsecheights[i]);
+			z = th->origvecheights[i] + (th->secs[i]->floorheight - th->origsecheights[i]);
 		else
-			th->vex[i].z = th->secs[i]->floorheight;
+			z = th->secs[i]->floorheight;
+
+		if (th->vex[i].z != z)
+		{
+			th->vex[i].z = z;
+			moved = true;
+		}
 	}
 
+	// Nothing moved and nothing else touched the slope, so it's already right.
+	if (!moved)
+		return;
+
 	ReconfigureViaVertexes(th->slope, th->vex[0], th->vex[1], th->vex[2]);
+	th->slopeversion = th->slope->version;
 }
 
 static inline void P_AddDynLineSlopeThinker (pslope_t* slope, dynplanetype_t type, line_t* sourceline, fixed_t extent)
@@ -756,12 +779,38 @@ void P_InitSlopes(void)
 // Returns the height of the sloped plane at (x, y) as a fixed_t
 fixed_t P_GetSlopeZAt(const pslope_t *slope, fixed_t x, fixed_t y)
 {
-	fixed_t dist = FixedMul(x - slope->o.x, slope->d.x) +
-	               FixedMul(y - slope->o.y, slope->d.y);
+	fixed_t dist;
+
+	// Flat, which dynamic slopes at rest often are
+	if (!slope->zdelta)
+		return slope->o.z;
+
+	dist = FixedMul(x - slope->o.x, slope->d.x) +
+	       FixedMul(y - slope->o.y, slope->d.y);
 
 	return slope->o.z + FixedMul(dist, slope->zdelta);
 }
 
+// Returns the heights of the sloped plane at several points, same as
+// calling P_GetSlopeZAt on each of them
+void P_GetSlopeZAtPoints(const pslope_t *slope, const vector2_t *points, fixed_t *z, size_t count)
+{
+	const fixed_t ox = slope->o.x, oy = slope->o.y, oz = slope->o.z;
+	const fixed_t dx = slope->d.x, dy = slope->d.y;
+	const fixed_t zdelta = slope->zdelta;
+	size_t i;
+
+	if (!zdelta)
+	{
+		for (i = 0; i < count; i++)
+			z[i] = oz;
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		z[i] = oz + FixedMul(FixedMul(points[i].x - ox, dx) + FixedMul(points[i].y - oy, dy), zdelta);
+}
+
 // Like P_GetSlopeZAt but falls back to z if slope is NULL
 fixed_t P_GetZAt(const pslope_t *slope, fixed_t x, fixed_t y, fixed_t z)
 {
@@ -51,6 +51,10 @@ typedef enum
 void P_LinkSlopeThinkers (void);
 
 void P_CalculateSlopeNormal(pslope_t *slope);
+
+// Call after changing a slope's plane, so anything derived from it gets redone
+#define P_SlopeModified(slope) ((slope)->version++)
+
 void P_InitSlopes(void);
 void P_SpawnSlopes(const boolean fromsave);
 
@@ -69,6 +73,9 @@ fixed_t P_GetSlopeZAt(const pslope_t *slope, fixed_t x, fixed_t y);
 // Like P_GetSlopeZAt but falls back to z if slope is NULL
 fixed_t P_GetZAt(const pslope_t *slope, fixed_t x, fixed_t y, fixed_t z);
 
+// Returns the heights of the sloped plane at several points
+void P_GetSlopeZAtPoints(const pslope_t *slope, const vector2_t *points, fixed_t *z, size_t count);
+
 // Returns the height of the sector at (x, y)
 fixed_t P_GetSectorFloorZAt  (const sector_t *sector, fixed_t x, fixed_t y);
 fixed_t P_GetSectorCeilingZAt(const sector_t *sector, fixed_t x, fixed_t y);
@@ -117,6 +124,7 @@ typedef struct
 	fixed_t origsecheights[3];
 	fixed_t origvecheights[3];
 	UINT8 relative;
+	UINT32 slopeversion; // version of the slope this thinker last set up
 } dynvertexplanethink_t;
 
 void T_DynamicSlopeLine (dynlineplanethink_t* th);
@@ -36,6 +36,9 @@
 
 tic_t leveltime;
 
+UINT32 consistancyhash[NUMCONSISTANCY];
+UINT32 ticconsistancy[NUMCONSISTANCY];
+
 //
 // THINKERS
 // All thinkers should be allocated by Z_Calloc
@@ -414,24 +417,114 @@ mobj_t *P_SetTarget2(mobj_t **mop, mobj_t *targ
 // Rewritten to delete nodes implicitly, by making currentthinker
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
+// Only objects that matter to gameplay, so local effects can never count as a desync
+#define CONSISTANCYFLAGS (MF_SPECIAL|MF_SOLID|MF_PUSHABLE|MF_BOSS|MF_MISSILE|MF_SPRING|MF_MONITOR|MF_FIRE|MF_ENEMY|MF_PAIN|MF_STICKY)
+
+static inline void P_MixMobjConsistancy(const mobj_t *mo)
+{
+	if (!(mo->flags & CONSISTANCYFLAGS))
+		return;
+
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->type);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->x);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->y);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->z);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->momx);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->momy);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->momz);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->angle);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->health);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->state - states);
+	P_MixConsistancy(CONSISTANCY_MOBJS, mo->flags);
+}
+
 static inline void P_RunThinkers(void)
 {
 	size_t i;
 	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
 		PS_START_TIMING(ps_thlist_times[i]);
-		for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
+		if (i == THINK_MOBJ)
+		{
+			// Hash every object right after it thinks, while it is still in cache.
+			for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
+			{
+#ifdef PARANOIA
+				I_Assert(currentthinker->function.acp1 != NULL);
+#endif
+				currentthinker->function.acp1(currentthinker);
+				if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
+					P_MixMobjConsistancy((mobj_t *)currentthinker);
+			}
+		}
+		else
 		{
+			for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
+			{
 #ifdef PARANOIA
-			I_Assert(currentthinker->function.acp1 != NULL);
+				I_Assert(currentthinker->function.acp1 != NULL);
 #endif
-			currentthinker->function.acp1(currentthinker);
+				currentthinker->function.acp1(currentthinker);
+			}
 		}
 		PS_STOP_TIMING(ps_thlist_times[i]);
 	}
 
 }
 
+//
+// P_UpdateConsistancy
+//
+// Finishes the hashes of the tic that just ran. Objects and sectors were
+// hashed as they changed; players, polyobjects and the RNG are few enough
+// to just hash here.
+//
+static void P_UpdateConsistancy(void)
+{
+	INT32 i;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		const player_t *player = &players[i];
+
+		if (!playeringame[i])
+		{
+			P_MixConsistancy(CONSISTANCY_PLAYERS, 0xCCCC);
+			continue;
+		}
+
+		P_MixConsistancy(CONSISTANCY_PLAYERS, player->playerstate);
+		P_MixConsistancy(CONSISTANCY_PLAYERS, player->rings);
+		P_MixConsistancy(CONSISTANCY_PLAYERS, player->score);
+		P_MixConsistancy(CONSISTANCY_PLAYERS, player->powers[pw_shield]);
+
+		if (player->mo)
+		{
+			P_MixConsistancy(CONSISTANCY_PLAYERS, player->mo->x);
+			P_MixConsistancy(CONSISTANCY_PLAYERS, player->mo->y);
+			P_MixConsistancy(CONSISTANCY_PLAYERS, player->mo->z);
+			P_MixConsistancy(CONSISTANCY_PLAYERS, player->mo->momx);
+			P_MixConsistancy(CONSISTANCY_PLAYERS, player->mo->momy);
+			P_MixConsistancy(CONSISTANCY_PLAYERS, player->mo->momz);
+		}
+	}
+
+	for (i = 0; i < numPolyObjects; i++)
+	{
+		const polyobj_t *po = &PolyObjects[i];
+
+		P_MixConsistancy(CONSISTANCY_POLYOBJECTS, po->centerPt.x);
+		P_MixConsistancy(CONSISTANCY_POLYOBJECTS, po->centerPt.y);
+		P_MixConsistancy(CONSISTANCY_POLYOBJECTS, po->angle);
+	}
+
+	// Coop desynching enemies is painful, so leave the RNG out of it
+	if (!G_PlatformGametype())
+		P_MixConsistancy(CONSISTANCY_RNG, P_GetRandSeed());
+
+	memcpy(consistancyhash, ticconsistancy, sizeof(consistancyhash));
+}
+
 //
 // P_DoAutobalanceTeams()
 //
@@ -736,6 +829,8 @@ void P_Ticker(boolean run)
 
 	P_MapStart();
 
+	memset(ticconsistancy, 0, sizeof(ticconsistancy));
+
 	if (run)
 	{
 		R_UpdateMobjInterpolators();
@@ -866,6 +961,8 @@ void P_Ticker(boolean run)
 		LUA_HOOK(PostThinkFrame);
 	}
 
+	P_UpdateConsistancy();
+
 	if (run)
 	{
 		R_UpdateLevelInterpolators();
@@ -22,6 +22,25 @@
 
 extern tic_t leveltime;
 
+// Hashes of each part of the game state, compared between the server and
+// clients every tic, so a desync can be traced to the part that diverged
+typedef enum
+{
+	CONSISTANCY_PLAYERS,
+	CONSISTANCY_MOBJS,
+	CONSISTANCY_SECTORS,
+	CONSISTANCY_POLYOBJECTS,
+	CONSISTANCY_RNG,
+	NUMCONSISTANCY
+} consistancy_t;
+
+extern UINT32 consistancyhash[NUMCONSISTANCY]; // As of the end of the last tic
+extern UINT32 ticconsistancy[NUMCONSISTANCY]; // Built up while the current tic runs
+
+// Folds a value into a hash for the current tic
+#define P_MixConsistancy(part, value) \
+	(ticconsistancy[part] = (ticconsistancy[part] ^ (UINT32)(value)) * 0x01000193)
+
 // Called by G_Ticker. Carries out all thinking of enemies and players.
 void Command_Numthinkers_f(void);
 void Command_CountMobjs_f(void);
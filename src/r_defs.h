@@ -312,6 +312,8 @@ typedef struct pslope_s
 	angle_t zangle;		/// Precomputed angle of the plane going up from the ground (not measured in degrees).
 	angle_t xydirection;/// Precomputed angle of the normal's projection on the XY plane.
 
+	UINT32 version; /// Bumped whenever the plane changes, see P_SlopeModified.
+
 	UINT8 flags; // Slope options
 } pslope_t;
 
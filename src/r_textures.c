@@ -56,14 +56,26 @@ fixed_t *textureheight; // needed for texture pegging
 
 INT32 *texturetranslation;
 
-// Painfully simple texture id cacheing to make maps load faster. :3
-static struct {
-	char name[9];
-	UINT32 hash;
-	INT32 id;
-} *tidcache = NULL;
+// Every texture by name, so looking one up doesn't go through all of them.
+// Open addressing, at most half full; a texture takes the slot of any
+// earlier texture with the same name.
+typedef struct
+{
+	INT32 id; // -1 if empty
+	UINT32 lookup; // Last texturelookup that found it, to count the textures a map uses
+} texturedirslot_t;
+
+static texturedirslot_t *texturedir = NULL;
+static size_t texturedirsize = 0;
+static INT32 texturedirtextures = 0; // textures[0] to this are in it
+static UINT32 texturelookup = 1;
 static INT32 tidcachelen = 0;
 
+// Every flat lump by name, following R_GetFlatNumForName's precedence
+static lumpnum_t *flatdir = NULL;
+static size_t flatdirsize = 0, flatdircount = 0;
+static UINT16 flatdirwads = 0; // wadfiles[0] to this are in it
+
 //
 // MAPTEXTURE_T CACHING
 // When a texture is first needed, it counts the number of composite columns
@@ -1050,10 +1062,143 @@ static INT32 R_DefineTextures(INT32 i, UINT16 w)
 	return Rloadtextures(i, w);
 }
 
+static void R_AddToTextureDirectory(INT32 id)
+{
+	size_t slot = textures[id]->hash & (texturedirsize - 1);
+
+	while (texturedir[slot].id != -1)
+	{
+		texture_t *other = textures[texturedir[slot].id];
+		if (other->hash == textures[id]->hash && !strncasecmp(other->name, textures[id]->name, 8))
+			break;
+		slot = (slot + 1) & (texturedirsize - 1);
+	}
+
+	texturedir[slot].id = id;
+	texturedir[slot].lookup = 0;
+}
+
+// Adds the textures loaded since last time, growing the table if it needs to
+static void R_UpdateTextureDirectory(void)
+{
+	if ((size_t)numtextures * 2 > texturedirsize)
+	{
+		size_t i;
+
+		if (texturedir)
+			Z_Free(texturedir);
+		if (!texturedirsize)
+			texturedirsize = 1024;
+		while ((size_t)numtextures * 2 > texturedirsize)
+			texturedirsize *= 2;
+
+		texturedir = Z_Malloc(texturedirsize * sizeof (*texturedir), PU_STATIC, NULL);
+		for (i = 0; i < texturedirsize; i++)
+			texturedir[i].id = -1;
+		texturedirtextures = 0;
+	}
+
+	for (; texturedirtextures < numtextures; texturedirtextures++)
+		if (textures[texturedirtextures])
+			R_AddToTextureDirectory(texturedirtextures);
+}
+
+// Finds the flats section of a wad, as R_GetFlatNumForName always has
+static boolean R_GetFlatRange(UINT16 wadnum, UINT16 *start, UINT16 *end)
+{
+	switch (wadfiles[wadnum]->type)
+	{
+	case RET_WAD:
+		if ((*start = W_CheckNumForMarkerStartPwad("F_START", wadnum, 0)) == INT16_MAX)
+		{
+			if ((*start = W_CheckNumForMarkerStartPwad("FF_START", wadnum, 0)) == INT16_MAX)
+				return false;
+			else if ((*end = W_CheckNumForNamePwad("FF_END", wadnum, *start)) == INT16_MAX)
+				return false;
+		}
+		else
+			if ((*end = W_CheckNumForNamePwad("F_END", wadnum, *start)) == INT16_MAX)
+				return false;
+		return true;
+	case RET_PK3:
+	case RET_FOLDER:
+		if ((*start = W_CheckNumForFolderStartPK3("Flats/", wadnum, 0)) == INT16_MAX)
+			return false;
+		if ((*end = W_CheckNumForFolderEndPK3("Flats/", wadnum, *start)) == INT16_MAX)
+			return false;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void R_AddToFlatDirectory(lumpnum_t lumpnum)
+{
+	lumpinfo_t *l = wadfiles[WADFILENUM(lumpnum)]->lumpinfo + LUMPNUM(lumpnum);
+	size_t slot = l->hash & (flatdirsize - 1);
+
+	while (flatdir[slot] != LUMPERROR)
+	{
+		lumpinfo_t *other = wadfiles[WADFILENUM(flatdir[slot])]->lumpinfo + LUMPNUM(flatdir[slot]);
+		if (other->hash == l->hash && !strncmp(other->name, l->name, 8))
+		{
+			// Later files override earlier ones, but a file's first flat of a name is the one it uses.
+			if (WADFILENUM(flatdir[slot]) != WADFILENUM(lumpnum))
+				flatdir[slot] = lumpnum;
+			return;
+		}
+		slot = (slot + 1) & (flatdirsize - 1);
+	}
+
+	flatdir[slot] = lumpnum;
+	flatdircount++;
+}
+
+// Adds the flats of files loaded since last time
+static void R_UpdateFlatDirectory(void)
+{
+	for (; flatdirwads < numwadfiles; flatdirwads++)
+	{
+		UINT16 start, end, l;
+
+		if (!R_GetFlatRange(flatdirwads, &start, &end))
+			continue;
+		if (end > wadfiles[flatdirwads]->numlumps)
+			end = wadfiles[flatdirwads]->numlumps;
+
+		for (l = start; l < end; l++)
+		{
+			if ((flatdircount + 1) * 2 > flatdirsize)
+			{
+				lumpnum_t *old = flatdir;
+				size_t oldsize = flatdirsize, i;
+
+				flatdirsize = flatdirsize ? flatdirsize * 2 : 1024;
+				flatdir = Z_Malloc(flatdirsize * sizeof (*flatdir), PU_STATIC, NULL);
+				for (i = 0; i < flatdirsize; i++)
+					flatdir[i] = LUMPERROR;
+				flatdircount = 0;
+
+				// Slots are already in precedence order, so just carry them over.
+				for (i = 0; i < oldsize; i++)
+					if (old[i] != LUMPERROR)
+						R_AddToFlatDirectory(old[i]);
+				if (old)
+					Z_Free(old);
+			}
+
+			R_AddToFlatDirectory(((lumpnum_t)flatdirwads << 16) + l);
+		}
+	}
+}
+
 static void R_FinishLoadingTextures(INT32 add)
 {
 	numtextures += add;
 
+	R_UpdateTextureDirectory();
+	R_UpdateFlatDirectory();
+
 #ifdef HWRENDER
 	if (rendermode == render_opengl)
 		HWR_LoadMapTextures(numtextures);
@@ -1566,57 +1711,33 @@ void R_ParseTEXTURESLump(UINT16 wadNum, UINT16 lumpNum, INT32 *texindex)
 // Search for flat name.
 lumpnum_t R_GetFlatNumForName(const char *name)
 {
-	INT32 i;
-	lumpnum_t lump;
-	lumpnum_t start;
-	lumpnum_t end;
+	char uname[8 + 1];
+	UINT32 hash;
+	size_t slot;
 
-	// Scan wad files backwards so patched flats take preference.
-	for (i = numwadfiles - 1; i >= 0; i--)
-	{
-		switch (wadfiles[i]->type)
-		{
-		case RET_WAD:
-			if ((start = W_CheckNumForMarkerStartPwad("F_START", (UINT16)i, 0)) == INT16_MAX)
-			{
-				if ((start = W_CheckNumForMarkerStartPwad("FF_START", (UINT16)i, 0)) == INT16_MAX)
-					continue;
-				else if ((end = W_CheckNumForNamePwad("FF_END", (UINT16)i, start)) == INT16_MAX)
-					continue;
-			}
-			else
-				if ((end = W_CheckNumForNamePwad("F_END", (UINT16)i, start)) == INT16_MAX)
-					continue;
-			break;
-		case RET_PK3:
-		case RET_FOLDER:
-			if ((start = W_CheckNumForFolderStartPK3("Flats/", i, 0)) == INT16_MAX)
-				continue;
-			if ((end = W_CheckNumForFolderEndPK3("Flats/", i, start)) == INT16_MAX)
-				continue;
-			break;
-		default:
-			continue;
-		}
+	R_UpdateFlatDirectory();
+	if (!flatdirsize)
+		return LUMPERROR;
 
-		// Now find lump with specified name in that range.
-		lump = W_CheckNumForNamePwad(name, (UINT16)i, start);
-		if (lump < end)
-		{
-			lump += (i<<16); // found it, in our constraints
-			break;
-		}
-		lump = LUMPERROR;
+	// Flat lumps are matched by their upper case names.
+	strlcpy(uname, name, sizeof uname);
+	strupr(uname);
+	hash = quickncasehash(uname, 8);
+
+	for (slot = hash & (flatdirsize - 1); flatdir[slot] != LUMPERROR; slot = (slot + 1) & (flatdirsize - 1))
+	{
+		lumpinfo_t *l = wadfiles[WADFILENUM(flatdir[slot])]->lumpinfo + LUMPNUM(flatdir[slot]);
+		if (l->hash == hash && !strncmp(l->name, uname, 8))
+			return flatdir[slot];
 	}
 
-	return lump;
+	return LUMPERROR;
 }
 
 void R_ClearTextureNumCache(boolean btell)
 {
-	if (tidcache)
-		Z_Free(tidcache);
-	tidcache = NULL;
+	// Start counting the textures looked up anew.
+	texturelookup++;
 	if (btell)
 		CONS_Debug(DBG_SETUP, "Fun Fact: There are %d textures used in this map.\n", tidcachelen);
 	tidcachelen = 0;
@@ -1629,35 +1750,38 @@ void R_ClearTextureNumCache(boolean btell)
 //
 INT32 R_CheckTextureNumForName(const char *name)
 {
-	INT32 i;
+	size_t slot;
 	UINT32 hash;
 
 	// "NoTexture" marker.
 	if (name[0] == '-')
 		return 0;
 
-	hash = quickncasehash(name, 8);
+	if (texturedirtextures != numtextures)
+		R_UpdateTextureDirectory();
+	if (!texturedirsize)
+		return -1;
 
-	for (i = 0; i < tidcachelen; i++)
-		if (tidcache[i].hash == hash && !strncasecmp(tidcache[i].name, name, 8))
-			return tidcache[i].id;
+	hash = quickncasehash(name, 8);
 
-	// Need to parse the list backwards, so textures loaded more recently are used in lieu of ones loaded earlier
-	//for (i = 0; i < numtextures; i++) <- old
-	for (i = (numtextures - 1); i >= 0; i--) // <- new
-		if (textures[i]->hash == hash && !strncasecmp(textures[i]->name, name, 8))
+	// Textures loaded more recently are used in lieu of ones loaded earlier,
+	// which the directory takes care of.
+	for (slot = hash & (texturedirsize - 1); texturedir[slot].id != -1; slot = (slot + 1) & (texturedirsize - 1))
+	{
+		texture_t *texture = textures[texturedir[slot].id];
+		if (texture->hash == hash && !strncasecmp(texture->name, name, 8))
 		{
-			tidcachelen++;
-			Z_Realloc(tidcache, tidcachelen * sizeof(*tidcache), PU_STATIC, &tidcache);
-			strncpy(tidcache[tidcachelen-1].name, name, 8);
-			tidcache[tidcachelen-1].name[8] = '\0';
+			if (texturedir[slot].lookup != texturelookup)
+			{
+				texturedir[slot].lookup = texturelookup;
+				tidcachelen++;
 #ifndef ZDEBUG
-			CONS_Debug(DBG_SETUP, "texture #%s: %s\n", sizeu1(tidcachelen), tidcache[tidcachelen-1].name);
+				CONS_Debug(DBG_SETUP, "texture #%s: %.8s\n", sizeu1(tidcachelen), texture->name);
 #endif
-			tidcache[tidcachelen-1].hash = hash;
-			tidcache[tidcachelen-1].id = i;
-			return i;
+			}
+			return texturedir[slot].id;
 		}
+	}
 
 	return -1;
 }
@@ -238,6 +238,47 @@ static void R_InstallSpriteLump(UINT16 wad,            // graphics patch
 		sprtemp[frame].flip &= ~(1<<rotation);
 }
 
+// Sprite lumps of a wad, bucketed by the first four characters of their
+// names, so each sprite only looks at its own lumps instead of all of them.
+#define SPRITEPREFIXHASHBITS 10
+
+typedef struct
+{
+	UINT16 start, end;
+	UINT16 heads[1<<SPRITEPREFIXHASHBITS]; // First lump of each bucket, or end
+	UINT16 *next; // Next lump in the same bucket, indexed from start, or end
+} spritelumpindex_t;
+
+static UINT32 R_SpritePrefixHash(const char *name)
+{
+	UINT32 prefix = (UINT8)name[0] | ((UINT8)name[1] << 8) | ((UINT8)name[2] << 16) | ((UINT32)(UINT8)name[3] << 24);
+	return (prefix * 2654435761u) >> (32 - SPRITEPREFIXHASHBITS);
+}
+
+static void R_BuildSpriteLumpIndex(spritelumpindex_t *index, UINT16 wadnum, UINT16 start, UINT16 end)
+{
+	lumpinfo_t *lumpinfo = wadfiles[wadnum]->lumpinfo;
+	UINT16 l;
+	size_t i;
+
+	if (end > wadfiles[wadnum]->numlumps)
+		end = wadfiles[wadnum]->numlumps;
+
+	index->start = start;
+	index->end = end;
+	for (i = 0; i < 1<<SPRITEPREFIXHASHBITS; i++)
+		index->heads[i] = end;
+	index->next = Z_Malloc(max(end - start, 1) * sizeof (*index->next), PU_STATIC, NULL);
+
+	// Go backwards, so each bucket lists its lumps in wad order.
+	for (l = end; l-- > start;)
+	{
+		UINT32 hash = R_SpritePrefixHash(lumpinfo[l].name);
+		index->next[l - start] = index->heads[hash];
+		index->heads[hash] = l;
+	}
+}
+
 // Install a single sprite, given its identifying name (4 chars)
 //
 // (originally part of R_AddSpriteDefs)
@@ -251,7 +292,7 @@ static void R_InstallSpriteLump(UINT16 wad,            // graphics patch
 //
 // Returns true if the sprite was succesfully added
 //
-boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16 wadnum, UINT16 startlump, UINT16 endlump)
+static boolean R_AddIndexedSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16 wadnum, UINT16 startlump, UINT16 endlump, const spritelumpindex_t *index)
 {
 	UINT16 l;
 	UINT8 frame;
@@ -260,6 +301,21 @@ boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16
 	softwarepatch_t patch;
 	UINT16 numadded = 0;
 
+	lumpinfo = wadfiles[wadnum]->lumpinfo;
+	if (endlump > wadfiles[wadnum]->numlumps)
+		endlump = wadfiles[wadnum]->numlumps;
+
+	// Skip right to the first lump of this sprite, if the index has any.
+	if (index)
+	{
+		for (l = index->heads[R_SpritePrefixHash(sprname)]; l < endlump; l = index->next[l - index->start])
+			if (memcmp(lumpinfo[l].name,sprname,4)==0)
+				break;
+		if (l >= endlump)
+			return false;
+		startlump = l;
+	}
+
 	memset(sprtemp,0xFF, sizeof (sprtemp));
 	maxframe = (size_t)-1;
 
@@ -277,11 +333,7 @@ boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16
 
 	// scan the lumps,
 	//  filling in the frames for whatever is found
-	lumpinfo = wadfiles[wadnum]->lumpinfo;
-	if (endlump > wadfiles[wadnum]->numlumps)
-		endlump = wadfiles[wadnum]->numlumps;
-
-	for (l = startlump; l < endlump; l++)
+	for (l = startlump; l < endlump; l = (index ? index->next[l - index->start] : l + 1))
 	{
 		if (memcmp(lumpinfo[l].name,sprname,4)==0)
 		{
@@ -449,6 +501,11 @@ boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16
 	return true;
 }
 
+boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16 wadnum, UINT16 startlump, UINT16 endlump)
+{
+	return R_AddIndexedSpriteDef(sprname, spritedef, wadnum, startlump, endlump, NULL);
+}
+
 //
 // Search for sprites replacements in a wad whose names are in namelist
 //
@@ -457,6 +514,7 @@ void R_AddSpriteDefs(UINT16 wadnum)
 	size_t i, addsprites = 0;
 	UINT16 start, end;
 	char wadname[MAX_WADPATH];
+	spritelumpindex_t *index;
 
 	// Find the sprites section in this resource file.
 	switch (wadfiles[wadnum]->type)
@@ -495,6 +553,9 @@ void R_AddSpriteDefs(UINT16 wadnum)
 	}
 
 
+	index = Z_Malloc(sizeof (*index), PU_STATIC, NULL);
+	R_BuildSpriteLumpIndex(index, wadnum, start, end);
+
 	//
 	// scan through lumps, for each sprite, find all the sprite frames
 	//
@@ -503,7 +564,7 @@ void R_AddSpriteDefs(UINT16 wadnum)
 		if (sprnames[i][4] && wadnum >= (UINT16)sprnames[i][4])
 			continue;
 
-		if (R_AddSingleSpriteDef(sprnames[i], &sprites[i], wadnum, start, end))
+		if (R_AddIndexedSpriteDef(sprnames[i], &sprites[i], wadnum, start, index->end, index))
 		{
 #ifdef HWRENDER
 			if (rendermode == render_opengl)
@@ -517,6 +578,9 @@ void R_AddSpriteDefs(UINT16 wadnum)
 		}
 	}
 
+	Z_Free(index->next);
+	Z_Free(index);
+
 	nameonly(strcpy(wadname, wadfiles[wadnum]->filename));
 	CONS_Printf(M_GetText("%s added %d frames in %s sprites\n"), wadname, end-start, sizeu1(addsprites));
 }
@@ -53,10 +53,14 @@ typedef LPVOID (WINAPI *p_MapViewOfFile) (HANDLE, DWORD, DWORD, DWORD, SIZE_T);
 #if defined (__unix__) || defined (UNIXCOMMON)
 #include <fcntl.h>
 #endif
+#if defined (__unix__) || defined(__APPLE__) || defined (UNIXCOMMON) || defined (__CYGWIN__)
+#include <sys/mman.h> // I_MapFile
+#endif
 
 #include <stdio.h>
 #ifdef _WIN32
 #include <conio.h>
+#include <io.h> // _get_osfhandle
 #endif
 
 #ifdef _MSC_VER
@@ -198,6 +202,8 @@ static char returnWadPath[256];
 #include "../i_joy.h"
 
 #include "../m_argv.h"
+#include "../m_md5cache.h"
+#include "../d_dlcache.h"
 
 #include "../r_main.h" // Frame interpolation/uncapped
 #include "../r_fps.h"
@@ -2399,6 +2405,8 @@ void I_Quit(void)
 	D_SaveBan(); // save the ban list
 #endif
 	G_SaveGameData(clientGamedata); // Tails 12-08-2002
+	M_SaveFileMD5Cache();
+	D_SaveDownloadCache();
 	//added:16-02-98: when recording a demo, should exit using 'q' key,
 	//        but sometimes we forget and use 'F10'.. so save here too.
 
@@ -2516,6 +2524,8 @@ void I_Error(const char *error, ...)
 	D_SaveBan(); // save the ban list
 #endif
 	G_SaveGameData(clientGamedata); // Tails 12-08-2002
+	M_SaveFileMD5Cache();
+	D_SaveDownloadCache();
 
 	// Shutdown. Here might be other errors.
 	if (demorecording)
@@ -2771,6 +2781,51 @@ INT32 I_mkdir(const char *dirname, INT32 unixright)
 #endif
 }
 
+void *I_MapFile(FILE *file, size_t size)
+{
+#if defined (__unix__) || defined(__APPLE__) || defined (UNIXCOMMON) || defined (__CYGWIN__)
+	void *data;
+
+	if (!size)
+		return NULL;
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	return data == MAP_FAILED ? NULL : data;
+#elif defined (_WIN32)
+	HANDLE mapping;
+	void *data;
+
+	if (!size)
+		return NULL;
+
+	mapping = CreateFileMappingA((HANDLE)_get_osfhandle(_fileno(file)), NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		return NULL;
+
+	// The view keeps the mapping alive
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+	CloseHandle(mapping);
+	return data;
+#else
+	(void)file;
+	(void)size;
+	return NULL;
+#endif
+}
+
+void I_UnmapFile(void *data, size_t size)
+{
+#if defined (__unix__) || defined(__APPLE__) || defined (UNIXCOMMON) || defined (__CYGWIN__)
+	munmap(data, size);
+#elif defined (_WIN32)
+	(void)size;
+	UnmapViewOfFile(data);
+#else
+	(void)data;
+	(void)size;
+#endif
+}
+
 char *I_GetEnv(const char *name)
 {
 #ifdef NEED_SDL_GETENV
@@ -18,6 +18,7 @@ typedef void * (*Create_fn)(void);
 
 struct Link;
 struct Thread;
+struct Job_batch;
 
 typedef struct Link   * Link;
 typedef struct Thread * Thread;
@@ -37,6 +38,18 @@ struct Thread
 	SDL_Thread  * thread;
 };
 
+struct Job_batch
+{
+	I_job_fn       fn;
+	void         * userdata;
+	int            count;
+
+	SDL_atomic_t   next;
+};
+
+/* more than this and the threads mostly fight over memory */
+#define MAX_JOB_THREADS 16
+
 static Link    i_thread_pool;
 static Link    i_mutex_pool;
 static Link    i_cond_pool;
@@ -354,3 +367,102 @@ I_wake_all_cond (
 	if (SDL_CondBroadcast(cond) == -1)
 		abort();
 }
+
+SDL_COMPILE_TIME_ASSERT(I_atomic, sizeof (I_atomic) == sizeof (SDL_atomic_t));
+
+int
+I_atomic_get (
+		I_atomic * atomic
+){
+	return SDL_AtomicGet((SDL_atomic_t *)atomic);
+}
+
+void
+I_atomic_set (
+		I_atomic * atomic,
+		int        value
+){
+	SDL_AtomicSet((SDL_atomic_t *)atomic, value);
+}
+
+int
+I_job_thread_count (void)
+{
+	static int count;
+
+	if (! count)
+	{
+		count = SDL_GetCPUCount();
+
+		if (count < 1)
+			count = 1;
+		else if (count > MAX_JOB_THREADS)
+			count = MAX_JOB_THREADS;
+	}
+
+	return count;
+}
+
+static int
+Job_worker (
+		struct Job_batch * batch
+){
+	int job;
+
+	while (( job = SDL_AtomicAdd(&batch->next, 1) ) < batch->count)
+		(*batch->fn)(batch->userdata, job);
+
+	return 0;
+}
+
+void
+I_run_jobs (
+		const char  * name,
+		I_job_fn      fn,
+		void        * userdata,
+		size_t        count
+){
+	struct Job_batch   batch;
+	SDL_Thread       * threads[MAX_JOB_THREADS];
+
+	int nthreads;
+	int i;
+
+	if (! count)
+		return;
+
+	if (count > INT32_MAX)
+		abort();
+
+	batch.fn       = fn;
+	batch.userdata = userdata;
+	batch.count    = (int)count;
+
+	SDL_AtomicSet(&batch.next, 0);
+
+	/* the calling thread takes jobs too */
+	nthreads = I_job_thread_count() - 1;
+
+	if ((size_t)nthreads > count - 1)
+		nthreads = (int)count - 1;
+
+	for (i = 0; i < nthreads; ++i)
+	{
+		threads[i] = SDL_CreateThread(
+				(SDL_ThreadFunction)Job_worker,
+				name,
+				&batch
+		);
+
+		/* fewer threads is fine, the rest get picked up below */
+		if (! threads[i])
+			break;
+	}
+
+	nthreads = i;
+
+	Job_worker(&batch);
+
+	for (i = 0; i < nthreads; ++i)
+		SDL_WaitThread(threads[i], NULL);
+}
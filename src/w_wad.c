@@ -61,8 +61,10 @@
 #include "r_picformats.h"
 #include "i_time.h"
 #include "i_system.h"
+#include "i_threads.h"
 #include "i_video.h" // rendermode
 #include "md5.h"
+#include "m_md5cache.h"
 #include "lua_script.h"
 #ifdef SCANTHINGS
 #include "p_setup.h" // P_ScanThings
@@ -90,17 +92,94 @@ typedef struct
 	size_t len;
 } lumpchecklist_t;
 
-// Must be a power of two
-#define LUMPNUMCACHESIZE 64
+// Every loaded lump by name, for W_CheckNumForName and W_CheckNumForLongName.
+// Open addressing with linear probing. Files are only ever added after all
+// the others, so a name just maps to its lump in the newest file that has
+// it (the first one in that file), which the next file may take over.
+typedef struct
+{
+	UINT32 hash;
+	lumpnum_t lumpnum; // LUMPERROR if the slot is free
+} lumpdirslot_t;
+
+typedef struct
+{
+	lumpdirslot_t *slots;
+	size_t size; // always a power of two
+	size_t count;
+	boolean longnames;
+} lumpdirectory_t;
+
+// A lump of a PK3, as read from its central directory and local header
+typedef struct
+{
+	char *fullname;
+	UINT32 position; // Where the data starts
+	UINT32 disksize;
+	UINT32 size;
+	UINT16 compression; // PKZip compression method
+} zipentry_t;
+
+// What W_InitMultipleFiles worked out on the job threads about each file,
+// before adding them one by one
+typedef struct
+{
+	char *filename;
+	UINT16 numlumps;
+	zipentry_t *zipentries; // The lumps of a PK3, or NULL
+} preparedfile_t;
+
+static preparedfile_t *preparedfiles = NULL;
+static size_t numpreparedfiles = 0;
+
+static lumpdirectory_t lumpnamedir = {NULL, 0, 0, false};
+static lumpdirectory_t lumplongnamedir = {NULL, 0, 0, true};
+
+// Decompressed PK3 and ZWAD lumps, so reading the header of a lump and
+// then the rest of it, or reading it again after the zone purged it,
+// doesn't inflate it every time. Kept out of the zone so that PU_CACHE
+// purges leave it alone; the least recently used lumps go first.
+#define INFLATECACHESIZE (32 << 20)
+#define INFLATECACHEBUCKETS 256
+
+typedef struct inflatedlump_s
+{
+	UINT16 wad, lump;
+	size_t size;
+	struct inflatedlump_s *prev, *next; // Most recently used first
+	struct inflatedlump_s *hashnext;
+} inflatedlump_t;
+
+#define INFLATEDDATA(entry) ((UINT8 *)((entry) + 1))
+
+static inflatedlump_t *inflatedhash[INFLATECACHEBUCKETS];
+static inflatedlump_t *inflatedhead = NULL, *inflatedtail = NULL;
+static size_t inflatedsize = 0;
+static UINT32 inflatedhits = 0, inflatedmisses = 0;
+
+#ifdef HAVE_THREADS
+static I_mutex inflated_mutex;
+
+// Lumps being warmed up in the background, see W_PrefetchLumps
+typedef struct
+{
+	size_t numlumps;
+	lumpnum_t *lumps;
+} lumpprefetch_t;
+
+static I_atomic prefetchbusy; // Set while the prefetch thread runs
+static I_atomic prefetchcancel; // Tells the prefetch thread to give up
+#endif
 
-typedef struct lumpnum_cache_s
+static void W_ClearLumpDirectory(lumpdirectory_t *dir)
 {
-	char lumpname[32];
-	lumpnum_t lumpnum;
-} lumpnum_cache_t;
+	if (dir->slots)
+		Z_Free(dir->slots);
+	dir->slots = NULL;
+	dir->size = dir->count = 0;
+}
 
-static lumpnum_cache_t lumpnumcache[LUMPNUMCACHESIZE];
-static UINT16 lumpnumcacheindex = 0;
+static void W_ClearInflatedLumps(void);
 
 //===========================================================================
 //                                                                    GLOBALS
@@ -115,10 +194,17 @@ wadfile_t **wadfiles; // 0 to numwadfiles-1 are valid
 // being ejected
 void W_Shutdown(void)
 {
+	W_StopPrefetch();
+	W_ClearLumpDirectory(&lumpnamedir);
+	W_ClearLumpDirectory(&lumplongnamedir);
+	W_ClearInflatedLumps();
+
 	while (numwadfiles--)
 	{
 		wadfile_t *wad = wadfiles[numwadfiles];
 
+		if (wad->mapped)
+			I_UnmapFile(wad->mapped, wad->filesize);
 		if (wad->handle)
 			fclose(wad->handle);
 		Z_Free(wad->filename);
@@ -299,7 +385,8 @@ static void W_LoadDehackedLumps(UINT16 wadnum, boolean mainfile)
 /** Compute MD5 message digest for bytes read from STREAM of this filname.
   *
   * The resulting message digest number will be written into the 16 bytes
-  * beginning at RESBLOCK.
+  * beginning at RESBLOCK. Files that haven't changed since they were last
+  * hashed are looked up in the MD5 index instead.
   *
   * \param filename path of file
   * \param resblock resulting MD5 checksum
@@ -307,34 +394,110 @@ static void W_LoadDehackedLumps(UINT16 wadnum, boolean mainfile)
   */
 static INT32 W_MakeFileMD5(const char *filename, void *resblock)
 {
-#ifdef NOMD5
-	(void)filename;
-	memset(resblock, 0x00, 16);
-#else
-	FILE *fhandle;
+	return M_FileMD5(filename, resblock) ? 0 : 1;
+}
+
+#define LONGNAMEHASHLEN 256
+
+static boolean W_LumpDirectoryMatch(const lumpdirectory_t *dir, lumpnum_t lumpnum, const char *name)
+{
+	const lumpinfo_t *l = wadfiles[WADFILENUM(lumpnum)]->lumpinfo + LUMPNUM(lumpnum);
+
+	if (dir->longnames)
+		return !strcmp(l->longname, name);
+	return !strncmp(l->name, name, 8);
+}
+
+// Returns the slot holding name, or the free slot it would go in
+static lumpdirslot_t *W_FindLumpDirectorySlot(lumpdirectory_t *dir, const char *name, UINT32 hash)
+{
+	size_t mask = dir->size - 1;
+	size_t i;
 
-	if ((fhandle = fopen(filename, "rb")) != NULL)
+	for (i = hash & mask; dir->slots[i].lumpnum != LUMPERROR; i = (i + 1) & mask)
+		if (dir->slots[i].hash == hash && W_LumpDirectoryMatch(dir, dir->slots[i].lumpnum, name))
+			break;
+
+	return &dir->slots[i];
+}
+
+// Makes room for count names, keeping the table at most half full
+static void W_GrowLumpDirectory(lumpdirectory_t *dir, size_t count)
+{
+	lumpdirslot_t *oldslots = dir->slots;
+	size_t oldsize = dir->size;
+	size_t size = oldsize ? oldsize : 1024;
+	size_t i, j;
+
+	while (size < count * 2)
+		size <<= 1;
+
+	if (size == oldsize)
+		return;
+
+	dir->slots = Z_Malloc(size * sizeof (*dir->slots), PU_STATIC, NULL);
+	dir->size = size;
+	for (i = 0; i < size; i++)
+		dir->slots[i].lumpnum = LUMPERROR;
+
+	for (i = 0; i < oldsize; i++)
 	{
-		tic_t t = I_GetTime();
-		CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",filename);
-		if (md5_stream(fhandle, resblock) == 1)
-		{
-			fclose(fhandle);
-			return 1;
-		}
-		CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f seconds\n",
-			filename, (float)(I_GetTime() - t)/NEWTICRATE);
-		fclose(fhandle);
-		return 0;
+		if (oldslots[i].lumpnum == LUMPERROR)
+			continue;
+
+		for (j = oldslots[i].hash & (size - 1); dir->slots[j].lumpnum != LUMPERROR; j = (j + 1) & (size - 1))
+			;
+		dir->slots[j] = oldslots[i];
 	}
-#endif
-	return 1;
+
+	if (oldslots)
+		Z_Free(oldslots);
 }
 
-// Invalidates the cache of lump numbers. Call this whenever a wad is added.
-static void W_InvalidateLumpnumCache(void)
+static void W_AddLumpToDirectory(lumpdirectory_t *dir, const char *name, UINT32 hash, lumpnum_t lumpnum)
 {
-	memset(lumpnumcache, 0, sizeof (lumpnumcache));
+	lumpdirslot_t *slot = W_FindLumpDirectorySlot(dir, name, hash);
+
+	if (slot->lumpnum == LUMPERROR)
+	{
+		slot->hash = hash;
+		slot->lumpnum = lumpnum;
+		dir->count++;
+	}
+	else if (WADFILENUM(slot->lumpnum) != WADFILENUM(lumpnum))
+		slot->lumpnum = lumpnum; // The newer file takes precedence
+}
+
+// Adds the lumps of a file to the lump directory. Call this whenever a wad
+// is added, before anything can look up its lumps.
+static void W_AddFileToLumpDirectory(UINT16 wadnum)
+{
+	wadfile_t *wad = wadfiles[wadnum];
+	UINT16 lump;
+
+	W_GrowLumpDirectory(&lumpnamedir, lumpnamedir.count + wad->numlumps);
+	W_GrowLumpDirectory(&lumplongnamedir, lumplongnamedir.count + wad->numlumps);
+
+	for (lump = 0; lump < wad->numlumps; lump++)
+	{
+		const lumpinfo_t *l = wad->lumpinfo + lump;
+		lumpnum_t lumpnum = (wadnum << 16) + lump;
+
+		W_AddLumpToDirectory(&lumpnamedir, l->name, l->hash, lumpnum);
+		if (l->longname)
+			W_AddLumpToDirectory(&lumplongnamedir, l->longname, quickncasehash(l->longname, LONGNAMEHASHLEN), lumpnum);
+	}
+}
+
+static const preparedfile_t *W_FindPreparedFile(const char *filename)
+{
+	size_t i;
+
+	for (i = 0; i < numpreparedfiles; i++)
+		if (!strcmp(preparedfiles[i].filename, filename))
+			return &preparedfiles[i];
+
+	return NULL;
 }
 
 /** Detect a file type.
@@ -557,75 +720,164 @@ typedef struct zlentry_s
 #pragma pack()
 #endif
 
-/** Create a lumpinfo_t array for a PKZip file.
- */
-static lumpinfo_t* ResGetLumpsZip (FILE* handle, UINT16* nlmp)
+static void ResFreeZipEntries (zipentry_t *entries, UINT16 numentries)
 {
-    zend_t zend;
-    zentry_t zentry;
-    zlentry_t zlentry;
+	UINT16 i;
 
-	UINT16 numlumps = *nlmp;
-	lumpinfo_t* lumpinfo;
-	lumpinfo_t *lump_p;
-	size_t i;
+	for (i = 0; i < numentries; i++)
+		free(entries[i].fullname);
+	free(entries);
+}
+
+/** Reads the central directory of a PKZip file, and the local header of
+ * every entry to find where its data starts. Only uses malloc, so it is
+ * safe to call from any thread. On any error it returns NULL and leaves
+ * a description in error, for the caller to report.
+ */
+static zipentry_t* ResGetZipEntries (FILE* handle, UINT16* nlmp, char *error, size_t errorlen)
+{
+	zend_t zend;
+	zentry_t zentry;
+	zlentry_t zlentry;
 
 	char pat_central[] = {0x50, 0x4b, 0x01, 0x02, 0x00};
 	char pat_end[] = {0x50, 0x4b, 0x05, 0x06, 0x00};
+	UINT8 *cdir;
+	zipentry_t *entries;
+	size_t pos = 0;
+	UINT16 i;
 
 	// Look for central directory end signature near end of file.
 	// Contains entry number (number of lumps), and central directory start offset.
 	fseek(handle, 0, SEEK_END);
 	if (!ResFindSignature(handle, pat_end, max(0, ftell(handle) - (22 + 65536))))
 	{
-		CONS_Alert(CONS_ERROR, "Missing central directory\n");
+		snprintf(error, errorlen, "Missing central directory");
 		return NULL;
 	}
 
-	fseek(handle, -4, SEEK_CUR);
-	if (fread(&zend, 1, sizeof zend, handle) < sizeof zend)
+	if (fseek(handle, -4, SEEK_CUR) != 0 || fread(&zend, 1, sizeof zend, handle) < sizeof zend)
 	{
-		CONS_Alert(CONS_ERROR, "Corrupt central directory (%s)\n", M_FileError(handle));
+		snprintf(error, errorlen, "Corrupt central directory (%s)", M_FileError(handle));
 		return NULL;
 	}
-	numlumps = zend.entries;
 
-	lump_p = lumpinfo = Z_Malloc(numlumps * sizeof (*lumpinfo), PU_STATIC, NULL);
+	cdir = malloc(max(zend.cdirsize, 1));
+	entries = calloc(max(zend.entries, 1), sizeof (*entries));
+	if (!cdir || !entries)
+	{
+		snprintf(error, errorlen, "Out of memory reading the central directory");
+		free(cdir);
+		free(entries);
+		return NULL;
+	}
 
-	fseek(handle, zend.cdiroffset, SEEK_SET);
-	for (i = 0; i < numlumps; i++, lump_p++)
+	if (fseek(handle, zend.cdiroffset, SEEK_SET) != 0 || fread(cdir, 1, zend.cdirsize, handle) < zend.cdirsize)
 	{
-		char* fullname;
-		char* trimname;
-		char* dotpos;
+		snprintf(error, errorlen, "Failed to read central directory (%s)", M_FileError(handle));
+		goto fail;
+	}
+
+	for (i = 0; i < zend.entries; i++)
+	{
+		zipentry_t *entry = &entries[i];
 
-		if (fread(&zentry, 1, sizeof(zentry_t), handle) < sizeof(zentry_t))
+		if (pos + sizeof zentry > zend.cdirsize)
 		{
-			CONS_Alert(CONS_ERROR, "Failed to read central directory (%s)\n", M_FileError(handle));
-			Z_Free(lumpinfo);
-			return NULL;
+			snprintf(error, errorlen, "Failed to read central directory");
+			goto fail;
 		}
-		if (memcmp(zentry.signature, pat_central, 4))
+
+		memcpy(&zentry, cdir + pos, sizeof zentry);
+		pos += sizeof zentry;
+
+		if (memcmp(zentry.signature, pat_central, 4) || pos + zentry.namelen > zend.cdirsize)
 		{
-			CONS_Alert(CONS_ERROR, "Central directory is corrupt\n");
-			Z_Free(lumpinfo);
-			return NULL;
+			snprintf(error, errorlen, "Central directory is corrupt");
+			goto fail;
 		}
 
-		lump_p->position = zentry.offset; // NOT ACCURATE YET: we still need to read the local entry to find our true position
-		lump_p->disksize = zentry.compsize;
-		lump_p->diskpath = NULL;
-		lump_p->size = zentry.size;
+		entry->fullname = malloc(zentry.namelen + 1);
+		if (!entry->fullname)
+		{
+			snprintf(error, errorlen, "Out of memory reading the central directory");
+			goto fail;
+		}
+		memcpy(entry->fullname, cdir + pos, zentry.namelen);
+		entry->fullname[zentry.namelen] = '\0';
+
+		entry->position = zentry.offset;
+		entry->disksize = zentry.compsize;
+		entry->size = zentry.size;
+		entry->compression = zentry.compression;
+
+		// skip and ignore comments/extra fields
+		pos += zentry.namelen + zentry.xtralen + zentry.commlen;
+	}
+
+	// The data follows the local header, whose extra field may differ
+	// from the one in the central directory
+	for (i = 0; i < zend.entries; i++)
+	{
+		zipentry_t *entry = &entries[i];
 
-		fullname = malloc(zentry.namelen + 1);
-		if (fgets(fullname, zentry.namelen + 1, handle) != fullname)
+		if ((fseek(handle, entry->position, SEEK_SET) != 0) || (fread(&zlentry, 1, sizeof(zlentry_t), handle) < sizeof(zlentry_t)))
 		{
-			CONS_Alert(CONS_ERROR, "Unable to read lumpname (%s)\n", M_FileError(handle));
-			Z_Free(lumpinfo);
-			free(fullname);
-			return NULL;
+			snprintf(error, errorlen, "Local headers for lump %s are corrupt", entry->fullname);
+			goto fail;
 		}
 
+		entry->position += sizeof(zlentry_t) + zlentry.namelen + zlentry.xtralen;
+	}
+
+	free(cdir);
+	*nlmp = zend.entries;
+	return entries;
+
+fail:
+	free(cdir);
+	ResFreeZipEntries(entries, zend.entries);
+	return NULL;
+}
+
+/** Create a lumpinfo_t array for a PKZip file.
+ * If its entries were already read on a job thread, they only need to be
+ * copied.
+ */
+static lumpinfo_t* ResGetLumpsZip (FILE* handle, UINT16* nlmp, const preparedfile_t *prepared)
+{
+	zipentry_t *entries;
+	UINT16 numlumps;
+	lumpinfo_t* lumpinfo;
+	lumpinfo_t *lump_p;
+	char error[256];
+	size_t i;
+
+	if (prepared && prepared->zipentries)
+	{
+		entries = prepared->zipentries;
+		numlumps = prepared->numlumps;
+	}
+	else if ((entries = ResGetZipEntries(handle, &numlumps, error, sizeof error)) == NULL)
+	{
+		CONS_Alert(CONS_ERROR, "%s\n", error);
+		return NULL;
+	}
+
+	lump_p = lumpinfo = Z_Malloc(numlumps * sizeof (*lumpinfo), PU_STATIC, NULL);
+
+	for (i = 0; i < numlumps; i++, lump_p++)
+	{
+		const zipentry_t *entry = &entries[i];
+		const char *fullname = entry->fullname;
+		const char *trimname;
+		const char *dotpos;
+
+		lump_p->position = entry->position;
+		lump_p->disksize = entry->disksize;
+		lump_p->diskpath = NULL;
+		lump_p->size = entry->size;
+
 		// Strip away file address and extension for the 8char name.
 		if ((trimname = strrchr(fullname, '/')) != 0)
 			trimname++;
@@ -642,10 +894,9 @@ static lumpinfo_t* ResGetLumpsZip (FILE* handle, UINT16* nlmp)
 		lump_p->longname = Z_Calloc(dotpos - trimname + 1, PU_STATIC, NULL);
 		strlcpy(lump_p->longname, trimname, dotpos - trimname + 1);
 
-		lump_p->fullname = Z_Calloc(zentry.namelen + 1, PU_STATIC, NULL);
-		strncpy(lump_p->fullname, fullname, zentry.namelen);
+		lump_p->fullname = Z_StrDup(fullname);
 
-		switch(zentry.compression)
+		switch(entry->compression)
 		{
 		case 0:
 			lump_p->compression = CM_NOCOMPRESSION;
@@ -663,31 +914,11 @@ static lumpinfo_t* ResGetLumpsZip (FILE* handle, UINT16* nlmp)
 			lump_p->compression = CM_UNSUPPORTED;
 			break;
 		}
-
-		free(fullname);
-
-		// skip and ignore comments/extra fields
-		if (fseek(handle, zentry.xtralen + zentry.commlen, SEEK_CUR) != 0)
-		{
-			CONS_Alert(CONS_ERROR, "Central directory is corrupt\n");
-			Z_Free(lumpinfo);
-			return NULL;
-		}
 	}
 
-	// Adjust lump position values properly
-	for (i = 0, lump_p = lumpinfo; i < numlumps; i++, lump_p++)
-	{
-		// skip and ignore comments/extra fields
-		if ((fseek(handle, lump_p->position, SEEK_SET) != 0) || (fread(&zlentry, 1, sizeof(zlentry_t), handle) < sizeof(zlentry_t)))
-		{
-			CONS_Alert(CONS_ERROR, "Local headers for lump %s are corrupt\n", lump_p->fullname);
-			Z_Free(lumpinfo);
-			return NULL;
-		}
-
-		lump_p->position += sizeof(zlentry_t) + zlentry.namelen + zlentry.xtralen;
-	}
+	// Prepared entries are freed with the rest of the prepared file
+	if (!prepared || entries != prepared->zipentries)
+		ResFreeZipEntries(entries, numlumps);
 
 	*nlmp = numlumps;
 	return lumpinfo;
@@ -922,7 +1153,7 @@ UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 		lumpinfo = ResGetLumpsStandalone(handle, &numlumps, "LUA_INIT");
 		break;
 	case RET_PK3:
-		lumpinfo = ResGetLumpsZip(handle, &numlumps);
+		lumpinfo = ResGetLumpsZip(handle, &numlumps, W_FindPreparedFile(filename));
 		break;
 	case RET_WAD:
 		lumpinfo = ResGetLumpsWad(handle, &numlumps, filename);
@@ -959,6 +1190,10 @@ UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 	wadfile->filesize = (unsigned)ftell(handle);
 	wadfile->type = type;
 
+	// Map the whole file, so lumps are read without a seek and a copy
+	// through stdio each. If that fails, lumps are read from the handle.
+	wadfile->mapped = I_MapFile(handle, wadfile->filesize);
+
 	// already generated, just copy it over
 	M_Memcpy(&wadfile->md5sum, &md5sum, 16);
 
@@ -972,9 +1207,11 @@ UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 	// add the wadfile
 	//
 	CONS_Printf(M_GetText("Added file %s (%u lumps)\n"), filename, numlumps);
+	W_StopPrefetch(); // It reads wadfiles
 	wadfiles = Z_Realloc(wadfiles, sizeof(wadfile_t *) * (numwadfiles + 1), PU_STATIC, NULL);
 	wadfiles[numwadfiles] = wadfile;
 	numwadfiles++; // must come BEFORE W_LoadDehackedLumps, so any addfile called by COM_BufInsertText called by Lua doesn't overwrite what we just loaded
+	W_AddFileToLumpDirectory(numwadfiles - 1);
 
 	// Read shaders from file
 	W_ReadFileShaders(wadfile);
@@ -999,7 +1236,6 @@ UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 		break;
 	}
 
-	W_InvalidateLumpnumCache();
 	return wadfile->numlumps;
 }
 
@@ -1137,6 +1373,7 @@ UINT16 W_InitFolder(const char *path, boolean mainfile, boolean startup)
 	wadfile->path = fullpath;
 	wadfile->type = RET_FOLDER;
 	wadfile->handle = NULL;
+	wadfile->mapped = NULL;
 	wadfile->numlumps = numlumps;
 	wadfile->foldercount = foldercount;
 	wadfile->lumpinfo = lumpinfo;
@@ -1150,17 +1387,92 @@ UINT16 W_InitFolder(const char *path, boolean mainfile, boolean startup)
 	Z_Calloc(numlumps * sizeof (*wadfile->patchcache), PU_STATIC, &wadfile->patchcache);
 
 	CONS_Printf(M_GetText("Added folder %s (%u files, %u folders)\n"), fn, numlumps, foldercount);
+	W_StopPrefetch(); // It reads wadfiles
 	wadfiles = Z_Realloc(wadfiles, sizeof(wadfile_t *) * (numwadfiles + 1), PU_STATIC, NULL);
 	wadfiles[numwadfiles] = wadfile;
 	numwadfiles++;
+	W_AddFileToLumpDirectory(numwadfiles - 1);
 
 	W_ReadFileShaders(wadfile);
 	W_LoadDehackedLumpsPK3(numwadfiles - 1, mainfile);
-	W_InvalidateLumpnumCache();
 
 	return wadfile->numlumps;
 }
 
+// Runs on a job thread, so it may only touch its own file.
+static void W_PrepareFileJob(void *userdata, size_t job)
+{
+	preparedfile_t *prepared = &((preparedfile_t *)userdata)[job];
+	char error[256];
+	FILE *handle;
+
+	if (ResourceFileDetect(prepared->filename) != RET_PK3
+		|| (handle = fopen(prepared->filename, "rb")) == NULL)
+		return;
+
+	// On failure, ResGetLumpsZip reads the file again and reports why
+	prepared->zipentries = ResGetZipEntries(handle, &prepared->numlumps, error, sizeof error);
+	fclose(handle);
+}
+
+/** Does the slow, independent parts of loading a list of files for all of
+  * them at once, over the job threads: hashing them, and reading the
+  * directories and local headers of PK3s. W_InitFile then picks up the results as it adds the
+  * files in order.
+  */
+static void W_PrepareFiles(addfilelist_t *list)
+{
+	const char **paths;
+	size_t i;
+
+	preparedfiles = Z_Calloc(list->numfiles * sizeof (*preparedfiles), PU_STATIC, NULL);
+	paths = Z_Malloc(list->numfiles * sizeof (*paths), PU_STATIC, NULL);
+	numpreparedfiles = 0;
+
+	for (i = 0; i < list->numfiles; i++)
+	{
+		const char *fn = list->files[i];
+		char pathsep = fn[strlen(fn) - 1];
+		FILE *handle;
+
+		if (pathsep == '\\' || pathsep == '/')
+			continue;
+
+		// Find the file the way W_InitFile will
+		if ((handle = W_OpenWadFile(&fn, false)) != NULL)
+		{
+			fclose(handle);
+			preparedfiles[numpreparedfiles].filename = Z_StrDup(fn);
+			paths[numpreparedfiles] = preparedfiles[numpreparedfiles].filename;
+			numpreparedfiles++;
+		}
+	}
+
+#ifndef NOMD5
+	// W_InitFile then finds their MD5 sums in the index
+	M_PrecacheFileMD5s(paths, numpreparedfiles);
+#endif
+	Z_Free(paths);
+
+	I_run_jobs("addons", W_PrepareFileJob, preparedfiles, numpreparedfiles);
+}
+
+static void W_FreePreparedFiles(void)
+{
+	size_t i;
+
+	for (i = 0; i < numpreparedfiles; i++)
+	{
+		if (preparedfiles[i].zipentries)
+			ResFreeZipEntries(preparedfiles[i].zipentries, preparedfiles[i].numlumps);
+		Z_Free(preparedfiles[i].filename);
+	}
+
+	Z_Free(preparedfiles);
+	preparedfiles = NULL;
+	numpreparedfiles = 0;
+}
+
 /** Tries to load a series of files.
   * All files are wads unless they have an extension of ".soc" or ".lua".
   *
@@ -1174,6 +1486,8 @@ void W_InitMultipleFiles(addfilelist_t *list)
 {
 	size_t i = 0;
 
+	W_PrepareFiles(list);
+
 	for (; i < list->numfiles; i++)
 	{
 		const char *fn = list->files[i];
@@ -1187,6 +1501,8 @@ void W_InitMultipleFiles(addfilelist_t *list)
 		else
 			W_InitFile(fn, mainfile, true);
 	}
+
+	W_FreePreparedFiles();
 }
 
 /** Make sure a lump number is valid.
@@ -1358,43 +1674,21 @@ UINT16 W_CheckNumForFullNamePK3(const char *name, UINT16 wad, UINT16 startlump)
 //
 lumpnum_t W_CheckNumForName(const char *name)
 {
-	INT32 i;
-	lumpnum_t check = INT16_MAX;
+	char uname[8 + 1];
+	lumpdirslot_t *slot;
 
 	if (!*name) // some doofus gave us an empty string?
 		return LUMPERROR;
 
-	// Check the lumpnumcache first. Loop backwards so that we check
-	// most recent entries first
-	for (i = lumpnumcacheindex + LUMPNUMCACHESIZE; i > lumpnumcacheindex; i--)
-	{
-		if (!lumpnumcache[i & (LUMPNUMCACHESIZE - 1)].lumpname[8]
-			&& strncmp(lumpnumcache[i & (LUMPNUMCACHESIZE - 1)].lumpname, name, 8) == 0)
-		{
-			lumpnumcacheindex = i & (LUMPNUMCACHESIZE - 1);
-			return lumpnumcache[lumpnumcacheindex].lumpnum;
-		}
-	}
-
-	// scan wad files backwards so patch lump files take precedence
-	for (i = numwadfiles - 1; i >= 0; i--)
-	{
-		check = W_CheckNumForNamePwad(name,(UINT16)i,0);
-		if (check != INT16_MAX)
-			break; //found it
-	}
+	if (!lumpnamedir.size)
+		return LUMPERROR;
 
-	if (check == INT16_MAX) return LUMPERROR;
-	else
-	{
-		// Update the cache.
-		lumpnumcacheindex = (lumpnumcacheindex + 1) & (LUMPNUMCACHESIZE - 1);
-		memset(lumpnumcache[lumpnumcacheindex].lumpname, '\0', 32);
-		strncpy(lumpnumcache[lumpnumcacheindex].lumpname, name, 8);
-		lumpnumcache[lumpnumcacheindex].lumpnum = (i<<16)+check;
+	// The newest file with the lump takes precedence, see lumpdirectory_t
+	strlcpy(uname, name, sizeof uname);
+	strupr(uname);
+	slot = W_FindLumpDirectorySlot(&lumpnamedir, uname, quickncasehash(uname, 8));
 
-		return lumpnumcache[lumpnumcacheindex].lumpnum;
-	}
+	return slot->lumpnum;
 }
 
 //
@@ -1405,45 +1699,20 @@ lumpnum_t W_CheckNumForName(const char *name)
 //
 lumpnum_t W_CheckNumForLongName(const char *name)
 {
-	INT32 i;
-	lumpnum_t check = INT16_MAX;
+	char uname[LONGNAMEHASHLEN + 1];
+	lumpdirslot_t *slot;
 
 	if (!*name) // some doofus gave us an empty string?
 		return LUMPERROR;
 
-	// Check the lumpnumcache first. Loop backwards so that we check
-	// most recent entries first
-	for (i = lumpnumcacheindex + LUMPNUMCACHESIZE; i > lumpnumcacheindex; i--)
-	{
-		if (strcmp(lumpnumcache[i & (LUMPNUMCACHESIZE - 1)].lumpname, name) == 0)
-		{
-			lumpnumcacheindex = i & (LUMPNUMCACHESIZE - 1);
-			return lumpnumcache[lumpnumcacheindex].lumpnum;
-		}
-	}
-
-	// scan wad files backwards so patch lump files take precedence
-	for (i = numwadfiles - 1; i >= 0; i--)
-	{
-		check = W_CheckNumForLongNamePwad(name,(UINT16)i,0);
-		if (check != INT16_MAX)
-			break; //found it
-	}
+	if (!lumplongnamedir.size)
+		return LUMPERROR;
 
-	if (check == INT16_MAX) return LUMPERROR;
-	else
-	{
-		if (strlen(name) < 32)
-		{
-			// Update the cache.
-			lumpnumcacheindex = (lumpnumcacheindex + 1) & (LUMPNUMCACHESIZE - 1);
-			memset(lumpnumcache[lumpnumcacheindex].lumpname, '\0', 32);
-			strlcpy(lumpnumcache[lumpnumcacheindex].lumpname, name, 32);
-			lumpnumcache[lumpnumcacheindex].lumpnum = (i << 16) + check;
-		}
+	strlcpy(uname, name, sizeof uname);
+	strupr(uname);
+	slot = W_FindLumpDirectorySlot(&lumplongnamedir, uname, quickncasehash(uname, LONGNAMEHASHLEN));
 
-		return (i << 16) + check;
-	}
+	return slot->lumpnum;
 }
 
 // Look for valid map data through all added files in descendant order.
@@ -1684,8 +1953,363 @@ void zerr(int ret)
 }
 #endif
 
+static inflatedlump_t **W_InflatedLumpBucket(UINT16 wad, UINT16 lump)
+{
+	return &inflatedhash[((((UINT32)wad << 16) | lump) * 2654435761u) >> 24];
+}
+
+static void W_UnlinkInflatedLump(inflatedlump_t *entry)
+{
+	inflatedlump_t **link = W_InflatedLumpBucket(entry->wad, entry->lump);
+
+	while (*link != entry)
+		link = &(*link)->hashnext;
+	*link = entry->hashnext;
+
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		inflatedhead = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		inflatedtail = entry->prev;
+
+	inflatedsize -= entry->size;
+}
+
+static void W_LinkInflatedLump(inflatedlump_t *entry)
+{
+	inflatedlump_t **bucket = W_InflatedLumpBucket(entry->wad, entry->lump);
+
+	entry->hashnext = *bucket;
+	*bucket = entry;
+
+	entry->prev = NULL;
+	entry->next = inflatedhead;
+	if (inflatedhead)
+		inflatedhead->prev = entry;
+	else
+		inflatedtail = entry;
+	inflatedhead = entry;
+
+	inflatedsize += entry->size;
+}
+
+static inflatedlump_t *W_FindInflatedLump(UINT16 wad, UINT16 lump)
+{
+	inflatedlump_t *entry;
+
+	for (entry = *W_InflatedLumpBucket(wad, lump); entry; entry = entry->hashnext)
+		if (entry->wad == wad && entry->lump == lump)
+			return entry;
+
+	return NULL;
+}
+
+// Copies part of a lump out of the inflated lump cache, if it's in there
+static boolean W_ReadInflatedLump(UINT16 wad, UINT16 lump, void *dest, size_t size, size_t offset)
+{
+	inflatedlump_t *entry;
+
+#ifdef HAVE_THREADS
+	I_lock_mutex(&inflated_mutex);
+#endif
+
+	entry = W_FindInflatedLump(wad, lump);
+	if (entry)
+	{
+		// Move it to the front
+		W_UnlinkInflatedLump(entry);
+		W_LinkInflatedLump(entry);
+		M_Memcpy(dest, INFLATEDDATA(entry) + offset, size);
+		inflatedhits++;
+	}
+	else
+		inflatedmisses++;
+
+#ifdef HAVE_THREADS
+	I_unlock_mutex(inflated_mutex);
+#endif
+
+	return entry != NULL;
+}
+
+// A cache entry to decompress a lump into, or NULL if it's too big to cache
+static inflatedlump_t *W_NewInflatedLump(UINT16 wad, UINT16 lump, size_t size)
+{
+	inflatedlump_t *entry;
+
+	if (size > INFLATECACHESIZE / 4)
+		return NULL;
+
+	entry = malloc(sizeof (*entry) + size);
+	if (entry)
+	{
+		entry->wad = wad;
+		entry->lump = lump;
+		entry->size = size;
+	}
+
+	return entry;
+}
+
+// Adds a freshly decompressed lump to the cache, making room for it
+static void W_AddInflatedLump(inflatedlump_t *entry)
+{
+#ifdef HAVE_THREADS
+	I_lock_mutex(&inflated_mutex);
+#endif
+
+	// Another thread may have inflated the same lump meanwhile.
+	if (W_FindInflatedLump(entry->wad, entry->lump))
+		free(entry);
+	else
+	{
+		W_LinkInflatedLump(entry);
+
+		while (inflatedsize > INFLATECACHESIZE && inflatedtail != entry)
+		{
+			inflatedlump_t *oldest = inflatedtail;
+			W_UnlinkInflatedLump(oldest);
+			free(oldest);
+		}
+	}
+
+#ifdef HAVE_THREADS
+	I_unlock_mutex(inflated_mutex);
+#endif
+}
+
+static void W_ClearInflatedLumps(void)
+{
+	while (inflatedhead)
+	{
+		inflatedlump_t *entry = inflatedhead;
+		W_UnlinkInflatedLump(entry);
+		free(entry);
+	}
+	inflatedhits = inflatedmisses = 0;
+}
+
+/** Gets the usage of the cache of decompressed lumps.
+  *
+  * \param size   Set to the bytes of lump data held.
+  * \param hits   Set to the reads served from the cache.
+  * \param misses Set to the reads of compressed lumps that weren't.
+  */
+void W_GetInflateCacheStats(size_t *size, UINT32 *hits, UINT32 *misses)
+{
+	*size = inflatedsize;
+	*hits = inflatedhits;
+	*misses = inflatedmisses;
+}
+
+// Start of a lump's data in its memory-mapped file, or NULL if it isn't mapped
+static UINT8 *W_MappedLumpData(wadfile_t *wadfile, lumpinfo_t *l)
+{
+	if (!wadfile->mapped || (size_t)l->position + l->disksize > wadfile->filesize)
+		return NULL;
+
+	return wadfile->mapped + l->position;
+}
+
+/** Gets an uncompressed lump's data straight from its memory-mapped file,
+  * without copying it. The data is read-only, and stays valid for as long
+  * as the file is loaded.
+  *
+  * \param wad Wad number to read from.
+  * \param lump Lump number to read from.
+  * \return The lump's data, or NULL if the lump is compressed or its file
+  *         couldn't be mapped, in which case read it with W_ReadLumpPwad.
+  */
+const void *W_MappedLumpPwad(UINT16 wad, UINT16 lump)
+{
+	lumpinfo_t *l;
+
+	if (!TestValidLump(wad, lump) || wadfiles[wad]->type == RET_FOLDER)
+		return NULL;
+
+	l = wadfiles[wad]->lumpinfo + lump;
+	if (l->compression != CM_NOCOMPRESSION || !l->size)
+		return NULL;
+
+	return W_MappedLumpData(wadfiles[wad], l);
+}
+
+#ifdef HAVE_THREADS
+// Decompresses a memory-mapped lump into the inflated lump cache, for the
+// prefetch thread. Only uses malloc and the cache's mutex, and quietly
+// gives up on bad data: reading the lump for real reports the problem.
+static void W_PrefetchInflateLump(UINT16 wad, UINT16 lump, const UINT8 *mapped)
+{
+	lumpinfo_t *l = wadfiles[wad]->lumpinfo + lump;
+	inflatedlump_t *inflated = W_NewInflatedLump(wad, lump, l->size);
+	boolean ok = false;
+
+	if (!inflated)
+		return;
+
+	switch (l->compression)
+	{
+#ifdef ZWAD
+	case CM_LZF:
+		ok = (lzf_decompress(mapped, l->disksize, INFLATEDDATA(inflated), l->size) == l->size);
+		break;
+#endif
+#ifdef HAVE_ZLIB
+	case CM_DEFLATE:
+		{
+			z_stream strm;
+
+			memset(&strm, 0, sizeof (strm));
+			strm.zalloc = Z_NULL;
+			strm.zfree = Z_NULL;
+			strm.opaque = Z_NULL;
+
+			strm.next_in = (Bytef *)mapped;
+			strm.avail_in = l->disksize;
+			strm.next_out = INFLATEDDATA(inflated);
+			strm.avail_out = l->size;
+
+			if (inflateInit2(&strm, -15) == Z_OK)
+			{
+				ok = (inflate(&strm, Z_FINISH) == Z_STREAM_END && strm.total_out == l->size);
+				(void)inflateEnd(&strm);
+			}
+		}
+		break;
+#endif
+	default:
+		break;
+	}
+
+	if (ok)
+		W_AddInflatedLump(inflated);
+	else
+		free(inflated);
+}
+
+// Faults in the pages of a memory-mapped lump, or inflates a compressed
+// one into the inflated lump cache. Only touches memory-mapped files,
+// which are safe to read from another thread.
+static void W_PrefetchLump(UINT16 wad, UINT16 lump)
+{
+	lumpinfo_t *l;
+	UINT8 *mapped;
+	boolean cached;
+	size_t i;
+	volatile UINT8 sink = 0;
+
+	if (!TestValidLump(wad, lump) || wadfiles[wad]->type == RET_FOLDER)
+		return;
+
+	l = wadfiles[wad]->lumpinfo + lump;
+	mapped = W_MappedLumpData(wadfiles[wad], l);
+	if (!mapped || !l->size)
+		return;
+
+	if (l->compression == CM_NOCOMPRESSION)
+	{
+		for (i = 0; i < l->disksize; i += 4096)
+			sink ^= mapped[i];
+		return;
+	}
+
+	if (l->size > INFLATECACHESIZE / 4)
+		return;
+
+	I_lock_mutex(&inflated_mutex);
+	cached = (W_FindInflatedLump(wad, lump) != NULL);
+	I_unlock_mutex(inflated_mutex);
+	if (!cached)
+		W_PrefetchInflateLump(wad, lump, mapped);
+}
+
+static void W_PrefetchThread(void *userdata)
+{
+	lumpprefetch_t *prefetch = userdata;
+	size_t i;
+
+	for (i = 0; i < prefetch->numlumps; i++)
+	{
+		if (I_atomic_get(&prefetchcancel) || I_thread_is_stopped())
+			break;
+		W_PrefetchLump(WADFILENUM(prefetch->lumps[i]), LUMPNUM(prefetch->lumps[i]));
+	}
+
+	free(prefetch);
+	I_atomic_set(&prefetchbusy, 0);
+}
+#endif
+
+/** Starts reading lumps in the background, so they come out of memory
+  * when they're needed: compressed lumps are inflated into the inflated
+  * lump cache, and memory-mapped ones are paged in. Replaces whatever
+  * was being prefetched before. Does nothing without threads.
+  *
+  * \param lumps Lumps to read, most wanted first.
+  * \param count Number of lumps.
+  * \sa W_StopPrefetch
+  */
+void W_PrefetchLumps(const lumpnum_t *lumps, size_t count)
+{
+#ifdef HAVE_THREADS
+	lumpprefetch_t *prefetch;
+
+	W_StopPrefetch();
+
+	if (!count || I_thread_is_stopped())
+		return;
+
+	prefetch = malloc(sizeof (*prefetch) + count * sizeof (*lumps));
+	if (!prefetch)
+		return;
+
+	prefetch->numlumps = count;
+	prefetch->lumps = (lumpnum_t *)(prefetch + 1);
+	memcpy(prefetch->lumps, lumps, count * sizeof (*lumps));
+
+	I_atomic_set(&prefetchcancel, 0);
+	I_atomic_set(&prefetchbusy, 1);
+	I_spawn_thread("lump-prefetch", W_PrefetchThread, prefetch);
+#else
+	(void)lumps;
+	(void)count;
+#endif
+}
+
+/** Tells whether the prefetch thread is still reading lumps.
+  *
+  * \sa W_PrefetchLumps
+  */
+boolean W_IsPrefetching(void)
+{
+#ifdef HAVE_THREADS
+	return I_atomic_get(&prefetchbusy) && !I_thread_is_stopped();
+#else
+	return false;
+#endif
+}
+
+/** Stops prefetching lumps, and waits for the prefetch thread to let go
+  * of wadfiles.
+  *
+  * \sa W_PrefetchLumps
+  */
+void W_StopPrefetch(void)
+{
+#ifdef HAVE_THREADS
+	I_atomic_set(&prefetchcancel, 1);
+	while (I_atomic_get(&prefetchbusy) && !I_thread_is_stopped())
+		I_Sleep(1);
+#endif
+}
+
 /** Reads bytes from the head of a lump.
   * Note: If the lump is compressed, the whole thing has to be read anyway.
+  * Lumps of memory-mapped files are copied straight out of the mapping.
+  * Main thread only: bad lumps are fatal errors, and it may use the zone.
   *
   * \param wad Wad number to read from.
   * \param lump Lump number to read from.
@@ -1700,6 +2324,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 	size_t lumpsize, bytesread;
 	lumpinfo_t *l;
 	FILE *handle = NULL;
+	UINT8 *mapped = NULL;
 
 	if (!TestValidLump(wad, lump))
 		return 0;
@@ -1754,14 +2379,35 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 	// Let's get the raw lump data.
 	// We setup the desired file handle to read the lump data.
 	if (wadfiles[wad]->type != RET_FOLDER)
+	{
 		handle = wadfiles[wad]->handle;
-	fseek(handle, (long)(l->position + offset), SEEK_SET);
+		mapped = W_MappedLumpData(wadfiles[wad], l);
+	}
+	// Compressed lumps are always decompressed whole, or copied
+	// out of the cache of decompressed lumps.
+	if (l->compression != CM_NOCOMPRESSION && W_ReadInflatedLump(wad, lump, dest, size, offset))
+	{
+#ifdef NO_PNG_LUMPS
+		if (Picture_IsLumpPNG((UINT8 *)dest, size))
+			Picture_ThrowPNGError(l->fullname, wadfiles[wad]->filename);
+#endif
+		return size;
+	}
+
+	if (!mapped)
+		fseek(handle, (long)(l->position + (l->compression == CM_NOCOMPRESSION ? offset : 0)), SEEK_SET);
 
 	// But let's not copy it yet. We support different compression formats on lumps, so we need to take that into account.
 	switch(wadfiles[wad]->lumpinfo[lump].compression)
 	{
 	case CM_NOCOMPRESSION:		// If it's uncompressed, we directly write the data into our destination, and return the bytes read.
-		bytesread = fread(dest, 1, size, handle);
+		if (mapped)
+		{
+			M_Memcpy(dest, mapped + offset, size);
+			bytesread = size;
+		}
+		else
+			bytesread = fread(dest, 1, size, handle);
 		if (wadfiles[wad]->type == RET_FOLDER)
 			fclose(handle);
 #ifdef NO_PNG_LUMPS
@@ -1775,12 +2421,22 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			char *rawData; // The lump's raw data.
 			char *decData; // Lump's decompressed real data.
 			size_t retval; // Helper var, lzf_decompress returns 0 when an error occurs.
+			inflatedlump_t *inflated = W_NewInflatedLump(wad, lump, l->size);
 
-			rawData = Z_Malloc(l->disksize, PU_STATIC, NULL);
-			decData = Z_Malloc(l->size, PU_STATIC, NULL);
+			// Decompress into the cache, or straight into dest when it wants the whole lump.
+			if (inflated)
+				decData = (char *)INFLATEDDATA(inflated);
+			else
+				decData = (!offset && size == l->size) ? dest : Z_Malloc(l->size, PU_STATIC, NULL);
 
-			if (fread(rawData, 1, l->disksize, handle) < l->disksize)
-				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			if (mapped)
+				rawData = (char *)mapped;
+			else
+			{
+				rawData = Z_Malloc(l->disksize, PU_STATIC, NULL);
+				if (fread(rawData, 1, l->disksize, handle) < l->disksize)
+					I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			}
 			retval = lzf_decompress(rawData, l->disksize, decData, l->size);
 #ifndef AVOID_ERRNO
 			if (retval == 0) // If this was returned, check if errno was set
@@ -1800,9 +2456,14 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 
 			if (!decData) // Did we get no data at all?
 				return 0;
-			M_Memcpy(dest, decData + offset, size);
-			Z_Free(rawData);
-			Z_Free(decData);
+			if (rawData != (char *)mapped)
+				Z_Free(rawData);
+			if (decData != dest)
+				M_Memcpy(dest, decData + offset, size);
+			if (inflated)
+				W_AddInflatedLump(inflated);
+			else if (decData != dest)
+				Z_Free(decData);
 #ifdef NO_PNG_LUMPS
 			if (Picture_IsLumpPNG((UINT8 *)dest, size))
 				Picture_ThrowPNGError(l->fullname, wadfiles[wad]->filename);
@@ -1824,12 +2485,22 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			z_stream strm;
 			unsigned long rawSize = l->disksize;
 			unsigned long decSize = l->size;
+			inflatedlump_t *inflated = W_NewInflatedLump(wad, lump, decSize);
 
-			rawData = Z_Malloc(rawSize, PU_STATIC, NULL);
-			decData = Z_Malloc(decSize, PU_STATIC, NULL);
+			// Inflate into the cache, or straight into dest when it wants the whole lump.
+			if (inflated)
+				decData = INFLATEDDATA(inflated);
+			else
+				decData = (!offset && size == decSize) ? dest : Z_Malloc(decSize, PU_STATIC, NULL);
 
-			if (fread(rawData, 1, rawSize, handle) < rawSize)
-				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			if (mapped)
+				rawData = mapped;
+			else
+			{
+				rawData = Z_Malloc(rawSize, PU_STATIC, NULL);
+				if (fread(rawData, 1, rawSize, handle) < rawSize)
+					I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			}
 
 			strm.zalloc = Z_NULL;
 			strm.zfree = Z_NULL;
@@ -1847,7 +2518,8 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 				zErr = inflate(&strm, Z_FINISH);
 				if (zErr == Z_STREAM_END)
 				{
-					M_Memcpy(dest, decData, size);
+					if (decData != dest)
+						M_Memcpy(dest, decData + offset, size);
 				}
 				else
 				{
@@ -1863,8 +2535,17 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 				zerr(zErr);
 			}
 
-			Z_Free(rawData);
-			Z_Free(decData);
+			if (rawData != mapped)
+				Z_Free(rawData);
+			if (inflated)
+			{
+				if (size)
+					W_AddInflatedLump(inflated);
+				else // Failed to inflate
+					free(inflated);
+			}
+			else if (decData != dest)
+				Z_Free(decData);
 
 #ifdef NO_PNG_LUMPS
 			if (Picture_IsLumpPNG((UINT8 *)dest, size))
@@ -131,6 +131,7 @@ typedef struct wadfile_s
 	UINT16 numlumps; // this wad's number of resources
 	UINT16 foldercount; // folder count
 	FILE *handle;
+	UINT8 *mapped; // the whole file, if it could be memory-mapped
 	UINT32 filesize; // for network
 	UINT8 md5sum[16];
 
@@ -202,6 +203,11 @@ void zerr(int ret); // zlib error checking
 size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, size_t offset);
 size_t W_ReadLumpHeader(lumpnum_t lump, void *dest, size_t size, size_t offest); // read all or a part of a lump
 void W_ReadLumpPwad(UINT16 wad, UINT16 lump, void *dest);
+const void *W_MappedLumpPwad(UINT16 wad, UINT16 lump);
+void W_GetInflateCacheStats(size_t *size, UINT32 *hits, UINT32 *misses);
+void W_PrefetchLumps(const lumpnum_t *lumps, size_t count);
+boolean W_IsPrefetching(void);
+void W_StopPrefetch(void);
 void W_ReadLump(lumpnum_t lump, void *dest);
 
 void *W_CacheLumpNumPwad(UINT16 wad, UINT16 lump, INT32 tag);
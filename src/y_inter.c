@@ -994,6 +994,9 @@ void Y_Ticker(void)
 	if (intertype == int_none)
 		return;
 
+	// Use the idle time to warm up the next level
+	P_LevelPrefetchTicker();
+
 	// Check for pause or menu up in single player
 	if (paused || P_AutoPause())
 		return;
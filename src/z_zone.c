@@ -646,6 +646,8 @@ size_t Z_TagsUsage(INT32 lowtag, INT32 hightag)
 static void Command_Memfree_f(void)
 {
 	size_t freebytes, totalbytes;
+	size_t inflatedsize;
+	UINT32 inflatedhits, inflatedmisses;
 
 	Z_CheckHeap(-1);
 	CONS_Printf("\x82%s", M_GetText("Memory Info\n"));
@@ -664,6 +666,10 @@ static void Command_Memfree_f(void)
 	CONS_Printf(M_GetText("All purgable           : %7s KB\n"),
 		sizeu1(Z_TagsUsage(PU_PURGELEVEL, INT32_MAX)>>10));
 
+	W_GetInflateCacheStats(&inflatedsize, &inflatedhits, &inflatedmisses);
+	CONS_Printf(M_GetText("Inflated lumps         : %7s KB (%u hits, %u misses)\n"),
+		sizeu1(inflatedsize>>10), inflatedhits, inflatedmisses);
+
 #ifdef HWRENDER
 	if (rendermode == render_opengl)
 	{
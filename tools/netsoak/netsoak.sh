@@ -0,0 +1,55 @@
+#!/bin/sh -e
+#
+# SRB2 netcode soak test - a dedicated server and N synthetic clients
+# over loopback
+#
+# Usage: netsoak.sh <srb2 binary> <clients> [seconds] [server arguments...]
+#
+# The server prints a "soak:" line every 10 seconds with its tic time,
+# the traffic and resends per client, and desyncs by subsystem. Add
+# network trouble from the server's console or arguments, e.g.
+#   +delaypacket 80 20 +droprate 2
+# The drop, droprate and delaypacket commands only exist in debug builds
+# (PACKETDROP, on unless NDEBUG is defined). The script stops if the
+# server doesn't know one of the commands it was given.
+#
+
+SRB2=$1
+CLIENTS=$2
+SECONDS=${3:-60}
+PORT=${SRB2_SOAK_PORT:-5029}
+
+if [ -z "$SRB2" ] || [ -z "$CLIENTS" ]; then
+	echo "Usage: $0 <srb2 binary> <clients> [seconds] [server arguments...]"
+	exit 1
+fi
+shift 2
+[ $# -gt 0 ] && shift
+
+WORKDIR=$(mktemp -d)
+trap 'kill $(jobs -p) 2>/dev/null; rm -rf "$WORKDIR"' EXIT INT TERM
+
+# Every process gets its own home, so they don't fight over config files
+mkdir -p "$WORKDIR/server"
+"$SRB2" -dedicated -home "$WORKDIR/server" -port "$PORT" -soakreport 10 "$@" \
+	> "$WORKDIR/server.log" 2>&1 &
+sleep 5
+
+if grep "Unknown command" "$WORKDIR/server.log"; then
+	echo "The server doesn't know a command it was given. drop, droprate and"
+	echo "delaypacket need a debug build (PACKETDROP)."
+	exit 1
+fi
+
+i=1
+while [ $i -le "$CLIENTS" ]; do
+	mkdir -p "$WORKDIR/client$i"
+	SDL_VIDEODRIVER=dummy SDL_AUDIODRIVER=dummy \
+		"$SRB2" -home "$WORKDIR/client$i" -connect "127.0.0.1:$PORT" -soakclient -nosound \
+		> "$WORKDIR/client$i.log" 2>&1 &
+	i=$((i + 1))
+done
+
+sleep "$SECONDS"
+
+grep "soak:" "$WORKDIR/server.log" || echo "No soak report, see $WORKDIR/server.log"